@@ -83,9 +83,8 @@ PLI_INT32 arith_simstart(s_cb_data *callback_data) {
     mpz_mul_2exp(p, p, PRIMEBITS);
     mpz_sub_ui(p, p, PRIMEDELTA);
 
-    // initialize temporary GMP variables
+    // initialize temporary GMP variable
     mpz_init2(t1, 2*(PRIMEBITS + 1));
-    mpz_init2(t2, 2*(PRIMEBITS + 1));
 
     // initialize logging for arithmetic operations
     memset(&add_log, 0, sizeof(add_log));
@@ -218,12 +217,154 @@ ADDMUL_COMP_FINISH:
     return 0;
 }
 
+#ifdef USE_P25519
+//
+// p = 2^255 - 19, so 2^256 = 38 (mod p). x < 2^256 to x mod p.
+//
+static void f_reduce(felt x) {
+    // fold bit 255 back in as 19
+    uint64_t c = 19 * (x[3] >> 63);
+    x[3] &= 0x7FFFFFFFFFFFFFFFULL;
+    for (int i = 0; i < 4 && c; i++) {
+        x[i] += c;
+        c = x[i] < c;
+    }
+
+    // now x < 2p: x >= p iff x + 19 >= 2^255, and then x - p = x + 19 - 2^255
+    felt t;
+    felt_u128 cc = (felt_u128) x[0] + 19;
+    t[0] = (uint64_t) cc;
+    for (int i = 1; i < 4; i++) {
+        cc = (felt_u128) x[i] + (uint64_t) (cc >> 64);
+        t[i] = (uint64_t) cc;
+    }
+    if (t[3] >> 63) {
+        x[0] = t[0];
+        x[1] = t[1];
+        x[2] = t[2];
+        x[3] = t[3] & 0x7FFFFFFFFFFFFFFFULL;
+    }
+}
+
+static void f_add(felt r, const felt a, const felt b) {
+    // a + b < 2p < 2^256
+    felt_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (felt_u128) a[i] + b[i];
+        r[i] = (uint64_t) c;
+        c >>= 64;
+    }
+    f_reduce(r);
+}
+
+static void f_mul(felt r, const felt a, const felt b) {
+    // schoolbook product
+    uint64_t t[8] = { 0, };
+    for (int i = 0; i < 4; i++) {
+        felt_u128 c = 0;
+        for (int j = 0; j < 4; j++) {
+            c += (felt_u128) a[i] * b[j] + t[i + j];
+            t[i + j] = (uint64_t) c;
+            c >>= 64;
+        }
+        t[i + 4] = (uint64_t) c;
+    }
+
+    // t = hi * 2^256 + lo = hi * 38 + lo (mod p)
+    felt_u128 c = 0;
+    for (int i = 0; i < 4; i++) {
+        c += (felt_u128) t[i + 4] * 38 + t[i];
+        r[i] = (uint64_t) c;
+        c >>= 64;
+    }
+
+    // and the carry out of that (at most 38) the same way
+    uint64_t top = (uint64_t) c;
+    while (top) {
+        c = (felt_u128) r[0] + (felt_u128) top * 38;
+        r[0] = (uint64_t) c;
+        for (int i = 1; i < 4; i++) {
+            c = (felt_u128) r[i] + (uint64_t) (c >> 64);
+            r[i] = (uint64_t) c;
+        }
+        top = (uint64_t) (c >> 64);
+    }
+    f_reduce(r);
+}
+#else
+//
+// p = 2^61 - 1, so 2^61 = 1 (mod p). x < 2^64 to x mod p.
+//
+#define F_P61 0x1FFFFFFFFFFFFFFFULL
+static void f_reduce(felt x) {
+    x[0] = (x[0] & F_P61) + (x[0] >> 61);
+    if (x[0] >= F_P61) {
+        x[0] -= F_P61;
+    }
+}
+
+static void f_add(felt r, const felt a, const felt b) {
+    r[0] = a[0] + b[0];
+    f_reduce(r);
+}
+
+static void f_mul(felt r, const felt a, const felt b) {
+    felt_u128 t = (felt_u128) a[0] * b[0];
+    r[0] = ((uint64_t) t & F_P61) + (uint64_t) (t >> 61);
+    f_reduce(r);
+}
+#endif
+
+//
+// Get an argument of $f_add or $f_mul as a felt.
+//
+static void get_felt(felt x, vpiHandle arg_handle) {
+    s_vpi_value val = {0,};
+    val.format = vpiVectorVal;
+    vpi_get_value(arg_handle, &val);
+
+    // how many 32-bit ints does it take to store nbits?
+    int nbits = vpi_get(vpiSize, arg_handle);
+    int nvects = (nbits / 32) + (nbits % 32 != 0);
+
+    if (nvects > 2 * F_LIMBS) {
+        // wider than a felt: reduce it with GMP
+        from_vector_val(t1, val.value.vector, nbits);
+        mpz_mod(t1, t1, p);
+        memset(x, 0, sizeof(felt));
+        mpz_export(x, NULL, -1, sizeof(x[0]), 0, 0, t1);
+        return;
+    }
+
+    // just the aval words, as from_vector_val does
+    memset(x, 0, sizeof(felt));
+    for (int i = 0; i < nvects; i++) {
+        x[i / 2] |= (uint64_t) (uint32_t) val.value.vector[i].aval << (32 * (i % 2));
+    }
+    f_reduce(x);
+}
+
+//
+// Return x as the value of this $f_add or $f_mul.
+//
+static void put_felt(vpiHandle systf_handle, const felt x) {
+    s_vpi_vecval vec[2 * F_LIMBS];
+    for (int i = 0; i < 2 * F_LIMBS; i++) {
+        vec[i].aval = (PLI_INT32) (uint32_t) (x[i / 2] >> (32 * (i % 2)));
+        vec[i].bval = 0;
+    }
+
+    s_vpi_value val = {0,};
+    val.format = vpiVectorVal;
+    val.value.vector = vec;
+    vpi_put_value(systf_handle, &val, NULL, vpiNoDelay);
+}
+
 //
 // This function runs each time $f_add or $f_mul is called.
-// It retrieves arguments and converts them to mpz_t.
+// It retrieves arguments and converts them to felts.
 //
-static bool get_args(vpiHandle systf_handle, s_vpi_value *val) {
-    vpiHandle arg_handle;
+static bool get_args(vpiHandle systf_handle, felt a, felt b) {
     vpiHandle arg_iter = vpi_iterate(vpiArgument, systf_handle);
 
     if (arg_iter == NULL) {
@@ -231,13 +372,8 @@ static bool get_args(vpiHandle systf_handle, s_vpi_value *val) {
         return true;
     }
 
-    arg_handle = vpi_scan(arg_iter);
-    vpi_get_value(arg_handle, val);
-    from_vector_val(t1, val->value.vector, vpi_get(vpiSize, arg_handle));
-
-    arg_handle = vpi_scan(arg_iter);
-    vpi_get_value(arg_handle, val);
-    from_vector_val(t2, val->value.vector, vpi_get(vpiSize, arg_handle));
+    get_felt(a, vpi_scan(arg_iter));
+    get_felt(b, vpi_scan(arg_iter));
 
     vpi_free_object(arg_iter);
     return false;
@@ -252,21 +388,15 @@ static PLI_INT32 add_call(PLI_BYTE8 *user_data) {
     // increment the call counter
     log_arith_op(0);
 
-    // get arguments as hex strings
-    s_vpi_value val = {0,};
-    val.format = vpiVectorVal;
-    vpiHandle systf_handle;
-
-    systf_handle = vpi_handle(vpiSysTfCall, NULL);
+    vpiHandle systf_handle = vpi_handle(vpiSysTfCall, NULL);
+    felt a, b;
 
-    if (get_args(systf_handle, &val)) {
+    if (get_args(systf_handle, a, b)) {
         // error getting args; abort
         vpi_control(vpiFinish, 1);
     } else {
-        mpz_add(t2, t2, t1);
-        mpz_mod(t2, t2, p);
-        val.value.vector = to_vector_val(t2);
-        vpi_put_value(systf_handle, &val, NULL, vpiNoDelay);
+        f_add(b, b, a);
+        put_felt(systf_handle, b);
     }
 
     return 0;
@@ -281,21 +411,15 @@ static PLI_INT32 mul_call(PLI_BYTE8 *user_data) {
     // increment the call counter
     log_arith_op(1);
 
-    // get arguments as hex strings
-    s_vpi_value val = {0,};
-    val.format = vpiVectorVal;
-    vpiHandle systf_handle;
-
-    systf_handle = vpi_handle(vpiSysTfCall, NULL);
+    vpiHandle systf_handle = vpi_handle(vpiSysTfCall, NULL);
+    felt a, b;
 
-    if (get_args(systf_handle, &val)) {
+    if (get_args(systf_handle, a, b)) {
         // error getting args; abort
         vpi_control(vpiFinish, 1);
     } else {
-        mpz_mul(t2, t2, t1);
-        mpz_mod(t2, t2, p);
-        val.value.vector = to_vector_val(t2);
-        vpi_put_value(systf_handle, &val, NULL, vpiNoDelay);
+        f_mul(b, b, a);
+        put_felt(systf_handle, b);
     }
 
     return 0;
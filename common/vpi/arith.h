@@ -23,12 +23,29 @@ static PLI_INT32 addmul_comp(PLI_BYTE8 *user_data);
 static PLI_INT32 addmul_size(PLI_BYTE8 *user_data);
 
 
-static bool get_args(vpiHandle systf_handle, s_vpi_value *val);
+// field elements as 64-bit limbs, least significant first, kept fully
+// reduced. $f_add and $f_mul work on these directly, with no GMP and no
+// allocation; GMP is only used for arguments wider than an element.
+#ifdef USE_P25519
+#define F_LIMBS 4
+#else
+#define F_LIMBS 1
+#endif
+typedef uint64_t felt[F_LIMBS];
+__extension__ typedef unsigned __int128 felt_u128;
+
+static void f_reduce(felt x);
+static void f_add(felt r, const felt a, const felt b);
+static void f_mul(felt r, const felt a, const felt b);
+
+static void get_felt(felt x, vpiHandle arg_handle);
+static void put_felt(vpiHandle systf_handle, const felt x);
+static bool get_args(vpiHandle systf_handle, felt a, felt b);
 static PLI_INT32 add_call(PLI_BYTE8 *user_data);
 static PLI_INT32 mul_call(PLI_BYTE8 *user_data);
 
-// we can reuse the same mpz_t for everything
-static mpz_t p, t1, t2;
+// only for arguments too wide for a felt
+static mpz_t p, t1;
 
 void arith_register(void);
 PLI_INT32 arith_simstart(s_cb_data *callback_data);
@@ -0,0 +1,184 @@
+// arith_test.c
+// checks the limb arithmetic behind $f_add and $f_mul (arith.c) against GMP
+// build with -DARITH_TEST_P61 for p = 2^61 - 1 (see icarus/vpi/Makefile)
+
+#include "util.h"
+
+#ifdef ARITH_TEST_P61
+// util.h only switches primes by being edited, so this is its other branch
+#undef USE_P25519
+#undef PRIMEBITS
+#undef PRIMEDELTA
+#undef PRIMEC32
+#define PRIMEBITS 61
+#define PRIMEDELTA 1
+#define PRIMEC32 2
+#endif
+
+#include <vpi_user.h>
+
+//
+// Just enough of the VPI for add_call and mul_call: a call whose two
+// arguments are vectors of any width, and whose return value is kept.
+// arith.c and vpi_util.c are compiled in below with their VPI calls
+// renamed to these.
+//
+#define MAX_VECTS 32
+#define RET_VECTS (2 * ((PRIMEBITS + 63) / 64))
+struct fake_handle {
+    int nbits;
+    s_vpi_vecval vec[MAX_VECTS];
+};
+
+static struct fake_handle args[2], ret, systf, iter;
+static int next_arg;
+static bool finished;
+
+static vpiHandle fake_register(const void *data) {
+    (void) data;
+    return NULL;
+}
+
+static vpiHandle fake_handle(PLI_INT32 type, vpiHandle ref) {
+    (void) type; (void) ref;
+    return (vpiHandle) &systf;
+}
+
+static vpiHandle fake_iterate(PLI_INT32 type, vpiHandle ref) {
+    (void) type; (void) ref;
+    next_arg = 0;
+    return (vpiHandle) &iter;
+}
+
+static vpiHandle fake_scan(vpiHandle it) {
+    (void) it;
+    return (next_arg < 2) ? (vpiHandle) &args[next_arg++] : NULL;
+}
+
+static PLI_INT32 fake_get(PLI_INT32 property, vpiHandle ref) {
+    return (property == vpiSize) ? ((struct fake_handle *) ref)->nbits : 0;
+}
+
+static void fake_get_value(vpiHandle expr, s_vpi_value *value) {
+    value->value.vector = ((struct fake_handle *) expr)->vec;
+}
+
+static vpiHandle fake_put_value(vpiHandle obj, s_vpi_value *value, s_vpi_time *when, PLI_INT32 flags) {
+    (void) obj; (void) when; (void) flags;
+    memcpy(ret.vec, value->value.vector, RET_VECTS * sizeof(s_vpi_vecval));
+    return NULL;
+}
+
+static void fake_get_time(vpiHandle obj, s_vpi_time *t) {
+    (void) obj;
+    t->high = t->low = 0;
+}
+
+static PLI_INT32 fake_free_object(vpiHandle ref) {
+    (void) ref;
+    return 0;
+}
+
+static PLI_INT32 fake_control(PLI_INT32 operation, ...) {
+    (void) operation;
+    finished = true;
+    return 0;
+}
+
+#define vpi_register_systf fake_register
+#define vpi_register_cb fake_register
+#define vpi_handle fake_handle
+#define vpi_iterate fake_iterate
+#define vpi_scan fake_scan
+#define vpi_get fake_get
+#define vpi_get_value fake_get_value
+#define vpi_put_value fake_put_value
+#define vpi_get_time fake_get_time
+#define vpi_free_object fake_free_object
+#define vpi_control fake_control
+#define vpi_printf printf
+
+#include "arith.c"
+#include "vpi_util.c"
+
+//
+// x < 2^nbits into h, as the simulator would pass it.
+//
+static void set_arg(struct fake_handle *h, const mpz_t x, int nbits) {
+    h->nbits = nbits;
+    memset(h->vec, 0, sizeof(h->vec));
+    for (int i = 0; i < MAX_VECTS; i++) {
+        h->vec[i].aval = (PLI_INT32) (uint32_t) (mpz_getlimbn(x, i / 2) >> (32 * (i % 2)));
+    }
+}
+
+//
+// An argument: 0, 1, p - 1, p, p + 1, 2^k - 1, or random, in nbits bits.
+//
+static void random_arg(mpz_t x, int nbits, gmp_randstate_t rnd) {
+    switch (gmp_urandomm_ui(rnd, 8)) {
+    case 0: mpz_set_ui(x, 0); break;
+    case 1: mpz_set_ui(x, 1); break;
+    case 2: mpz_sub_ui(x, p, 1); break;
+    case 3: mpz_set(x, p); break;
+    case 4: mpz_add_ui(x, p, 1); break;
+    case 5:
+        mpz_set_ui(x, 0);
+        mpz_setbit(x, gmp_urandomm_ui(rnd, nbits + 1));
+        mpz_sub_ui(x, x, 1);
+        break;
+    default: mpz_urandomb(x, rnd, nbits);
+    }
+    mpz_fdiv_r_2exp(x, x, nbits);
+}
+
+int main(int argc, char *argv[]) {
+    const int trials = (argc > 2) ? atoi(argv[2]) : 100000;
+    gmp_randstate_t rnd;
+    gmp_randinit_default(rnd);
+    gmp_randseed_ui(rnd, (argc > 1) ? strtoul(argv[1], NULL, 0) : 1);
+
+    arith_simstart(NULL);
+
+    // widths around the narrow path's limit (2 * F_LIMBS vectors) and
+    // well past it, which get_felt reduces with GMP
+    const int widths[] = { 1, 31, 32, 33, PRIMEBITS - 1, PRIMEBITS, PRIMEBITS + 1,
+                           64 * F_LIMBS, 64 * F_LIMBS + 1, 2 * (PRIMEBITS + 1), 32 * MAX_VECTS };
+    const int nwidths = sizeof(widths) / sizeof(widths[0]);
+
+    mpz_t a, b, want, got;
+    mpz_inits(a, b, want, got, NULL);
+
+    int bad = 0;
+    for (int t = 0; t < trials && bad == 0; t++) {
+        const int wa = widths[gmp_urandomm_ui(rnd, nwidths)];
+        const int wb = widths[gmp_urandomm_ui(rnd, nwidths)];
+        random_arg(a, wa, rnd);
+        random_arg(b, wb, rnd);
+        set_arg(&args[0], a, wa);
+        set_arg(&args[1], b, wb);
+
+        const bool is_mul = t % 2;
+        if (is_mul) {
+            mul_call(NULL);
+            mpz_mul(want, a, b);
+        } else {
+            add_call(NULL);
+            mpz_add(want, a, b);
+        }
+        mpz_mod(want, want, p);
+
+        mpz_import(got, RET_VECTS, -1, sizeof(ret.vec[0]), 0, 8 * (sizeof(ret.vec[0]) - sizeof(ret.vec[0].bval)), ret.vec);
+        if (finished || mpz_cmp(got, want) != 0) {
+            gmp_printf("%s of %Zx (%d bits) and %Zx (%d bits): got %Zx, want %Zx\n",
+                       is_mul ? "$f_mul" : "$f_add", a, wa, b, wb, got, want);
+            bad++;
+        }
+    }
+
+    printf("p = 2^%d - %d: %d $f_add and $f_mul calls %s\n", PRIMEBITS, PRIMEDELTA, trials, bad ? "FAILED" : "ok");
+
+    mpz_clears(a, b, want, got, NULL);
+    gmp_randclear(rnd);
+    return bad != 0;
+}
@@ -3,6 +3,10 @@
 #include "sendrcv_typechecker.h"
 extern mpz_t mpz_buf[];
 static bool muxBitsBuf[10000];
+
+// with the binary protocol, everything goes over one long-lived connection
+static bool use_binary = false;
+static int ver_sock = -1;
 //
 // Register $send and $recieve with the Verilog simulator.
 //
@@ -93,6 +97,8 @@ PLI_INT32 sendrcv_simstart(s_cb_data *callback_data) {
     getSocketPath(socket_path);
     strcpy(server.sun_path, socket_path);
 
+    use_binary = useBinaryProtocol();
+
     return 0;
 }
 
@@ -171,8 +177,34 @@ static PLI_INT32 cmt_send_call(PLI_BYTE8 *user_data) {
 
 }
 
+static int binary_sock(void) {
+    if (ver_sock < 0) {
+        ver_sock = connect_to_ver();
+        if (ver_sock >= 0)
+            startBinaryProtocol(ver_sock);
+    }
+    return ver_sock;
+}
+
 static void net_recieve(prover_request request) {
 
+    if (use_binary) {
+        int sock = binary_sock();
+        if (sock < 0) {
+            return;
+        }
+
+        sendHeaderBin(request, sock);
+
+        prover_request response = request;
+        if (request.requestType == CMT_MUXSEL)
+            recieveMuxBitsBin(&response, muxBitsBuf, sock);
+        else
+            recieveMessageBin(&response, sock);
+        check_header(response, request);
+        return;
+    }
+
     int sock = connect_to_ver();
     if (sock < 0) {
         return;
@@ -225,6 +257,13 @@ static int connect_to_ver() {
 
 static void net_send(prover_request sendRequest) {
 
+    if (use_binary) {
+        int sock = binary_sock();
+        if (sock >= 0)
+            sendMessageBin(sendRequest, sock);
+        return;
+    }
+
     int sock = connect_to_ver();
     if (sock < 0) {
         return;
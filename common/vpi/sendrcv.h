@@ -46,6 +46,7 @@ void (*vlog_startup_routines[])(void) = { sendrcv_register, 0, };
 static void net_recieve(prover_request request);
 static void net_send(prover_request sendRequest);
 static int connect_to_ver(void);
+static int binary_sock(void);
 static void check_header(prover_request response, prover_request request);
 
 
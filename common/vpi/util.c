@@ -3,6 +3,8 @@
 
 #include <math.h>
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 
 //global variables
 mpz_t mpz_buf[MPZ_BUF_LEN];
@@ -10,11 +12,17 @@ cmt_io cmt_io_buf[PIPELINE_DEPTH];
 int netBytesRecieved = 0;
 int netBytesSent = 0;
 static void init_sumcheck_io(sumcheck_io* layer_io, int logMaxWidth);
+static void free_sumcheck_io(sumcheck_io* layer_io, int logMaxWidth);
 static char buf[32768];
+static uint8_t bin_hdr[CMT_BIN_HEADER_LEN];
+static uint8_t bin_buf[MPZ_BUF_LEN * FIELD_BYTES];
 
 void init_cmt_io(int id, int maxWidth, int depth) {
-    cmt_io* the_one = &cmt_io_buf[id];
-    
+    init_cmt_io_at(&cmt_io_buf[id], maxWidth, depth);
+}
+
+//same as init_cmt_io, for a cmt_io that lives outside of cmt_io_buf.
+void init_cmt_io_at(cmt_io* the_one, int maxWidth, int depth) {
     the_one->maxWidth = maxWidth;
     the_one->depth = depth;
     int logMaxWidth = (int) ceil(log2(maxWidth));
@@ -39,10 +47,59 @@ void init_cmt_io(int id, int maxWidth, int depth) {
 }
 
 
-void put_cmt_io(mpz_t* toPut, prover_request request) {
-    cmt_io* the_one = &cmt_io_buf[request.id % PIPELINE_DEPTH];
+bool put_cmt_io(mpz_t* toPut, prover_request request) {
+    return put_cmt_io_at(&cmt_io_buf[request.id % PIPELINE_DEPTH], toPut, request);
+}
+
+//the length a message of type requestType may have in the_one, or -1
+//for an unknown type.
+static int cmt_io_capacity(const cmt_io* the_one, int requestType) {
+    switch (requestType) {
+    case CMT_INPUT:
+    case CMT_OUTPUT:
+        return the_one->maxWidth;
+    case CMT_Q0:
+    case CMT_QI:
+        return the_one->logMaxWidth;
+    case CMT_F012:
+        return 3;
+    case CMT_R:
+    case CMT_TAU:
+        return 1;
+    case CMT_H:
+        return the_one->logMaxWidth + 1;
+    default:
+        return -1;
+    }
+}
+
+//false (and nothing is stored) if the header doesn't fit the_one: an
+//unknown type, or a layer, round or length out of range.
+bool put_cmt_io_at(cmt_io* the_one, mpz_t* toPut, prover_request request) {
     //printf("request.howMany: %d\n the_one->maxWidth: %d\n", request.howMany, the_one->maxWidth);
-    assert(request.howMany <= the_one->maxWidth);
+    int capacity = cmt_io_capacity(the_one, request.requestType);
+    if (request.howMany < 0 || request.howMany > capacity) {
+        printf("ERROR: bad header in put_cmt_io\n");
+        return false;
+    }
+    switch (request.requestType) {
+    case CMT_F012:
+    case CMT_R:
+        if (request.round < 0 || request.round >= 2 * the_one->logMaxWidth) {
+            printf("ERROR: bad round in put_cmt_io\n");
+            return false;
+        }
+        //fall through
+    case CMT_H:
+    case CMT_TAU:
+    case CMT_QI:
+        if (request.layer < 0 || request.layer >= the_one->depth) {
+            printf("ERROR: bad layer in put_cmt_io\n");
+            return false;
+        }
+        break;
+    }
+
     switch (request.requestType) {
     case CMT_INPUT:
         for (int i = 0; i < request.howMany; i++)
@@ -74,10 +131,25 @@ void put_cmt_io(mpz_t* toPut, prover_request request) {
         for (int i = 0; i < request.howMany; i++)
             mpz_set(the_one->layer_io[request.layer].qi[i], toPut[i]);
         break;
-    default:
-        printf("ERROR: bad header in put_cmt_io\n");
-        break;
     }
+    return true;
+}
+
+
+void free_cmt_io(cmt_io* the_one) {
+    for (int i = 0; i < the_one->maxWidth; i++) {
+        mpz_clear(the_one->input[i]);
+        mpz_clear(the_one->output[i]);
+    }
+    for (int i = 0; i < the_one->logMaxWidth; i++)
+        mpz_clear(the_one->q0[i]);
+    free(the_one->input);
+    free(the_one->output);
+    free(the_one->q0);
+
+    for (int i = 0; i < the_one->depth; i++)
+        free_sumcheck_io(&(the_one->layer_io[i]), the_one->logMaxWidth);
+    free(the_one->layer_io);
 }
 
 
@@ -107,6 +179,25 @@ static void init_sumcheck_io(sumcheck_io * layer_io, int logMaxWidth) {
 
 }
 
+static void free_sumcheck_io(sumcheck_io * layer_io, int logMaxWidth) {
+    for (int i = 0; i < 2 * logMaxWidth; i++) {
+        mpz_clear(layer_io->F012[i][0]);
+        mpz_clear(layer_io->F012[i][1]);
+        mpz_clear(layer_io->F012[i][2]);
+        mpz_clear(layer_io->r[i]);
+    }
+    for (int i = 0; i < logMaxWidth + 1; i++)
+        mpz_clear(layer_io->H[i]);
+    mpz_clear(layer_io->T);
+    for (int i = 0; i < logMaxWidth; i++)
+        mpz_clear(layer_io->qi[i]);
+
+    free(layer_io->F012);
+    free(layer_io->r);
+    free(layer_io->H);
+    free(layer_io->qi);
+}
+
 
 void sendHeader(prover_request request, int socket) {
 
@@ -237,6 +328,251 @@ prover_request recieveHeader(FILE* readfp) {
 }
 
 
+//
+// binary protocol
+//
+
+bool useBinaryProtocol(void) {
+    char* proto = getenv("CMT_BINARY_PROTOCOL");
+    return proto != NULL && strcmp(proto, "0") != 0;
+}
+
+//write all of iov[0 .. iovcnt), however many writev calls that takes.
+static void writev_all(int socket, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(socket, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("writing on stream socket");
+            return;
+        }
+        netBytesSent += n;
+
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t*) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+//fill all of iov[0 .. iovcnt). returns false if the peer hung up first.
+static bool readv_all(int socket, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = readv(socket, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("reading on stream socket");
+            return false;
+        }
+        if (n == 0)
+            return false;
+        netBytesRecieved += n;
+
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t*) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+static void pack_header(uint8_t* dst, prover_request request) {
+    int32_t fields[5] = { request.id, request.requestType, request.howMany, request.round, request.layer };
+    for (int i = 0; i < 5; i++) {
+        for (int b = 0; b < 4; b++)
+            dst[4*i + b] = ((uint32_t) fields[i] >> (8*b)) & 0xff;
+    }
+}
+
+static prover_request unpack_header(const uint8_t* src) {
+    int32_t fields[5];
+    for (int i = 0; i < 5; i++) {
+        uint32_t f = 0;
+        for (int b = 0; b < 4; b++)
+            f |= (uint32_t) src[4*i + b] << (8*b);
+        fields[i] = (int32_t) f;
+    }
+
+    prover_request request;
+    request.id = fields[0];
+    request.requestType = fields[1];
+    request.howMany = fields[2];
+    request.round = fields[3];
+    request.layer = fields[4];
+    return request;
+}
+
+//field elements are reduced, so they fit in FIELD_BYTES
+void pack_field(uint8_t* dst, const mpz_t x) {
+    assert(mpz_sgn(x) >= 0 && mpz_sizeinbase(x, 256) <= FIELD_BYTES);
+    memset(dst, 0, FIELD_BYTES);
+    mpz_export(dst, NULL, -1, 1, 0, 0, x);
+}
+
+void unpack_field(mpz_t x, const uint8_t* src) {
+    mpz_import(x, FIELD_BYTES, -1, 1, 0, 0, src);
+}
+
+//prover: announce that this connection speaks the binary protocol.
+void startBinaryProtocol(int socket) {
+    struct iovec iov = { .iov_base = CMT_BIN_MAGIC, .iov_len = CMT_BIN_MAGIC_LEN };
+    writev_all(socket, &iov, 1);
+}
+
+//verifier: does a connection that starts with these bytes speak the
+//binary protocol? returns -1 if there aren't enough bytes to tell yet.
+int isBinaryPreamble(const uint8_t* src, int len) {
+    int n = len < CMT_BIN_MAGIC_LEN ? len : CMT_BIN_MAGIC_LEN;
+    if (n == 0)
+        return -1;
+    if (memcmp(src, CMT_BIN_MAGIC, n) != 0)
+        return 0;
+    return n == CMT_BIN_MAGIC_LEN ? 1 : -1;
+}
+
+//a bare header, e.g., a prover's request for data.
+void sendHeaderBin(prover_request request, int socket) {
+    pack_header(bin_hdr, request);
+    struct iovec iov = { .iov_base = bin_hdr, .iov_len = CMT_BIN_HEADER_LEN };
+    writev_all(socket, &iov, 1);
+#ifdef DEBUG
+    printf("\n\nsending request for: %s. for computation id %d\n", requestToStr(request.requestType), request.id);
+#endif
+}
+
+//header plus the first request.howMany elements of mpz_buf, in one writev.
+void sendMessageBin(prover_request request, int socket) {
+    assert(request.howMany <= MPZ_BUF_LEN);
+    pack_header(bin_hdr, request);
+    for (int i = 0; i < request.howMany; i++)
+        pack_field(bin_buf + i * FIELD_BYTES, mpz_buf[i]);
+
+    struct iovec iov[2] = {
+        { .iov_base = bin_hdr, .iov_len = CMT_BIN_HEADER_LEN },
+        { .iov_base = bin_buf, .iov_len = (size_t) request.howMany * FIELD_BYTES }
+    };
+    writev_all(socket, iov, 2);
+#ifdef DEBUG
+    printf("\n\nsent %s (%d elements) for computation id %d\n", requestToStr(request.requestType), request.howMany, request.id);
+#endif
+}
+
+//header plus request.howMany mux bits, one byte per bit.
+void sendMuxBitsBin(prover_request request, bool* muxBits, int socket) {
+    assert(request.howMany <= MPZ_BUF_LEN * FIELD_BYTES);
+    pack_header(bin_hdr, request);
+    for (int i = 0; i < request.howMany; i++)
+        bin_buf[i] = muxBits[i] ? 1 : 0;
+
+    struct iovec iov[2] = {
+        { .iov_base = bin_hdr, .iov_len = CMT_BIN_HEADER_LEN },
+        { .iov_base = bin_buf, .iov_len = (size_t) request.howMany }
+    };
+    writev_all(socket, iov, 2);
+}
+
+//returns false if the peer closed the connection.
+bool recieveHeaderBin(prover_request* request, int socket) {
+    struct iovec iov = { .iov_base = bin_hdr, .iov_len = CMT_BIN_HEADER_LEN };
+    if (!readv_all(socket, &iov, 1))
+        return false;
+
+    *request = unpack_header(bin_hdr);
+#ifdef DEBUG
+    printf("\n\nrecieved request: %s. for computation id %d\n", requestToStr(request->requestType), request->id);
+#endif
+    return true;
+}
+
+//for a peer that buffers its input itself (e.g., the verifier's event
+//loop): decode a header / howMany elements (into mpz_buf) from src. the
+//caller does the netBytesRecieved accounting.
+prover_request decodeHeaderBin(const uint8_t* src) {
+    return unpack_header(src);
+}
+
+//and the other way, into dst.
+void encodeHeaderBin(uint8_t* dst, prover_request request) {
+    pack_header(dst, request);
+}
+
+void encodeMPZBin(int howMany, uint8_t* dst) {
+    assert(howMany <= MPZ_BUF_LEN);
+    for (int i = 0; i < howMany; i++)
+        pack_field(dst + i * FIELD_BYTES, mpz_buf[i]);
+}
+
+void decodeMPZBin(int howMany, const uint8_t* src) {
+    assert(howMany <= MPZ_BUF_LEN);
+    for (int i = 0; i < howMany; i++)
+        unpack_field(mpz_buf[i], src + i * FIELD_BYTES);
+}
+
+//read howMany elements into mpz_buf.
+void recieveMPZBin(int howMany, int socket) {
+    assert(howMany <= MPZ_BUF_LEN);
+    struct iovec iov = { .iov_base = bin_buf, .iov_len = (size_t) howMany * FIELD_BYTES };
+    if (!readv_all(socket, &iov, 1)) {
+        printf("ERROR: connection closed in the middle of a message. exiting.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < howMany; i++)
+        unpack_field(mpz_buf[i], bin_buf + i * FIELD_BYTES);
+}
+
+//read a header and response->howMany elements (into mpz_buf) in one
+//readv. On return, *response holds the header that was actually recieved.
+void recieveMessageBin(prover_request* response, int socket) {
+    int howMany = response->howMany;
+    assert(howMany <= MPZ_BUF_LEN);
+
+    struct iovec iov[2] = {
+        { .iov_base = bin_hdr, .iov_len = CMT_BIN_HEADER_LEN },
+        { .iov_base = bin_buf, .iov_len = (size_t) howMany * FIELD_BYTES }
+    };
+    if (!readv_all(socket, iov, 2)) {
+        printf("ERROR: verifier closed the connection. exiting.\n");
+        exit(1);
+    }
+
+    *response = unpack_header(bin_hdr);
+    for (int i = 0; i < howMany; i++)
+        unpack_field(mpz_buf[i], bin_buf + i * FIELD_BYTES);
+}
+
+//as above, for response->howMany mux bits.
+void recieveMuxBitsBin(prover_request* response, bool* muxBits, int socket) {
+    int howMany = response->howMany;
+    assert(howMany <= MPZ_BUF_LEN * FIELD_BYTES);
+
+    struct iovec iov[2] = {
+        { .iov_base = bin_hdr, .iov_len = CMT_BIN_HEADER_LEN },
+        { .iov_base = bin_buf, .iov_len = (size_t) howMany }
+    };
+    if (!readv_all(socket, iov, 2)) {
+        printf("ERROR: verifier closed the connection. exiting.\n");
+        exit(1);
+    }
+
+    *response = unpack_header(bin_hdr);
+    for (int i = 0; i < howMany; i++)
+        muxBits[i] = bin_buf[i] != 0;
+}
+
+
 char* phaseToStr(int phase) {
     switch(phase) {
     case SEND_INPUTS:
@@ -253,6 +589,8 @@ char* phaseToStr(int phase) {
         return "CHECK_H";
     case SEND_NEXT_QI_OR_TAU:
         return "SEND_NEXT_QI_OR_TAU";
+    case PROTOCOL_DONE:
+        return "PROTOCOL_DONE";
     default:
         printf("ERROR: not a valid phase. exiting\n");
         exit(1);
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -30,14 +31,6 @@
 #define PRIMEDELTA 19
 #define PRIMEC32 8
 
-//use mpfq for field arithmetic of protocol checks
-//note: mpfq supports other fields but currently verifier only
-//implements it for 25519
-
-#ifndef INHIBIT_MPFQ
-#define USE_MPFQ
-#endif
-
 #endif
 /*
  * NOTE
@@ -47,6 +40,13 @@
  * reflect the width of the outputs.
  */
 
+//do the field arithmetic of the verifier's protocol checks and
+//precomputation on a fixed-width element type (Fp25519 or Fp61, see
+//cmt_circuits/include/common/) rather than on mpz.
+#ifndef INHIBIT_NATIVE_FIELD
+#define USE_NATIVE_FIELD
+#endif
+
 //data the prover requests
 #define CMT_INPUT 10000 //request: howMany
 #define CMT_Q0 20000    //request: howMany
@@ -66,23 +66,34 @@
 #define SEND_NEXT_R 4
 #define CHECK_H 5
 #define SEND_NEXT_QI_OR_TAU 6
+#define PROTOCOL_DONE 7
 
 // the debug macro causes P and V both to dump copious messages about their communication
 //#define DEBUG
 
 #define MPZ_BUF_LEN 16384
 
-//for timing the verifier's checks
+//for timing the verifier's checks (each is timed once, as it runs; see
+//cmtbench for repeated measurements)
 #define BILLION 1000000000L
 
-#ifdef DEBUG
-  #define NREPS 1 //number of times to repeat the checks.
-#else
-  #define NREPS 1000
-#endif
-
 #define SOCKET_NAME "cmthw_socket"
-//determines how many cmt_io_buf structs and verifier_comp_state objs to allocate
+
+// binary protocol: one long-lived connection per prover. The prover opens
+// the connection with CMT_BIN_MAGIC; after that every message is a fixed
+// CMT_BIN_HEADER_LEN-byte header (id, requestType, howMany, round, layer as
+// little-endian int32s) followed by howMany FIELD_BYTES-byte little-endian
+// field elements (or howMany bytes, one per bit, for CMT_MUXSEL).
+// Set CMT_BINARY_PROTOCOL in the prover's environment to use it; the
+// verifier accepts either protocol on every connection, and serves any
+// number of connections (of either kind) at once.
+#define CMT_BIN_MAGIC "CMTB"
+#define CMT_BIN_MAGIC_LEN 4
+#define CMT_BIN_HEADER_LEN 20
+#define FIELD_BYTES 32
+//determines how many cmt_io_buf structs to allocate (for the hardware
+//simulation; the software verifier allocates one cmt_io per computation
+//in flight, see init_cmt_io_at)
 #define PIPELINE_DEPTH 80
 
 
@@ -121,7 +132,10 @@ struct prover_request {
 
 
 void init_cmt_io(int id, int maxWidth, int depth);
-void put_cmt_io(mpz_t* toPut, prover_request request);
+bool put_cmt_io(mpz_t* toPut, prover_request request);
+void init_cmt_io_at(cmt_io* io, int maxWidth, int depth);
+bool put_cmt_io_at(cmt_io* io, mpz_t* toPut, prover_request request);
+void free_cmt_io(cmt_io* io);
 
 void sendHeader(prover_request request, int socket);
 prover_request recieveHeader(FILE* readfp);
@@ -130,6 +144,23 @@ void sendMPZ(int howMany, int socket);
 void sendMuxBits(bool* muxBits, int numMuxBits, int socket);
 void recieveMuxBits(bool* muxBits, int numMuxBits,  FILE* readfp);
 
+bool useBinaryProtocol(void);
+void startBinaryProtocol(int socket);
+int isBinaryPreamble(const uint8_t* src, int len);
+void sendHeaderBin(prover_request request, int socket);
+void sendMessageBin(prover_request request, int socket);
+void sendMuxBitsBin(prover_request request, bool* muxBits, int socket);
+bool recieveHeaderBin(prover_request* request, int socket);
+void recieveMPZBin(int howMany, int socket);
+void recieveMessageBin(prover_request* response, int socket);
+void recieveMuxBitsBin(prover_request* response, bool* muxBits, int socket);
+prover_request decodeHeaderBin(const uint8_t* src);
+void decodeMPZBin(int howMany, const uint8_t* src);
+void encodeHeaderBin(uint8_t* dst, prover_request request);
+void encodeMPZBin(int howMany, uint8_t* dst);
+void pack_field(uint8_t* dst, const mpz_t x);
+void unpack_field(mpz_t x, const uint8_t* src);
+
 char* phaseToStr(int phase);
 char * requestToStr(int request);
 void getSocketPath(char* socket_path);
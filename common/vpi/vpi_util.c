@@ -14,7 +14,7 @@ void from_vector_val(mpz_t n, s_vpi_vecval *val, int nbits) {
 //
 // Low-level conversion of mpz_t to vpiVectorVal.
 //
-s_vpi_vecval *to_vector_val(mpz_t n) {
+s_vpi_vecval *to_vector_val(const mpz_t n) {
     // one extra slot in case PRIMEC32 is odd and mp_bits_per_limb == 64
     static s_vpi_vecval retval[PRIMEC32 + 1];
     memset(retval, 0, (PRIMEC32 + 1) * sizeof(retval[0]));
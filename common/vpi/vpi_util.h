@@ -13,7 +13,7 @@
 #include "util.h"
 
 void from_vector_val(mpz_t n, s_vpi_vecval *val, int nbits);
-s_vpi_vecval *to_vector_val(mpz_t n);
+s_vpi_vecval *to_vector_val(const mpz_t n);
 
 vpiHandle* get_arg_iter(void);
 int get_int_arg(vpiHandle* arg_iter);
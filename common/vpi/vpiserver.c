@@ -82,6 +82,7 @@ static PLI_INT32 vpiserver_simstart(s_cb_data *callback_data) {
         }
     }
     cmtprecomp_init(c_env);
+    start_precomp();
 
     // initialize mpzs for send/rcv buffer
     for (unsigned i = 0; i < MPZ_BUF_LEN; i++) {
@@ -137,6 +138,12 @@ static PLI_INT32 vpiserver_simend(s_cb_data *callback_data) {
         }
 
         // clean up various state
+        stop_precomp();
+        for (unsigned i = 0; i < PIPELINE_DEPTH; i++) {
+            if (pc_data[i].arena != NULL) {
+                cmtprecomp_delete(&pc_data[i]);
+            }
+        }
         cmtprecomp_deinit();
 
         hwver_init = false;
@@ -144,22 +151,162 @@ static PLI_INT32 vpiserver_simend(s_cb_data *callback_data) {
     return 0;
 }
 
+//
+// precomputed element off of computation comp_id (only good until the next
+// call; see cmtprecomp_elt)
+//
+static mpz_srcptr pc_elt(unsigned comp_id, size_t off) {
+    static mpz_t view;
+    return cmtprecomp_elt(view, &pc_data[comp_id], off);
+}
+
+//
+// start the precomputation workers
+//
+static void start_precomp(void) {
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    char *c_env = getenv("CMT_HWVER_THREADS");
+    if (c_env != NULL) {
+        nthreads = strtol(c_env, NULL, 10);
+    }
+    nthreads = (nthreads < 0) ? 0 : (nthreads > MAX_PRECOMP_THREADS) ? MAX_PRECOMP_THREADS : nthreads;
+
+    long window = DEFAULT_PRECOMP_WINDOW;
+    if ( (c_env = getenv("CMT_HWVER_WINDOW")) != NULL ) {
+        window = strtol(c_env, NULL, 10);
+    }
+    pc_window = (window < 1) ? 1 : (window > PIPELINE_DEPTH) ? PIPELINE_DEPTH : window;
+
+    for (unsigned i = 0; i < PIPELINE_DEPTH; i++) {
+        pc_state[i] = SLOT_FREE;
+    }
+    pc_next = 0;
+    pc_live = 0;
+    pc_stopping = false;
+
+    // with fewer workers (or none), new_comp() does the rest itself
+    for (pc_nworkers = 0; pc_nworkers < nthreads; pc_nworkers++) {
+        int err = pthread_create(&pc_workers[pc_nworkers], NULL, precomp_worker, NULL);
+        if ( err != 0 ) {
+            errno = err;
+            perror("start_precomp: pthread_create");
+            break;
+        }
+    }
+}
+
+//
+// stop the precomputation workers, and wait for them
+//
+static void stop_precomp(void) {
+    pthread_mutex_lock(&pc_lock);
+    pc_stopping = true;
+    pthread_cond_broadcast(&pc_cond);
+    pthread_mutex_unlock(&pc_lock);
+
+    for (unsigned i = 0; i < pc_nworkers; i++) {
+        pthread_join(pc_workers[i], NULL);
+    }
+    pc_nworkers = 0;
+}
+
+//
+// precomputation worker: take the next id whose slot is free, as long as
+// fewer than pc_window slots are live, and fill its slot outside the lock
+//
+static void *precomp_worker(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&pc_lock);
+    while (!pc_stopping) {
+        unsigned id = pc_next;
+        unsigned slot = id % PIPELINE_DEPTH;
+        if (pc_live >= pc_window || pc_state[slot] != SLOT_FREE) {
+            pthread_cond_wait(&pc_cond, &pc_lock);
+            continue;
+        }
+
+        pc_next++;
+        pc_live++;
+        pc_state[slot] = SLOT_FILLING;
+        pc_id[slot] = id;
+        pthread_mutex_unlock(&pc_lock);
+
+        int err = cmtprecomp_new_instance(&pc_data[slot], id);
+
+        pthread_mutex_lock(&pc_lock);
+        if ( err != 0 ) {
+            // new_comp() will try again, and report it
+            pc_live--;
+            pc_state[slot] = SLOT_FREE;
+        } else {
+            pc_state[slot] = SLOT_READY;
+        }
+        pthread_cond_broadcast(&pc_cond);
+    }
+    pthread_mutex_unlock(&pc_lock);
+    return NULL;
+}
+
+//
+// is slot comp_id's computation under way?
+//
+static bool comp_in_use(unsigned comp_id) {
+    pthread_mutex_lock(&pc_lock);
+    bool in_use = pc_state[comp_id] == SLOT_IN_USE;
+    pthread_mutex_unlock(&pc_lock);
+    return in_use;
+}
+
+//
+// slot comp_id's computation is done: the workers may refill it (keeping
+// its arena)
+//
+static void release_comp(unsigned comp_id) {
+    pthread_mutex_lock(&pc_lock);
+    pc_data[comp_id].initialized = false;
+    pc_state[comp_id] = SLOT_FREE;
+    pthread_cond_broadcast(&pc_cond);
+    pthread_mutex_unlock(&pc_lock);
+}
+
 //
 // handle a prover's request for a new computation
 //
 static void new_comp(prover_request request) {
-    unsigned comp_id = ((unsigned) request.id) % PIPELINE_DEPTH;
+    unsigned id = (unsigned) request.id;
+    unsigned comp_id = id % PIPELINE_DEPTH;
+
+    // claim the slot, once any worker filling it is done
+    pthread_mutex_lock(&pc_lock);
+    while (pc_state[comp_id] == SLOT_FILLING) {
+        pthread_cond_wait(&pc_cond, &pc_lock);
+    }
 
     // make sure that we're not colliding with a previously allocated computation
-    if ( pc_data[comp_id].initialized ) {
+    if ( pc_state[comp_id] == SLOT_IN_USE ) {
+        pthread_mutex_unlock(&pc_lock);
         vpi_printf("new_comp: tried to reuse an in-use reqID\n");
         vpi_control(vpiFinish, 1);
         return;
     }
 
-    // do the precomputations
-    if ( cmtprecomp_new(&(pc_data[comp_id])) != 0 ) {
-        perror("new_comp: cmtprecomp_new failed");
+    bool ready = pc_state[comp_id] == SLOT_READY && pc_id[comp_id] == id;
+    if ( pc_state[comp_id] == SLOT_READY ) {
+        pc_live--;
+    }
+    pc_state[comp_id] = SLOT_IN_USE;
+    // if the prover skipped ahead, so do the workers
+    if ( id >= pc_next ) {
+        pc_next = id + 1;
+    }
+    pthread_cond_broadcast(&pc_cond);
+    pthread_mutex_unlock(&pc_lock);
+
+    // not prepared ahead of time (no workers, or the prover skipped
+    // around), so do the precomputations now
+    if ( !ready && cmtprecomp_new_instance(&(pc_data[comp_id]), id) != 0 ) {
+        perror("new_comp: cmtprecomp_new_instance failed");
+        release_comp(comp_id);
         vpi_control(vpiFinish, 1);
         return;
     }
@@ -213,7 +360,8 @@ static PLI_INT32 verifier_update_call(PLI_BYTE8 *user_data){
         }
         if (pc_data[comp_id].cLayer == pc_data[comp_id].depth) {
             printf("VERIFICATION FOR COMPUTATION %d COMPLETE!\n", comp_id);
-            cmtprecomp_delete(&pc_data[comp_id]);
+            // keep the arena for the slot's next computation
+            release_comp(comp_id);
         }
         else {
             pc_data[comp_id].cPhase = SEND_NEXT_QI_OR_TAU;
@@ -267,7 +415,7 @@ void handleReq(prover_request request, FILE* readfp, int write_socket) {
         switch (request.requestType) {
         case CMT_INPUT:
             //mux may be requested first, so might be initialized already.
-            if (!pc_data[request.id % PIPELINE_DEPTH].initialized)
+            if (!comp_in_use(request.id % PIPELINE_DEPTH))
                 new_comp(request);
             prepareInputs(request);
             break;
@@ -359,7 +507,7 @@ void returnValues(prover_request request) {
             arg_handle = vpi_scan(arg_iter);
             for (unsigned i = 0; i < pc_data[comp_id].oSize; i++) {
                 element_handle = vpi_handle_by_index(arg_handle, i);
-                argRetval.value.vector = to_vector_val(pc_data[comp_id].chi_o[i]);
+                argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].chi_o + i));
                 vpi_put_value(element_handle, &argRetval, NULL, vpiNoDelay);
             }
             retval.value.integer = 1;
@@ -373,7 +521,7 @@ void returnValues(prover_request request) {
             arg_handle = vpi_scan(arg_iter);
             for (unsigned i = 0; i < 3; i++) {
                 element_handle = vpi_handle_by_index(arg_handle, i);
-                argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].f_wt[3 * request.round + i]);
+                argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].f_wt + 3 * request.round + i));
                 vpi_put_value(element_handle, &argRetval, NULL, vpiNoDelay);
             }
             retval.value.integer = 2;
@@ -387,24 +535,24 @@ void returnValues(prover_request request) {
             arg_handle = vpi_scan(arg_iter);
             for (unsigned i = 0; i < pc_data[comp_id].layers[request.layer].hSize; i++) {
                 element_handle = vpi_handle_by_index(arg_handle, i);
-                argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].h_wt[i]);
+                argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].h_wt + i));
                 vpi_put_value(element_handle, &argRetval, NULL, vpiNoDelay);
             }
             unsigned offset = pc_data[comp_id].layers[request.layer].hSize;
             element_handle = vpi_handle_by_index(arg_handle, offset);
-            argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].add);
+            argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].add));
 
             element_handle = vpi_handle_by_index(arg_handle, offset + 1);
-            argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].mul);
+            argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].mul));
 
             element_handle = vpi_handle_by_index(arg_handle, offset + 2);
-            argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].sub);
+            argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].sub));
 
             element_handle = vpi_handle_by_index(arg_handle, offset + 3);
-            argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].muxl);
+            argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].muxl));
 
             element_handle = vpi_handle_by_index(arg_handle, offset + 4);
-            argRetval.value.vector = to_vector_val(pc_data[comp_id].layers[request.layer].muxr);
+            argRetval.value.vector = to_vector_val(pc_elt(comp_id, pc_data[comp_id].layers[request.layer].muxr));
 
             retval.value.integer = 3;
             break;
@@ -435,7 +583,7 @@ void prepareQ0(prover_request request) {
     }
     else {
         for (int i = 0; i < request.howMany; i++) {
-            mpz_set(mpz_buf[i], pc_data[comp_id].q0[i]);
+            mpz_set(mpz_buf[i], pc_elt(comp_id, pc_data[comp_id].q0 + i));
         }
         put_cmt_io(mpz_buf, request);
         pc_data[comp_id].cPhase = CHECK_F012;
@@ -448,7 +596,7 @@ void prepareR(prover_request request) {
         vpi_control(vpiFinish, 1);
     }
     else {
-        mpz_set(mpz_buf[0], pc_data[comp_id].layers[request.layer].r[request.round]);
+        mpz_set(mpz_buf[0], pc_elt(comp_id, pc_data[comp_id].layers[request.layer].r + request.round));
         put_cmt_io(mpz_buf, request);
         //       printf(" pc_data[comp_id].layers[pc_data[comp_id].cLayer + 1].bSize: %d",  pc_data[comp_id].layers[pc_data[comp_id].cLayer].bSize);
         if (pc_data[comp_id].cRound < 2 * pc_data[comp_id].layers[pc_data[comp_id].cLayer].bSize  - 1) {
@@ -469,7 +617,7 @@ void prepareT(prover_request request) {
         vpi_control(vpiFinish, 1);
     }
     else {
-        mpz_set(mpz_buf[0], pc_data[comp_id].layers[request.layer].tau);
+        mpz_set(mpz_buf[0], pc_elt(comp_id, pc_data[comp_id].layers[request.layer].tau));
         pc_data[comp_id].cPhase = CHECK_F012;
     }
 }
@@ -2,6 +2,7 @@
 // header for VPI module defining verifier side of V-P interface
 // (C) 2015 Riad S. Wahby <rsw@cs.nyu.edu>
 
+#include <errno.h>
 #include <gmp.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -15,6 +16,7 @@
 #include <sys/uio.h>
 #include <unistd.h>
 #include <poll.h>
+#include <pthread.h>
 
 #include <vpi_user.h>
 // for ncverilog only
@@ -37,6 +39,25 @@ static struct sockaddr_un server = { 0, };
 static bool hwver_init;
 static cmtprecomp_cdata pc_data[PIPELINE_DEPTH];
 
+// background precomputation: worker threads fill pc_data slots, in id
+// order, for the computations the prover will ask for next, so that
+// new_comp() only has to claim one (see precomp_worker). The number of
+// workers and how far ahead they may get come from CMT_HWVER_THREADS and
+// CMT_HWVER_WINDOW.
+#define MAX_PRECOMP_THREADS 64
+#define DEFAULT_PRECOMP_WINDOW 16
+enum pc_slot_state { SLOT_FREE, SLOT_FILLING, SLOT_READY, SLOT_IN_USE };
+static enum pc_slot_state pc_state[PIPELINE_DEPTH];
+static unsigned pc_id[PIPELINE_DEPTH];  // id of a FILLING or READY slot
+static pthread_mutex_t pc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pc_cond = PTHREAD_COND_INITIALIZER; // any slot changed state
+static pthread_t pc_workers[MAX_PRECOMP_THREADS];
+static unsigned pc_nworkers;
+static unsigned pc_next;    // next id for the workers
+static unsigned pc_live;    // slots FILLING or READY
+static unsigned pc_window;  // at most this many live
+static bool pc_stopping;
+
 // register functions with verilog simulator
 void vpiserver_register(void);
 
@@ -52,6 +73,12 @@ static PLI_INT32 verifier_update_comp(PLI_BYTE8 *user_data);
 static PLI_INT32 verifier_poll_comp(PLI_BYTE8 *user_data);
 // create a new computation
 static void new_comp(prover_request request);
+// the precomputation workers
+static void start_precomp(void);
+static void stop_precomp(void);
+static void *precomp_worker(void *arg);
+static bool comp_in_use(unsigned comp_id);
+static void release_comp(unsigned comp_id);
 
 // show the verilog simulator what we've got
 void (*vlog_startup_routines[])(void) = { vpiserver_register, 0, };
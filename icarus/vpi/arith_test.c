@@ -0,0 +1 @@
+../../common/vpi/arith_test.c
\ No newline at end of file
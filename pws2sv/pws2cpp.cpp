@@ -0,0 +1,63 @@
+// generate C++ evaluation code for a PWS file
+//
+// The verifier and prover interpret the circuit gate by gate. For a
+// worksheet that doesn't change, this writes out code that evaluates it
+// directly (see circuit/pws_codegen.h); build it as a shared object and
+// hand it to either with -x. Use the same -r as they do.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <circuit/pws_circuit.h>
+#include <circuit/pws_circuit_parser.h>
+#include <circuit/pws_codegen.h>
+#include <gmp.h>
+
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    int copies = 1;
+    if (argc > 2 && !strcmp(argv[1], "-r")) {
+        copies = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " [-r copies] <foo.pws> [foo.cpp]" << endl;
+        return 1;
+    }
+
+    string outName;
+    if (argc > 2) {
+        outName = argv[2];
+    } else {
+        outName = argv[1];
+        size_t dot = outName.rfind('.');
+        if (dot != string::npos && outName.find('/', dot) == string::npos) {
+            outName.resize(dot);
+        }
+        outName += ".cpp";
+    }
+
+    mpz_t prime;
+    mpz_init_set_ui(prime, 1);
+    mpz_mul_2exp(prime, prime, PRIMEBITS);
+    mpz_sub_ui(prime, prime, PRIMEDELTA);
+    PWSCircuitParser parser(prime);
+    PWSCircuit c(parser);
+
+    parser.parse(argv[1]);
+    parser.replicate(copies);
+    //the wiring, for the generated code's digest (see
+    //PWSCompiledEval::load()).
+    c.construct();
+    PWSCodegen::write(parser, c, outName);
+
+    mpz_clear(prime);
+    return 0;
+}
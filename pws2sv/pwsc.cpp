@@ -0,0 +1,49 @@
+// compile PWS into the binary circuit format
+//
+// Parsing a large PWS file is most of the startup time of the verifier,
+// the prover, libcmtprecomp and the tools here. This parses it once and
+// writes the result out (see circuit/pws_compiled.h); every one of those
+// takes the compiled file anywhere it takes a .pws file.
+
+#include <iostream>
+#include <string>
+
+#include <circuit/pws_circuit_parser.h>
+#include <circuit/pws_compiled.h>
+#include <gmp.h>
+
+#include "util.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <foo.pws> [foo.pwsc]" << endl;
+        return 1;
+    }
+
+    string outName;
+    if (argc > 2) {
+        outName = argv[2];
+    } else {
+        outName = argv[1];
+        if (outName.size() > 4 && outName.compare(outName.size() - 4, 4, ".pws") == 0) {
+            outName.resize(outName.size() - 4);
+        }
+        outName += ".pwsc";
+    }
+
+    // the compiled circuit is only good for this prime; loading it under
+    // another one is an error.
+    mpz_t prime;
+    mpz_init_set_ui(prime, 1);
+    mpz_mul_2exp(prime, prime, PRIMEBITS);
+    mpz_sub_ui(prime, prime, PRIMEDELTA);
+    PWSCircuitParser parser(prime);
+
+    parser.parse(argv[1]);
+    PWSCompiledCircuit::write(parser, outName);
+
+    mpz_clear(prime);
+    return 0;
+}
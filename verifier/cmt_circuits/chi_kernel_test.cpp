@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <iostream>
+
+#include <gmp.h>
+#include <gmpxx.h>
+#include <common/chi_kernels.h>
+#include <common/math.h>
+#include <common/poly_utils.h>
+
+using namespace std;
+
+// Checks every chiDoubleStep() kernel this CPU can run against the scalar
+// one, on tables of every small size and a few large ones, and the mpz
+// computeChiAll()/extendChiAll() (which use them for these two primes)
+// against chi(). Exits nonzero on the first mismatch.
+
+static gmp_randstate_t rnd;
+
+// random elements, with the edge values 0, 1, p - 1 and (for Fp25519)
+// values with long runs of one bits mixed in.
+template<typename F> static F
+randomElt(const mpz_class& p)
+{
+  mpz_class x;
+  switch (gmp_urandomm_ui(rnd, 8))
+  {
+    case 0: x = 0; break;
+    case 1: x = 1; break;
+    case 2: x = p - 1; break;
+    case 3: x = (mpz_class(1) << gmp_urandomm_ui(rnd, mpz_sizeinbase(p.get_mpz_t(), 2))) - 1; break;
+    default: mpz_urandomm(x.get_mpz_t(), rnd, p.get_mpz_t());
+  }
+  return F(x.get_mpz_t());
+}
+
+template<typename F> static bool
+checkKernels(const char* field, const mpz_class& p)
+{
+  const size_t nk = chiKernelCount<F>();
+  const size_t scalar = nk - 1;
+  bool ok = true;
+
+  cout << field << ": dispatched kernel " << chiKernelName<F>() << endl;
+  for (size_t k = 0; k < nk; k++)
+  {
+    size_t steps = 0;
+    bool same = true;
+    for (size_t base = 1; base <= 4096; base = (base < 64) ? base + 1 : 4 * base)
+    {
+      for (int trial = 0; trial < 4; trial++)
+      {
+        const size_t nhi = (trial == 0) ? base : gmp_urandomm_ui(rnd, base + 1);
+        const F r = randomElt<F>(p);
+
+        vector<F> want(2 * base);
+        for (size_t i = 0; i < base; i++)
+          want[i] = randomElt<F>(p);
+        vector<F> got(want);
+
+        chiDoubleStep<F>(scalar, &want[0], base, nhi, r);
+        chiDoubleStep<F>(k, &got[0], base, nhi, r);
+        steps++;
+        if (got != want)
+        {
+          cout << field << ": kernel " << chiKernelName<F>(k) << " differs from scalar at base "
+               << base << ", nhi " << nhi << endl;
+          same = false;
+        }
+      }
+    }
+    cout << field << ": kernel " << chiKernelName<F>(k) << ": " << steps << " steps "
+         << (same ? "ok" : "FAILED") << endl;
+    ok = ok && same;
+  }
+  return ok;
+}
+
+static bool
+checkMPZ(const char* field, const mpz_class& p)
+{
+  bool ok = true;
+  for (size_t n = 1; n <= 256; n = (n < 20) ? n + 1 : 2 * n)
+  {
+    const size_t logn = log2i(n);
+    const size_t startAt = gmp_urandomm_ui(rnd, 3);
+    MPZVector r(startAt + logn);
+    for (size_t i = 0; i < r.size(); i++)
+      mpz_urandomm(r[i], rnd, p.get_mpz_t());
+
+    MPZVector chis(n);
+    computeChiAll(chis, n, r, startAt, p.get_mpz_t());
+
+    // the same table finished from the one over its first fromLog
+    // coordinates (2^fromLog <= n).
+    const size_t fromLog = gmp_urandomm_ui(rnd, log2i(n + 1));
+    MPZVector ext(n);
+    computeChiAll(ext, size_t(1) << fromLog, r, startAt, p.get_mpz_t());
+    extendChiAll(ext, n, r, startAt, fromLog, p.get_mpz_t());
+
+    mpz_t want;
+    mpz_init(want);
+    for (size_t i = 0; i < n; i++)
+    {
+      chi(want, i, &r[startAt], logn, p.get_mpz_t());
+      if (mpz_cmp(want, chis[i]) != 0 || mpz_cmp(want, ext[i]) != 0)
+      {
+        cout << field << ": mpz chi table of size " << n << " differs from chi() at " << i << endl;
+        ok = false;
+        break;
+      }
+    }
+    mpz_clear(want);
+  }
+  cout << field << ": mpz chi tables " << (ok ? "ok" : "FAILED") << endl;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+    gmp_randinit_default(rnd);
+    gmp_randseed_ui(rnd, (argc > 1) ? strtoul(argv[1], NULL, 0) : 1);
+
+    const mpz_class p61 = (mpz_class(1) << 61) - 1;
+    const mpz_class p25519 = (mpz_class(1) << 255) - 19;
+
+    bool ok = true;
+    ok = checkKernels<Fp61>("Fp61", p61) && ok;
+    ok = checkKernels<Fp25519>("Fp25519", p25519) && ok;
+    ok = checkMPZ("Fp61", p61) && ok;
+    ok = checkMPZ("Fp25519", p25519) && ok;
+
+    gmp_randclear(rnd);
+    return ok ? 0 : 1;
+}
@@ -3,6 +3,7 @@
 
 #include <common/utility.h>
 #include <common/debug_utils.h>
+#include <crypto/transcript.h>
 #include <algorithm> //for std::max.
 #include "circuit.h"
 
@@ -13,15 +14,19 @@ Circuit::
 Circuit(size_t primeSize)
   : qData(CIRCUIT_DATA_BUDGET, vector<size_t>()),
     zData(CIRCUIT_DATA_BUDGET, vector<size_t>()),
+    fieldValues(NULL),
     valid(true)
 {
   mpz_init(prime);
   loadPrime(prime, primeSize);
+  qData.setPrime(prime);
+  zData.setPrime(prime);
 }
 
 Circuit::
 ~Circuit()
 {
+  delete fieldValues;
   mpz_clear(prime);
 }
 
@@ -94,6 +99,9 @@ finalizeConstruct()
     zData.setSizes(sizes);
     qData.setSizes(sizes);
 
+    for (vector<CircuitLayer>::iterator it = layers.begin(); it != layers.end(); ++it)
+      it->groupGates();
+
     valid = true;
   }
 }
@@ -104,6 +112,13 @@ evaluate()
   if (depth() < 2)
     return;
 
+  if (fieldValues)
+  {
+    for (int lvl = depth() - 2; lvl >= 0; lvl--)
+      fieldValues->evalGates(layers[lvl], lvl, 0, layers[lvl].size());
+    return;
+  }
+
   ReverseLayerIt it = layers.rbegin();
 
   // Evaluate from the top down.
@@ -129,10 +144,33 @@ evaluate()
   }
 }
 
+bool Circuit::
+setFieldEvaluation(bool enable)
+{
+  assert(valid);
+
+  delete fieldValues;
+  fieldValues = NULL;
+  if (!enable || needsRationals())
+    return false;
+
+  fieldValues = FieldStore::forPrime(prime);
+  if (fieldValues)
+  {
+    vector<size_t> sizes;
+    for (int i = 0; i < depth(); i++)
+      sizes.push_back(layers[i].size());
+    fieldValues->resize(sizes);
+  }
+  return fieldValues != NULL;
+}
+
 void Circuit::
 setPrime(const mpz_t p)
 {
   mpz_set(prime, p);
+  qData.setPrime(prime);
+  zData.setPrime(prime);
 }
 
 int Circuit::
@@ -141,6 +179,41 @@ get_prime_nbits() const
   return mpz_sizeinbase(prime, 2);
 }
 
+void Circuit::
+absorbWiring(Transcript& t) const
+{
+  // the prime, little-endian, after its length.
+  vector<uint8_t> buf((mpz_sizeinbase(prime, 2) + 7) / 8);
+  mpz_export(&buf[0], NULL, -1, 1, 0, 0, prime);
+  t.absorb((uint32_t) buf.size());
+  t.absorb(&buf[0], buf.size());
+
+  t.absorb((uint32_t) depth());
+  for (int i = 0; i < depth(); i++)
+  {
+    const CircuitLayer& layer = layers[i];
+    t.absorb((uint32_t) layer.size());
+    t.absorb((uint32_t) layer.numCopies());
+    for (int g = 0; g < layer.size(); g++)
+    {
+      const GateWiring& wiring = layer[g];
+      t.absorb((uint32_t) wiring.type);
+      t.absorb((uint32_t) wiring.in1);
+      t.absorb((uint32_t) wiring.in2);
+      if (wiring.type == GateWiring::MUX)
+        t.absorb((uint32_t) layer.getMuxIdx(g));
+    }
+  }
+}
+
+void Circuit::
+wiringDigest(uint8_t* out) const
+{
+  Transcript t(CIRCUIT_DIGEST_LABEL);
+  absorbWiring(t);
+  t.squeeze(out, CIRCUIT_DIGEST_BYTES);
+}
+
 void Circuit::
 print() const
 {
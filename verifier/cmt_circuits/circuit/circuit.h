@@ -6,12 +6,19 @@
 
 #include "circuit_data.h"
 #include "circuit_layer.h"
+#include "field_store.h"
 
 // TODO: Tuning parameter. Auto generate?
 #define MEGABYTE (1l << 20)
 #define GIGABYTE (1l << 30)
 #define CIRCUIT_DATA_BUDGET (4 * GIGABYTE)
 
+// see Circuit::wiringDigest()
+#define CIRCUIT_DIGEST_BYTES 32
+#define CIRCUIT_DIGEST_LABEL "zebra circuit wiring v1"
+
+class Transcript;
+
 class Circuit
 {
 protected:
@@ -19,6 +26,10 @@ protected:
   MPZData zData;
   std::vector<CircuitLayer> layers;
 
+  // non-NULL in field-only mode; then qData and zData only hold values
+  // that something asked for as an mpq_t or mpz_t.
+  FieldStore* fieldValues;
+
   bool valid;
   friend class CircuitLayer;
 
@@ -44,8 +55,29 @@ public:
 
   virtual void evaluate();
 
+  // Switch to (or back from) field-only evaluation, where each layer's
+  // gate values live in one array of native field elements (see
+  // field_store.h). Call after construct(); gate values are reset. Returns
+  // whether field-only mode is on, which it can't be if the prime has no
+  // native field or the circuit needsRationals().
+  bool setFieldEvaluation(bool enable);
+  bool fieldEvaluation() const { return fieldValues != NULL; }
+  FieldStore* fieldStore() const { return fieldValues; }
+
+  // whether evaluating the circuit needs the gate values as rationals,
+  // rather than just their values in the field.
+  virtual bool needsRationals() const { return false; }
+
   void setPrime(const mpz_t prime);
   int get_prime_nbits() const;
+
+  // Absorb the prime and every layer's wiring into t: what, along with
+  // the mux bits, fixes the circuit as a statement.
+  void absorbWiring(Transcript& t) const;
+  // CIRCUIT_DIGEST_BYTES squeezed from a transcript of absorbWiring().
+  // Files made for one circuit (proofs, precomputations, compiled
+  // evaluation code) carry it, so they can't be used with another.
+  void wiringDigest(uint8_t* out) const;
   void print() const;
 
 protected:
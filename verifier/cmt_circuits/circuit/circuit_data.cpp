@@ -4,6 +4,10 @@
 #include <iostream>
 #include <cerrno>
 #include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <crypto/prng.h>
 
@@ -17,42 +21,84 @@ using namespace std;
 
 static Prng prng(PNG_CHACHA);
 
-#define RETURN_IF_FALSE(file, statement) { if (!statement) { fclose(f); return false; } }
+// val into a record of len bytes; false if it doesn't fit.
+static bool
+putRecord(char* rec, size_t len, const mpz_t val)
+{
+  if (mpz_sizeinbase(val, 2) >= len * 8)
+    return false;
+
+  memset(rec, 0, len);
+  mpz_export(rec, NULL, -1, 1, -1, 0, val);
+  if (mpz_sgn(val) < 0)
+    rec[len - 1] |= 0x80;
+  return true;
+}
 
-template<typename T> bool
-write(FILE* f, const T& val)
+static void
+getRecord(mpz_t val, const char* rec, size_t len)
 {
-  return fwrite(&val, sizeof(val), 1, f) == 1;
+  vector<char> buf(rec, rec + len);
+  bool negative = buf[len - 1] & 0x80;
+  buf[len - 1] &= 0x7f;
+
+  mpz_import(val, len, -1, 1, -1, 0, &buf[0]);
+  if (negative)
+    mpz_neg(val, val);
 }
 
-template<> bool
-write<mpz_t>(FILE* f, const mpz_t& val)
+// as putRecord(), but a value too wide for the record goes in reduced into
+// [0, prime), which always fits.
+static void
+putReduced(char* rec, size_t len, const mpz_t val, const mpz_t prime)
 {
-  return mpz_out_raw(f, val) != 0;
+  if (putRecord(rec, len, val))
+    return;
+
+  mpz_t tmp;
+  mpz_init(tmp);
+  mpz_mod(tmp, val, prime);
+  bool ok = putRecord(rec, len, tmp);
+  assert(ok);
+  (void) ok;
+  mpz_clear(tmp);
 }
 
-template<> bool
-write<mpq_t>(FILE* f, const mpq_t& val)
+template<typename T> size_t
+recordsPerGate();
+
+template<> size_t
+recordsPerGate<mpz_t>()
+{ return 1; }
+
+template<> size_t
+recordsPerGate<mpq_t>()
+{ return 2; }
+
+static void
+write(char* rec, size_t len, const mpz_t val, const mpz_t prime)
 {
-  return (mpz_out_raw(f, mpq_numref(val)) != 0) && (mpz_out_raw(f, mpq_denref(val)) != 0);
+  putReduced(rec, len, val, prime);
 }
 
-template<typename T> bool
-read(T& val, FILE* f)
+static void
+write(char* rec, size_t len, const mpq_t val, const mpz_t prime)
 {
-  return fread(&val, sizeof(val), 1, f) == 1;
+  putReduced(rec, len, mpq_numref(val), prime);
+  putReduced(rec + len, len, mpq_denref(val), prime);
 }
 
-template<> bool
-read<mpz_t>(mpz_t& val, FILE* f)
+static void
+read(mpz_t val, const char* rec, size_t len)
 {
-  return mpz_inp_raw(val, f) != 0;
+  getRecord(val, rec, len);
 }
 
-template<> bool
-read<mpq_t>(mpq_t& val, FILE* f)
+static void
+read(mpq_t val, const char* rec, size_t len)
 {
-  return (mpz_inp_raw(mpq_numref(val), f) != 0) && (mpz_inp_raw(mpq_denref(val), f) != 0);
+  getRecord(mpq_numref(val), rec, len);
+  getRecord(mpq_denref(val), rec + len, len);
 }
 
 template<typename T> size_t
@@ -81,69 +127,107 @@ getRandom(Prng& prng)
   return out;
 }
 
-static FILE *
-open_file(const string& filename, const string& mode, const string& directory, bool createDir = true)
+bool LayerFile::
+open(const string& fileName, const vector<size_t>& layerSizes,
+     size_t recordBytes, size_t recordsPerGate)
 {
-  if (createDir)
-    recursive_mkdir(directory);
+  close();
+
+  vector<size_t> offs(1, 0);
+  for (size_t i = 0; i < layerSizes.size(); i++)
+    offs.push_back(offs.back() + layerSizes[i] * recordBytes * recordsPerGate);
+
+  int fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return false;
+  unlink(fileName.c_str());
 
-  string fname(directory);
-  fname += '/';
-  fname += filename;
-  return fopen(fname.c_str(), mode.c_str());
+  size_t size = offs.back();
+  if (size > 0)
+  {
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+      addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      ::close(fd);
+      return false;
+    }
+    base = static_cast<char*>(addr);
+    len = size;
+  }
+
+  ::close(fd);
+  recLen = recordBytes;
+  offsets.swap(offs);
+  saved.assign(layerSizes.size(), false);
+  return true;
+}
+
+void LayerFile::
+close()
+{
+  if (base != NULL)
+    munmap(base, len);
+  base = NULL;
+  len = 0;
+  recLen = 0;
+  offsets.clear();
+  saved.clear();
+}
+
+void LayerFile::
+prefetch(int layerIdx) const
+{
+  if (!isSaved(layerIdx))
+    return;
+
+  // madvise() wants a page-aligned start.
+  const size_t page = sysconf(_SC_PAGESIZE);
+  size_t begin = offsets[layerIdx] / page * page;
+  size_t end = offsets[layerIdx + 1];
+  if (end > begin)
+    madvise(base + begin, end - begin, MADV_WILLNEED);
 }
 
 template<typename T>
-bool LayerData<T>::
-save(const string& directory) const
+void LayerData<T>::
+save(LayerFile& file, const mpz_t prime) const
 {
   if (shouldSave())
   {
-    string name = layerName();
-    FILE* f;
-    if (!(f = open_file(layerName(), "wb", directory)))
-      return false;
-
-    RETURN_IF_FALSE(f, write(f, LAYER_DATA_HEADER));
-    RETURN_IF_FALSE(f, write(f, gates.size()));
-    for (size_t i = 0; i < gates.size(); i++)
-      RETURN_IF_FALSE(f, write(f, gates[i]));
-
-    fflush(f);
-    fclose(f);
+    char* rec = file.records(layer);
+    const size_t len = file.recordBytes();
+    const size_t width = len * recordsPerGate<T>();
+    for (size_t i = 0; i < gates.size(); i++, rec += width)
+      write(rec, len, gates[i], prime);
+    file.setSaved(layer);
   }
-  return true;
 }
 
 template<typename T>
-bool LayerData<T>::
-load(const string& directory)
+void LayerData<T>::
+load(const LayerFile& file, size_t size)
 {
-  string name = layerName();
-  FILE* f;
-  uint32_t header;
-  size_t size;
-
-  if (!(f = open_file(layerName(), "rb", directory, false)))
-    return false;
-
-  RETURN_IF_FALSE(f, read(header, f));
-  RETURN_IF_FALSE(f, read(size, f));
   gates.resize(size);
   isDirty = false;
 
-  for (size_t i = 0; i < gates.size(); i++)
-    RETURN_IF_FALSE(f, read(gates[i], f));
-
-  fclose(f);
-  return true;
+  const char* rec = file.records(layer);
+  const size_t len = file.recordBytes();
+  const size_t width = len * recordsPerGate<T>();
+  for (size_t i = 0; i < size; i++, rec += width)
+    read(gates[i], rec, len);
 }
 
 template<typename T>
 void LayerData<T>::
-tryLoad(const string& directory, size_t size)
+tryLoad(const LayerFile& file, size_t size)
 {
-  if (!load(directory))
+  if (file.isSaved(layer))
+  {
+    load(file, size);
+  }
+  else
   {
     if (gates.size() != size)
       gates.resize(size);
@@ -160,13 +244,15 @@ dataSize() const
 {
   double avg = 0;
 
+  // Evenly spaced samples, so that a layer's size doesn't change between
+  // being counted in and out of the usage.
   const uint32_t numSamples = 4;
   if (gates.size() > 0)
   {
     for (uint32_t i = 0; i < numSamples; i++)
     {
-      size_t idx = getRandom<size_t>(prng) % gates.size();
-      avg = sizeOf(gates[idx]);
+      size_t idx = i * (gates.size() - 1) / (numSamples - 1);
+      avg += sizeOf(gates[idx]);
     }
 
     avg /= numSamples;
@@ -175,15 +261,6 @@ dataSize() const
   return size_t(avg * gates.size()) + sizeof(this);
 }
 
-template<typename T>
-string LayerData<T>::
-layerName() const
-{
-  stringstream ss;
-  ss << "layer_" << index();
-  return ss.str();
-}
-
 template<typename T> string
 circuitPrefix()
 { //TODO: Use static_assert.
@@ -201,8 +278,10 @@ circuitPrefix<mpq_t>()
 template<typename T>
 CircuitData<T>::
 CircuitData(size_t memBudget, const std::vector<size_t>& sizes, const string& suffix)
-  : blocks(), blockSizes(sizes), circuitDir(), budget(memBudget), usage(0)
+  : blocks(), blockSizes(sizes), circuitDir(), budget(memBudget), usage(0),
+    file(), lastLoaded(-1)
 {
+  mpz_init(prime);
   stringstream ss;
 
   ss << FOLDER_STATE << "/" << circuitPrefix<T>() << "_";
@@ -230,6 +309,16 @@ CircuitData(size_t memBudget, const std::vector<size_t>& sizes, const string& su
     throw runtime_error("Could not create new directory for circuit.");
 }
 
+template<typename T>
+CircuitData<T>::
+~CircuitData()
+{
+  // the layer file is already unlinked; this leaves the directory empty.
+  file.close();
+  rmdir(circuitDir.c_str());
+  mpz_clear(prime);
+}
+
 template<typename T>
 LayerData<T>& CircuitData<T>::
 operator [](int layerIdx)
@@ -259,17 +348,30 @@ void CircuitData<T>::
 setSizes(const std::vector<size_t>& newSizes)
 {
   this->blockSizes = newSizes;
+
+  // saved layers are laid out by size.
+  file.close();
 }
 
 template<typename T>
-bool CircuitData<T>::
-save() const
+void CircuitData<T>::
+setPrime(const mpz_t newPrime)
 {
-  bool success = true;
+  mpz_set(prime, newPrime);
+
+  // and their records are sized by the prime.
+  file.close();
+}
+
+template<typename T>
+void CircuitData<T>::
+save()
+{
+  openFile();
+
   typedef typename deque<LayerData<T> >::const_iterator LayerDataCIt;
   for (LayerDataCIt it = blocks.begin(); it != blocks.end(); ++it)
-    success = it->save(circuitDir) && success;
-  return success;
+    it->save(file, prime);
 }
 
 template<typename T>
@@ -286,7 +388,8 @@ load(int layerIdx)
 
     //cout << "Evicting Layer: " << layer.index() << " Usage: " << usage << endl;
 
-    layer.save(circuitDir);
+    openFile();
+    layer.save(file, prime);
     usage -= layer.dataSize();
     blocks.pop_front();
   }
@@ -294,12 +397,41 @@ load(int layerIdx)
   //cout << "Load Layer: " << layerIdx << " Usage: " << usage << endl;
   blocks.push_back(LayerData<T>(layerIdx));
   LayerData<T>& newLayer = blocks.back();
-  newLayer.tryLoad(circuitDir, blockSizes[layerIdx]);
+  newLayer.tryLoad(file, blockSizes[layerIdx]);
   usage += newLayer.dataSize();
 
+  // Layers are walked in order, one way or the other: have the kernel read
+  // the next one in while this one is used.
+  int next = layerIdx + (layerIdx < lastLoaded ? -1 : 1);
+  if (inRange<int>(next, 0, blockSizes.size()))
+    file.prefetch(next);
+  lastLoaded = layerIdx;
+
   return newLayer;
 }
 
+template<typename T>
+void CircuitData<T>::
+openFile()
+{
+  if (file.isOpen())
+    return;
+
+  if (!file.open(circuitDir + "/layers", blockSizes, recordBytes(), recordsPerGate<T>()))
+    throw runtime_error("Could not create layer file for circuit.");
+}
+
+// modIfNeeded() leaves gate values under 2 * bits(prime) - 1 bits, so a
+// record of 2 * bits(prime) bits holds one with its sign. Anything wider
+// is saved reduced (see putReduced()).
+template<typename T>
+size_t CircuitData<T>::
+recordBytes() const
+{
+  assert(mpz_sgn(prime) > 0);
+  return (2 * mpz_sizeinbase(prime, 2) + 7) / 8;
+}
+
 template<typename T>
 void CircuitData<T>::
 updateUsage()
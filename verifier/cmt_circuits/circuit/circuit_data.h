@@ -8,7 +8,46 @@
 
 #include <common/mpnvector.h>
 
-#define LAYER_DATA_HEADER 0x11111111
+// Where a circuit's evicted layers go: one file, mapped read-write, with
+// room for every layer's records at a fixed offset. A gate value is one
+// record per mpz (an mpq is two, numerator then denominator): a
+// little-endian magnitude with the sign in the top bit. A layer saves and loads
+// in place, and the kernel can be asked to read the next one in while the
+// current one is in use. The file is unlinked as soon as it's mapped, so it
+// never outlives the process.
+class LayerFile
+{
+  char* base;
+  size_t len;
+  size_t recLen;
+  std::vector<size_t> offsets;
+  std::vector<bool> saved;
+
+  LayerFile(const LayerFile&);
+  LayerFile& operator=(const LayerFile&);
+
+public:
+  LayerFile()
+    : base(NULL), len(0), recLen(0) { }
+
+  ~LayerFile() { close(); }
+
+  // false (with errno set) if the file can't be created or mapped.
+  bool open(const std::string& fileName, const std::vector<size_t>& layerSizes,
+            size_t recordBytes, size_t recordsPerGate);
+  void close();
+
+  bool isOpen() const { return !offsets.empty(); }
+  bool isSaved(int layerIdx) const { return isOpen() && saved[layerIdx]; }
+  size_t recordBytes() const { return recLen; }
+
+  char*       records(int layerIdx)       { return base + offsets[layerIdx]; }
+  const char* records(int layerIdx) const { return base + offsets[layerIdx]; }
+  void setSaved(int layerIdx) { saved[layerIdx] = true; }
+
+  // Start reading a saved layer in from disk, without waiting for it.
+  void prefetch(int layerIdx) const;
+};
 
 template<typename T>
 class LayerData
@@ -32,19 +71,19 @@ public:
   int index() const { return layer; }
   void dirty() { isDirty = true; }
 
-  bool save(const std::string& dir) const;
-  bool load(const std::string& dir);
+  // a value too wide for its record is saved reduced mod prime.
+  void save(LayerFile& file, const mpz_t prime) const;
+  void load(const LayerFile& file, size_t size);
 
   /*
    * Attempt to load the layer, which should be of the specified size.
-   * If no layer was loaded, then create a zero-filled layer of that size.
+   * If no layer was saved, then create a zero-filled layer of that size.
    */
-  void tryLoad(const std::string& dir, size_t size);
+  void tryLoad(const LayerFile& file, size_t size);
 
   size_t dataSize() const;
 
 protected:
-  std::string layerName() const;
   bool shouldSave() const { return isDirty; }
 };
 
@@ -55,23 +94,31 @@ private:
   std::deque<LayerData<T> > blocks;
 
   std::vector<size_t> blockSizes;
+  mpz_t prime;
   std::string circuitDir;
   size_t budget;
   size_t usage;
 
+  LayerFile file;
+  int lastLoaded;
+
 public:
   CircuitData();
   CircuitData(size_t memBudget, const std::vector<size_t>& layerSizes, const std::string& suffix = "");
+  ~CircuitData();
 
   LayerData<T>& operator[](int layerIdx);
 
   void setBudget(size_t newBudget);
   void setSizes(const std::vector<size_t>& newSizes);
+  void setPrime(const mpz_t newPrime);
 
-  bool save() const;
+  void save();
   LayerData<T>& load(int layerIdx);
 
 protected:
+  void openFile();
+  size_t recordBytes() const;
   void updateUsage();
   bool shouldEvict(bool evictToAdd) const;
 };
@@ -5,6 +5,9 @@
 #include <common/utility.h>
 #include <common/debug_utils.h>
 #include <common/math.h>
+#include <common/poly_utils.h>
+#include <common/fp25519.h>
+#include <common/fp61.h>
 
 #include "cmtgkr_env.h"
 #include "circuit_layer.h"
@@ -12,6 +15,10 @@
 
 using namespace std;
 
+// Once a layer needs the chi tables anyway, a regular group shorter than
+// this is cheaper to sum directly than in closed form.
+#define BIT_WIRING_MIN_GATES 32
+
 GateWiring::
 GateWiring()
   : type(ADD), in1(0), in2(0)
@@ -91,22 +98,51 @@ Gate(CircuitLayer* layer, GateWiring wire, int label)
 }
 
 void Gate::
-getValue(mpq_t result) const { mpq_set(result, qValue()); }
+getValue(mpq_t result) const
+{
+  if (FieldStore* fv = layer->fieldValues())
+  {
+    fv->get(mpq_numref(result), layer->layer, idx);
+    mpz_set_ui(mpq_denref(result), 1);
+  }
+  else
+  {
+    mpq_set(result, qValue());
+  }
+}
 
 void Gate::
-getValue(mpz_t result) const { mpz_set(result, zValue()); }
+getValue(mpz_t result) const
+{
+  if (FieldStore* fv = layer->fieldValues())
+    fv->get(result, layer->layer, idx);
+  else
+    mpz_set(result, zValue());
+}
 
 mpq_t& Gate::
-qValue() { return layer->qData()[idx]; }
+qValue()
+{
+  mpq_t& q = layer->qData()[idx];
+  if (layer->fieldValues())
+    getValue(q);
+  return q;
+}
 
 const mpq_t& Gate::
-qValue() const { return layer->qData()[idx]; }
+qValue() const { return const_cast<Gate*>(this)->qValue(); }
 
 mpz_t& Gate::
-zValue() { return layer->zData()[idx]; }
+zValue()
+{
+  mpz_t& z = layer->zData()[idx];
+  if (layer->fieldValues())
+    getValue(z);
+  return z;
+}
 
 const mpz_t& Gate::
-zValue() const { return layer->zData()[idx]; }
+zValue() const { return const_cast<Gate*>(this)->zValue(); }
 
 void Gate::
 canonicalize()
@@ -118,6 +154,14 @@ canonicalize()
 void Gate::
 computeGateValue(const Gate& op1, const Gate& op2)
 {
+  if (FieldStore* fv = layer->fieldValues())
+  {
+    // the operands are this gate's inputs, by construction.
+    assert(op1.idx == wiring.in1 && op2.idx == wiring.in2);
+    fv->evalGates(*layer, layer->layer, idx, idx + 1);
+    return;
+  }
+
   MPQVector qOperand(2);
   op1.getValue(qOperand[0]);
   op2.getValue(qOperand[1]);
@@ -187,6 +231,16 @@ computeGateValue(const Gate& op1, const Gate& op2)
 void Gate::
 setValue(const mpq_t value)
 {
+  if (FieldStore* fv = layer->fieldValues())
+  {
+    mpz_t z;
+    mpz_init(z);
+    convert_to_z(z, value, layer->circuit->prime);
+    fv->set(layer->layer, idx, z);
+    mpz_clear(z);
+    return;
+  }
+
   mpq_set(qValue(), value);
   convert_to_z(zValue(), value, layer->circuit->prime);
   canonicalize();
@@ -195,6 +249,12 @@ setValue(const mpq_t value)
 void Gate::
 setValue(const mpz_t value)
 {
+  if (FieldStore* fv = layer->fieldValues())
+  {
+    fv->set(layer->layer, idx, value);
+    return;
+  }
+
   mpq_set_z(qValue(), value);
   mpz_set(zValue(), value);
   canonicalize();
@@ -203,6 +263,15 @@ setValue(const mpz_t value)
 void Gate::
 setValue(int value)
 {
+  if (FieldStore* fv = layer->fieldValues())
+  {
+    mpz_t z;
+    mpz_init_set_si(z, value);
+    fv->set(layer->layer, idx, z);
+    mpz_clear(z);
+    return;
+  }
+
   mpq_set_si(qValue(), value, 1);
   mpz_set_si(zValue(), value);
   canonicalize();
@@ -211,7 +280,7 @@ setValue(int value)
 CircuitLayer::
 CircuitLayer(Circuit* c, int layerIdx, int size)
   : circuit(c), layer(layerIdx),
-    gates(size), add_fn(NULL), mul_fn(NULL)
+    gates(size), copies(1), add_fn(NULL), mul_fn(NULL)
 {
   assert(inRange(size, 0, numeric_limits<int>::max()));
 }
@@ -257,6 +326,14 @@ operator[] (int idx) const
   return gates[idx];
 }
 
+void CircuitLayer::
+setCopies(int n)
+{
+  assert(n > 0 && size() % n == 0);
+  assert(n == 1 || pow2i(log2i(size() / n)) == size() / n);
+  copies = n;
+}
+
 void CircuitLayer::
 resize(int newSize)
 {
@@ -264,91 +341,397 @@ resize(int newSize)
   gates.resize(newSize);
 }
 
+// Where bit `bit` of each of idx's entries comes from, taking the entries'
+// positions t in the group as a counter: BIT_ZERO or BIT_ONE if it's the same
+// for every t, b if it's always bit b of t. false if neither.
+static bool
+bitSource(const vector<int>& idx, int bit, int& src)
+{
+  const int v0 = (idx[0] >> bit) & 1;
+  size_t first = 1;
+  while (first < idx.size() && ((idx[first] >> bit) & 1) == v0)
+    first++;
+
+  if (first == idx.size())
+  {
+    src = v0 ? GateGroup::BIT_ONE : GateGroup::BIT_ZERO;
+    return true;
+  }
+
+  // bit b of t first turns on at t = 2^b.
+  if (v0 != 0 || (first & (first - 1)) != 0)
+    return false;
+
+  const int b = log2i(first);
+  for (size_t t = first; t < idx.size(); t++)
+  {
+    if (((idx[t] >> bit) & 1) != (int) ((t >> b) & 1))
+      return false;
+  }
+  src = b;
+  return true;
+}
+
+static bool
+bitSources(const vector<int>& idx, int width, vector<int>& out)
+{
+  out.resize(width);
+  for (int bit = 0; bit < width; bit++)
+  {
+    if (!bitSource(idx, bit, out[bit]))
+      return false;
+  }
+  return true;
+}
+
+// Identity and aligned-offset layers, butterflies, pairwise reduction trees
+// and broadcasts all wire every gate of a kind the same way, up to which
+// bits of the gate's position go where. Such a group's wiring predicate
+// factors bit by bit (see bitWiringPredicate()), so it doesn't need the chi
+// tables at all. The search gives up at the first bit that doesn't fit, so
+// irregular groups cost little.
+static void
+findBitWiring(GateGroup& g, int gateWidth)
+{
+  g.regular = g.size() == 0;
+  if (g.regular || g.muxIdx.size() > 0)
+    return;
+
+  int maxIn = 0;
+  for (size_t j = 0; j < g.size(); j++)
+    maxIn = max(maxIn, max(g.in1[j], g.in2[j]));
+  const int inWidth = fls(maxIn);
+
+  g.regular = bitSources(g.gate, gateWidth, g.gateBits) &&
+              bitSources(g.in1, inWidth, g.in1Bits) &&
+              bitSources(g.in2, inWidth, g.in2Bits);
+}
+
+void CircuitLayer::
+makeGroups(vector<GateGroup>& out) const
+{
+  out.assign(GateGroup::NUM_KINDS, GateGroup());
+  for (int i = 0; i < copySize(); i++)
+  {
+    const GateWiring& wiring = gates[i];
+    GateGroup* g;
+    if (wiring.shouldBeTreatedAs(GateWiring::ADD))
+      g = &out[GateGroup::ADD];
+    else if (wiring.shouldBeTreatedAs(GateWiring::MUL))
+      g = &out[GateGroup::MUL];
+    else if (wiring.shouldBeTreatedAs(GateWiring::SUB))
+      g = &out[GateGroup::SUB];
+    else if (wiring.shouldBeTreatedAs(GateWiring::MUX))
+    {
+      g = &out[GateGroup::MUX];
+      g->muxIdx.push_back(getMuxIdx(i));
+    }
+    else
+      continue;
+
+    g->gate.push_back(i);
+    g->in1.push_back(wiring.in1);
+    g->in2.push_back(wiring.in2);
+  }
+
+  for (size_t k = 0; k < out.size(); k++)
+    findBitWiring(out[k], log2i(copySize()));
+}
+
+void CircuitLayer::
+groupGates()
+{
+  makeGroups(groups);
+}
+
+// Sum of chi_g(p) chi_in1(w1) chi_in2(w2) over the gates g of each kind.
+// The products are accumulated unreduced, with one reduction per predicate
+// at the end. Since w1 and w2 index the same layer, the chi tables for them
+// are built together for as long as their coordinates agree.
+const vector<GateGroup>& CircuitLayer::
+currentGroups(vector<GateGroup>& scratch) const
+{
+  // groups is stale if gates were changed after groupGates().
+  size_t grouped = 0;
+  for (size_t k = 0; k < groups.size(); k++)
+    grouped += groups[k].size();
+  if (!groups.empty() && grouped == (size_t) copySize())
+    return groups;
+
+  makeGroups(scratch);
+  return scratch;
+}
+
+// The sum over t < n of f(t_0, 0) f(t_1, 1) ..., where f(0, b) = f0[b] and
+// f(1, b) = f1[b] for the log2i(n) bits of t. Walking the bits of n from the
+// top, each set bit contributes the t that match n above it and have a 0
+// there, which costs O(log n) rather than O(n).
+template<typename F> static F
+digitSum(const vector<F>& f0, const vector<F>& f1, int n)
+{
+  const int bits = log2i(n);
+  vector<F> below(bits + 1);
+  below[0] = F(1);
+  for (int j = 0; j < bits; j++)
+    below[j + 1] = below[j] * (f0[j] + f1[j]);
+
+  if (n == 1 << bits)
+    return below[bits];
+
+  F sum, prefix(1);
+  for (int j = bits - 1; j >= 0; j--)
+  {
+    if ((n >> j) & 1)
+    {
+      sum += prefix * f0[j] * below[j];
+      prefix *= f1[j];
+    }
+    else
+    {
+      prefix *= f0[j];
+    }
+  }
+  return sum;
+}
+
+static void
+digitSum(mpz_class& rop, const vector<mpz_class>& f0, const vector<mpz_class>& f1, int n, const mpz_class& p)
+{
+  const int bits = log2i(n);
+  vector<mpz_class> below(bits + 1);
+  below[0] = 1;
+  for (int j = 0; j < bits; j++)
+    below[j + 1] = below[j] * (f0[j] + f1[j]) % p;
+
+  if (n == 1 << bits)
+  {
+    rop = below[bits];
+    return;
+  }
+
+  mpz_class prefix(1);
+  rop = 0;
+  for (int j = bits - 1; j >= 0; j--)
+  {
+    if ((n >> j) & 1)
+    {
+      rop += prefix * f0[j] % p * below[j];
+      prefix = prefix * f1[j] % p;
+    }
+    else
+    {
+      prefix = prefix * f0[j] % p;
+    }
+  }
+}
+
+// The copy half of a replicated layer's wiring predicates: the sum over
+// copies k < n of eq(k, p) eq(k, w1) eq(k, w2), where p, w1 and w2 are the
+// log2i(n) coordinates of rand starting at pAt, w1At and w2At.
+template<typename F> static F
+copyPredicate(int n, const vector<F>& rand, int pAt, int w1At, int w2At)
+{
+  const int bits = log2i(n);
+  vector<F> f0(bits), f1(bits);
+  for (int j = 0; j < bits; j++)
+  {
+    const F& a = rand[pAt + j];
+    const F& b = rand[w1At + j];
+    const F& c = rand[w2At + j];
+    f1[j] = a * b * c;
+    f0[j] = (F(1) - a) * (F(1) - b) * (F(1) - c);
+  }
+  return digitSum(f0, f1, n);
+}
+
+static void
+copyPredicate(mpz_t rop, int n, const MPZVector& rand, int pAt, int w1At, int w2At, const mpz_t prime)
+{
+  const int bits = log2i(n);
+  mpz_class p(prime);
+  vector<mpz_class> f0(bits), f1(bits);
+  for (int j = 0; j < bits; j++)
+  {
+    mpz_class a(rand[pAt + j]), b(rand[w1At + j]), c(rand[w2At + j]);
+    f1[j] = a * b % p * c % p;
+    f0[j] = (1 - a) * (1 - b) % p * (1 - c) % p;
+  }
+
+  mpz_class sum;
+  digitSum(sum, f0, f1, n, p);
+
+  // f0 can come out negative.
+  mpz_mod(rop, sum.get_mpz_t(), prime);
+}
+
+// A regular group's predicate (see findBitWiring()): each coordinate of p,
+// w1 and w2 is a constant factor, or a factor on one bit of the gate's
+// position in the group, and digitSum() adds those up over the positions.
+// The index bits past what the group uses are 0.
+template<typename F> static void
+bitFactors(const vector<int>& src, const vector<F>& rand, int at, int width,
+           vector<F>& f0, vector<F>& f1, F& scale)
+{
+  assert(src.size() <= (size_t) width);
+  for (int i = 0; i < width; i++)
+  {
+    const F& r = rand[at + i];
+    const int s = i < (int) src.size() ? src[i] : GateGroup::BIT_ZERO;
+    if (s == GateGroup::BIT_ZERO)
+      scale *= F(1) - r;
+    else if (s == GateGroup::BIT_ONE)
+      scale *= r;
+    else
+    {
+      f0[s] *= F(1) - r;
+      f1[s] *= r;
+    }
+  }
+}
+
+template<typename F> static F
+bitWiringPredicate(const GateGroup& g, const vector<F>& rand, int pWidth, int w1At, int w2At, int inWidth)
+{
+  const int bits = log2i((int) g.size());
+  vector<F> f0(bits, F(1)), f1(bits, F(1));
+  F scale(1);
+  bitFactors(g.gateBits, rand, 0, pWidth, f0, f1, scale);
+  bitFactors(g.in1Bits, rand, w1At, inWidth, f0, f1, scale);
+  bitFactors(g.in2Bits, rand, w2At, inWidth, f0, f1, scale);
+  return scale * digitSum(f0, f1, g.size());
+}
+
+static void
+bitFactors(const vector<int>& src, const MPZVector& rand, int at, int width,
+           vector<mpz_class>& f0, vector<mpz_class>& f1, mpz_class& scale, const mpz_class& p)
+{
+  assert(src.size() <= (size_t) width);
+  for (int i = 0; i < width; i++)
+  {
+    mpz_class r(rand[at + i]);
+    const int s = i < (int) src.size() ? src[i] : GateGroup::BIT_ZERO;
+    if (s == GateGroup::BIT_ZERO)
+      scale = scale * (1 - r) % p;
+    else if (s == GateGroup::BIT_ONE)
+      scale = scale * r % p;
+    else
+    {
+      f0[s] = f0[s] * (1 - r) % p;
+      f1[s] = f1[s] * r % p;
+    }
+  }
+}
+
+static void
+bitWiringPredicate(mpz_t rop, const GateGroup& g, const MPZVector& rand, int pWidth, int w1At, int w2At, int inWidth,
+                   const mpz_t prime)
+{
+  const int bits = log2i((int) g.size());
+  mpz_class p(prime);
+  vector<mpz_class> f0(bits, 1), f1(bits, 1);
+  mpz_class scale(1);
+  bitFactors(g.gateBits, rand, 0, pWidth, f0, f1, scale, p);
+  bitFactors(g.in1Bits, rand, w1At, inWidth, f0, f1, scale, p);
+  bitFactors(g.in2Bits, rand, w2At, inWidth, f0, f1, scale, p);
+
+  mpz_class sum;
+  digitSum(sum, f0, f1, g.size(), p);
+  sum *= scale;
+  mpz_mod(rop, sum.get_mpz_t(), prime);
+}
+
 void CircuitLayer::
 computeWirePredicates(mpz_t add_predr, mpz_t mul_predr, mpz_t sub_predr, mpz_t muxl_predr, mpz_t muxr_predr, 
                      const vector<bool> muxBits, const MPZVector& rand, int inputLayerSize, const mpz_t prime) const
 {
   const int mi = logSize();
-  const int ni = size();
   const int mip1 = log2i(inputLayerSize);
-  const int nip1 = inputLayerSize;
 
+  // The chi tables only cover the first copy: the rest of the coordinates
+  // are the copy index, for copyPredicate().
+  const int ni = copySize();
+  const int nip1 = inputLayerSize / copies;
+  const int copyIn = log2i(nip1);
 
-  mpz_set_ui(add_predr, 0);
-  mpz_set_ui(mul_predr, 0);
-  mpz_set_ui(sub_predr, 0);
-  mpz_set_ui(muxl_predr, 0);
-  mpz_set_ui(muxr_predr, 0);
-  // Here, no function was provided, so we compute by brute force.
-  MPZVector pChi(ni);
-  MPZVector w1Chi(nip1);
-  MPZVector w2Chi(nip1);
+  vector<GateGroup> local;
+  const vector<GateGroup>* grp = &currentGroups(local);
 
-  MPZVector pR(mi);
-  MPZVector wR(mip1);
+  // and only the irregular groups need them.
+  bool tables = false;
+  for (size_t k = 0; k < grp->size(); k++)
+    tables = tables || !(*grp)[k].regular;
 
-  pR.copy(rand, 0, mi);
-  computeChiAll(pChi,  pR,  prime);
+  MPZVector pChi(tables ? ni : 0);
+  if (tables)
+    computeChiAll(pChi, ni, rand, 0, prime);
 
-  wR.copy(rand, mi, mip1);
-  computeChiAll(w1Chi, wR, prime);
+  int shared = 0;
+  while (tables && shared < copyIn && mpz_cmp(rand[mi + shared], rand[mi + mip1 + shared]) == 0)
+    shared++;
 
-  wR.copy(rand, mi + mip1, mip1);
-  computeChiAll(w2Chi, wR, prime);
+  MPZVector w1Chi(tables ? nip1 : 0);
+  MPZVector w2Chi(tables && shared < copyIn ? nip1 : 0);
+  if (tables && shared < copyIn)
+  {
+    extendChiAll(w1Chi, size_t(1) << shared, rand, mi, 0, prime);
+    for (int i = 0; i < (1 << shared); i++)
+      mpz_set(w2Chi[i], w1Chi[i]);
+    extendChiAll(w1Chi, nip1, rand, mi, shared, prime);
+    extendChiAll(w2Chi, nip1, rand, mi + mip1, shared, prime);
+  }
+  else if (tables)
+  {
+    computeChiAll(w1Chi, nip1, rand, mi, prime);
+  }
+  const MPZVector& w2ChiRef = (shared < copyIn) ? w2Chi : w1Chi;
 
   mpz_t tmp;
   mpz_init(tmp);
 
-  for (int i = 0; i < size(); i++)
+  mpz_ptr acc[GateGroup::MUX] = { add_predr, mul_predr, sub_predr };
+  for (int k = GateGroup::ADD; k < GateGroup::MUX; k++)
   {
-    const GateWiring& wiring = gates[i];
-    if (wiring.shouldBeTreatedAs(GateWiring::ADD))
+    const GateGroup& g = (*grp)[k];
+    mpz_ptr sum = acc[k];
+    if (g.regular && (!tables || g.size() >= BIT_WIRING_MIN_GATES))
     {
-      mpz_mul(tmp, pChi[i], w1Chi[wiring.in1]);
-      modmult(tmp, tmp, w2Chi[wiring.in2], prime);
-      mpz_add(add_predr, add_predr, tmp);
+      bitWiringPredicate(sum, g, rand, log2i(ni), mi, mi + mip1, copyIn, prime);
+      continue;
     }
 
-    if (wiring.shouldBeTreatedAs(GateWiring::MUL))
+    mpz_set_ui(sum, 0);
+    for (size_t j = 0; j < g.size(); j++)
     {
-      mpz_mul(tmp, pChi[i], w1Chi[wiring.in1]);
-      modmult(tmp, tmp, w2Chi[wiring.in2], prime);
-      mpz_add(mul_predr, mul_predr, tmp);
+      mpz_mul(tmp, pChi[g.gate[j]], w1Chi[g.in1[j]]);
+      mpz_addmul(sum, tmp, w2ChiRef[g.in2[j]]);
     }
+    mpz_mod(sum, sum, prime);
+  }
 
-    if (wiring.shouldBeTreatedAs(GateWiring::SUB)) {
-        mpz_mul(tmp, pChi[i], w1Chi[wiring.in1]);
-        modmult(tmp, tmp, w2Chi[wiring.in2], prime);
-        mpz_add(sub_predr, sub_predr, tmp);
-    }
+  // a mux gate goes to muxr if its selector bit is set, otherwise to muxl.
+  mpz_set_ui(muxl_predr, 0);
+  mpz_set_ui(muxr_predr, 0);
+  const GateGroup& mux = (*grp)[GateGroup::MUX];
+  for (size_t j = 0; j < mux.size(); j++)
+  {
+    mpz_mul(tmp, pChi[mux.gate[j]], w1Chi[mux.in1[j]]);
+    mpz_addmul(muxBits[mux.muxIdx[j]] ? muxr_predr : muxl_predr, tmp, w2ChiRef[mux.in2[j]]);
+  }
+  mpz_mod(muxl_predr, muxl_predr, prime);
+  mpz_mod(muxr_predr, muxr_predr, prime);
 
-    if (wiring.shouldBeTreatedAs(GateWiring::MUX)) {
-        //        GatePosition gatePos(layer, gates[i].idx);
-        int muxIdx = getMuxIdx(i);
-        //        cout << "muxIdx: " << muxIdx << endl;
-        if (muxBits[muxIdx]) {
-            mpz_mul(tmp, pChi[i], w1Chi[wiring.in1]);
-            modmult(tmp, tmp, w2Chi[wiring.in2], prime);
-            mpz_add(muxr_predr, muxr_predr, tmp);
-        }
-        else {
-            mpz_mul(tmp, pChi[i], w1Chi[wiring.in1]);
-            modmult(tmp, tmp, w2Chi[wiring.in2], prime);
-            mpz_add(muxl_predr, muxl_predr, tmp);
-        }
-        
+  if (copies > 1)
+  {
+    copyPredicate(tmp, copies, rand, log2i(ni), mi + copyIn, mi + mip1 + copyIn, prime);
+    mpz_ptr preds[] = { add_predr, mul_predr, sub_predr, muxl_predr, muxr_predr };
+    for (int k = 0; k < 5; k++)
+    {
+      mpz_mul(preds[k], preds[k], tmp);
+      mpz_mod(preds[k], preds[k], prime);
     }
-
-    //g_z()  = add() (v1 + v2) + mul() (v1 * v2) + sub() (v1 - v2) muxl() v1 + muxr() v2
   }
-  mpz_clear(tmp);
 
-    mpz_mod(add_predr, add_predr, prime);
-    mpz_mod(mul_predr, mul_predr, prime);
-    mpz_mod(sub_predr, sub_predr, prime);
-    mpz_mod(muxr_predr, muxr_predr, prime);
-    mpz_mod(muxl_predr, muxl_predr, prime);
-    
+  mpz_clear(tmp);
 }
 
 
@@ -384,3 +767,99 @@ zData() const
   assert(circuit->valid);
   return circuit->zData[layer];
 }
+
+FieldStore* CircuitLayer::
+fieldValues() const
+{
+  return circuit->fieldValues;
+}
+
+template<typename F> void CircuitLayer::
+computeWirePredicates(F& add_predr, F& mul_predr, F& sub_predr, F& muxl_predr, F& muxr_predr,
+                      const vector<bool> muxBits, const vector<F>& rand, int inputLayerSize) const
+{
+  const int mi = logSize();
+  const int mip1 = log2i(inputLayerSize);
+  const int ni = copySize();
+  const int nip1 = inputLayerSize / copies;
+  const int copyIn = log2i(nip1);
+
+  vector<GateGroup> local;
+  const vector<GateGroup>& grp = currentGroups(local);
+
+  bool tables = false;
+  for (size_t k = 0; k < grp.size(); k++)
+    tables = tables || !grp[k].regular;
+
+  vector<F> pChi(tables ? ni : 0);
+  if (tables)
+    computeChiAll(pChi, ni, rand, 0);
+
+  // as in the mpz version, w1 and w2 share the chi table of their common
+  // prefix.
+  int shared = 0;
+  while (tables && shared < copyIn && rand[mi + shared] == rand[mi + mip1 + shared])
+    shared++;
+
+  vector<F> w1Chi(tables ? nip1 : 0);
+  vector<F> w2Chi(tables && shared < copyIn ? nip1 : 0);
+  if (tables && shared < copyIn)
+  {
+    extendChiAll(w1Chi, size_t(1) << shared, rand, mi, 0);
+    copy(w1Chi.begin(), w1Chi.begin() + (1 << shared), w2Chi.begin());
+    extendChiAll(w1Chi, nip1, rand, mi, shared);
+    extendChiAll(w2Chi, nip1, rand, mi + mip1, shared);
+  }
+  else if (tables)
+  {
+    computeChiAll(w1Chi, nip1, rand, mi);
+  }
+  const vector<F>& w2ChiRef = (shared < copyIn) ? w2Chi : w1Chi;
+
+  F* acc[GateGroup::MUX] = { &add_predr, &mul_predr, &sub_predr };
+  for (int k = GateGroup::ADD; k < GateGroup::MUX; k++)
+  {
+    const GateGroup& g = grp[k];
+    if (g.regular && (!tables || g.size() >= BIT_WIRING_MIN_GATES))
+    {
+      *acc[k] = bitWiringPredicate(g, rand, log2i(ni), mi, mi + mip1, copyIn);
+      continue;
+    }
+
+    F sum;
+    for (size_t j = 0; j < g.size(); j++)
+      sum += pChi[g.gate[j]] * w1Chi[g.in1[j]] * w2ChiRef[g.in2[j]];
+    *acc[k] = sum;
+  }
+
+  // a mux gate goes to muxr if its selector bit is set, otherwise to muxl.
+  F muxl, muxr;
+  const GateGroup& mux = grp[GateGroup::MUX];
+  for (size_t j = 0; j < mux.size(); j++)
+  {
+    const F term = pChi[mux.gate[j]] * w1Chi[mux.in1[j]] * w2ChiRef[mux.in2[j]];
+    if (muxBits[mux.muxIdx[j]])
+      muxr += term;
+    else
+      muxl += term;
+  }
+  muxl_predr = muxl;
+  muxr_predr = muxr;
+
+  if (copies > 1)
+  {
+    const F eq = copyPredicate(copies, rand, log2i(ni), mi + copyIn, mi + mip1 + copyIn);
+    add_predr *= eq;
+    mul_predr *= eq;
+    sub_predr *= eq;
+    muxl_predr *= eq;
+    muxr_predr *= eq;
+  }
+}
+
+template void CircuitLayer::computeWirePredicates<Fp25519>(
+    Fp25519&, Fp25519&, Fp25519&, Fp25519&, Fp25519&,
+    const vector<bool>, const vector<Fp25519>&, int) const;
+template void CircuitLayer::computeWirePredicates<Fp61>(
+    Fp61&, Fp61&, Fp61&, Fp61&, Fp61&,
+    const vector<bool>, const vector<Fp61>&, int) const;
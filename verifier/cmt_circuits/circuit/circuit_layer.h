@@ -14,6 +14,7 @@ typedef void (*mle_fn)(mpz_t rop, const mpz_t* r, int mi, int mip1, int ni, int
 
 class CircuitLayer;
 class Circuit;
+class FieldStore;
 
 class GateWiring
 {
@@ -36,6 +37,32 @@ public:
   void applyGateOperation(mpz_t rop, const mpz_t op1, const mpz_t op2, const mpz_t prime) const;
 };
 
+// The gates of a layer that contribute to one wiring predicate, as
+// parallel arrays (see CircuitLayer::computeWirePredicates()).
+struct GateGroup
+{
+  enum Kind { ADD, MUL, SUB, MUX, NUM_KINDS };
+  enum { BIT_ZERO = -1, BIT_ONE = -2 };
+
+  std::vector<int> gate;
+  std::vector<int> in1;
+  std::vector<int> in2;
+  std::vector<int> muxIdx; // MUX only
+
+  // Set if each bit of every gate, in1 and in2 index is a constant
+  // (BIT_ZERO/BIT_ONE) or bit b of the gate's position in the group, as
+  // the *Bits say; the predicate then has a closed form that costs
+  // O(log n) and needs no chi tables.
+  bool regular;
+  std::vector<int> gateBits;
+  std::vector<int> in1Bits;
+  std::vector<int> in2Bits;
+
+  GateGroup() : regular(false) { }
+
+  size_t size() const { return gate.size(); }
+};
+
 class Gate
 {
 public:
@@ -49,6 +76,9 @@ public:
   void getValue(mpz_t result) const;
   void getValue(mpq_t result) const;
 
+  // In field-only mode (Circuit::setFieldEvaluation()), these copy the
+  // gate's field value into the mpq/mpz stores and return that copy, so
+  // writes through them only stick if followed by a setValue().
   mpq_t&       qValue();
   const mpq_t& qValue() const;
   mpz_t&       zValue();
@@ -70,10 +100,20 @@ private:
 
   std::vector<GateWiring> gates;
 
+  // data-parallel copies of one subcircuit, each in a power-of-two slot of
+  // this layer and the next (see PWSCircuitParser::replicate()).
+  int copies;
 
+  // gates grouped by GateGroup::Kind; built by groupGates() once the
+  // layer is complete.
+  std::vector<GateGroup> groups;
   
   friend class Gate;
 
+  void makeGroups(std::vector<GateGroup>& out) const;
+  // groups, or (if it's stale) the groups rebuilt in scratch.
+  const std::vector<GateGroup>& currentGroups(std::vector<GateGroup>& scratch) const;
+
 public:
   mle_fn add_fn;
   mle_fn mul_fn;
@@ -85,6 +125,13 @@ public:
   int size() const;
   int logSize() const;
 
+  // The layer is copies slots of copySize() gates, copy k of gate g at
+  // k * copySize() + g; all copies are wired alike, so the wiring
+  // predicates only look at the first.
+  void setCopies(int n);
+  int numCopies() const { return copies; }
+  int copySize() const { return size() / copies; }
+
   Gate       gate(int idx);
   const Gate gate(int idx) const;
 
@@ -92,10 +139,16 @@ public:
   const GateWiring& operator[](int idx) const;
 
   void resize(int newSize);
+  void groupGates();
   void computeWirePredicates(
             mpz_t add_predr, mpz_t mul_predr, mpz_t sub_predr, mpz_t muxl_predr, mpz_t muxr_predr,
             const std::vector<bool> muxBits, const MPZVector& rand, int inputLayerSize,
             const mpz_t prime) const;
+  // The same over a fixed-width field type F (Fp25519 or Fp61, see
+  // common/fp25519.h and common/fp61.h), whose modulus is implied.
+  template<typename F> void computeWirePredicates(
+            F& add_predr, F& mul_predr, F& sub_predr, F& muxl_predr, F& muxr_predr,
+            const std::vector<bool> muxBits, const std::vector<F>& rand, int inputLayerSize) const;
 
 protected:
   LayerMPQData&       qData();
@@ -104,6 +157,8 @@ protected:
   LayerMPZData&       zData();
   const LayerMPZData& zData() const;
 
+  // the circuit's values in field-only mode, else NULL.
+  FieldStore* fieldValues() const;
 
 };
 
@@ -0,0 +1,76 @@
+#include <cassert>
+
+#include <common/fp25519.h>
+#include <common/fp61.h>
+
+#include "circuit_layer.h"
+#include "field_store.h"
+
+using namespace std;
+
+// is prime = 2^bits - delta?
+static bool
+isPrime(const mpz_t prime, unsigned long bits, unsigned long delta)
+{
+  mpz_t p;
+  mpz_init_set_ui(p, 1);
+  mpz_mul_2exp(p, p, bits);
+  mpz_sub_ui(p, p, delta);
+  bool eq = mpz_cmp(p, prime) == 0;
+  mpz_clear(p);
+  return eq;
+}
+
+FieldStore* FieldStore::
+forPrime(const mpz_t prime)
+{
+  if (isPrime(prime, 61, 1))
+    return new FieldStoreImpl<Fp61>();
+  if (isPrime(prime, 255, 19))
+    return new FieldStoreImpl<Fp25519>();
+  return NULL;
+}
+
+template<typename F> void FieldStoreImpl<F>::
+resize(const vector<size_t>& layerSizes)
+{
+  values.resize(layerSizes.size());
+  for (size_t i = 0; i < layerSizes.size(); i++)
+    values[i].assign(layerSizes[i], F());
+}
+
+// DIV_INT's field value is the product, as in GateWiring::applyGateOperation()
+// (its quotient only shows up in the rationals).
+template<typename F> void FieldStoreImpl<F>::
+evalGates(const CircuitLayer& layer, int lvl, int begin, int end)
+{
+  const vector<F>& in = values[lvl + 1];
+  vector<F>& out = values[lvl];
+
+  for (int g = begin; g < end; g++)
+  {
+    const GateWiring& wiring = layer[g];
+    const F& op1 = in[wiring.in1];
+    const F& op2 = in[wiring.in2];
+
+    switch (wiring.type)
+    {
+      case GateWiring::ADD:
+        out[g] = op1 + op2;
+        break;
+      case GateWiring::MUL:
+      case GateWiring::DIV_INT:
+        out[g] = op1 * op2;
+        break;
+      case GateWiring::SUB:
+        out[g] = op1 - op2;
+        break;
+      default:
+        // mux gates need the selector bits, which only V and P have.
+        assert(false);
+    }
+  }
+}
+
+template class FieldStoreImpl<Fp61>;
+template class FieldStoreImpl<Fp25519>;
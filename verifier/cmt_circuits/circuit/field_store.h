@@ -0,0 +1,55 @@
+#ifndef CODE_PEPPER_CMTGKR_CIRCUIT_FIELD_STORE_H_
+#define CODE_PEPPER_CMTGKR_CIRCUIT_FIELD_STORE_H_
+
+#include <gmp.h>
+#include <vector>
+
+class CircuitLayer;
+
+// Gate values for the field-only evaluation mode (see
+// Circuit::setFieldEvaluation()): each layer is one contiguous array of
+// fixed-width field elements, and gates are evaluated straight from the
+// layer's GateWiring array, with no rationals and no per-gate allocation.
+//
+// The element type is picked from the circuit's prime, so this is only
+// available for the primes that have a native field type (forPrime()
+// returns NULL otherwise).
+class FieldStore
+{
+public:
+  virtual ~FieldStore() { }
+
+  virtual void resize(const std::vector<size_t>& layerSizes) = 0;
+
+  virtual void get(mpz_t rop, int layer, int gate) const = 0;
+  virtual void set(int layer, int gate, const mpz_t value) = 0;
+
+  // Layer layer's values as an array of the field type, for code that was
+  // compiled against that type (see PWSCompiledEval).
+  virtual void* data(int layer) = 0;
+
+  // Evaluate gates [begin, end) of circuit layer lvl from the values of
+  // layer lvl + 1.
+  virtual void evalGates(const CircuitLayer& layer, int lvl, int begin, int end) = 0;
+
+  // The store for this prime, or NULL if there is no native field for it.
+  static FieldStore* forPrime(const mpz_t prime);
+};
+
+template<typename F>
+class FieldStoreImpl : public FieldStore
+{
+private:
+  std::vector<std::vector<F> > values;
+
+public:
+  void resize(const std::vector<size_t>& layerSizes);
+
+  void get(mpz_t rop, int layer, int gate) const { values[layer][gate].get(rop); }
+  void set(int layer, int gate, const mpz_t value) { values[layer][gate].set(value); }
+  void* data(int layer) { return values[layer].data(); }
+
+  void evalGates(const CircuitLayer& layer, int lvl, int begin, int end);
+};
+
+#endif
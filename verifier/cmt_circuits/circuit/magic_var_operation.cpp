@@ -30,6 +30,11 @@ void MagicVarOperation::
 setVal(PWSCircuit& c, const GatePosition& pos, const mpz_t val)
 {
   Gate g = getGate(c, pos);
+  if (c.fieldEvaluation())
+  {
+    g.setValue(val);
+    return;
+  }
   mpz_set(g.zValue(), val);
   mpq_set_z(g.qValue(), val);
 }
@@ -38,10 +43,31 @@ void MagicVarOperation::
 setVal(PWSCircuit& c, const GatePosition& pos, int val)
 {
   Gate g = getGate(c, pos);
+  if (c.fieldEvaluation())
+  {
+    g.setValue(val);
+    return;
+  }
   mpz_set_ui(g.zValue(), val);
   mpq_set_ui(g.qValue(), val, 1);
 }
 
+GatePosition MagicVarOperation::
+shift(const GatePosition& pos, const vector<int>& offsets)
+{
+  return GatePosition(pos.layer, pos.name + offsets[pos.layer]);
+}
+
+vector<GatePosition> MagicVarOperation::
+shift(const vector<GatePosition>& pos, const vector<int>& offsets)
+{
+  vector<GatePosition> out;
+  out.reserve(pos.size());
+  for (size_t i = 0; i < pos.size(); i++)
+    out.push_back(shift(pos[i], offsets));
+  return out;
+}
+
 NotEqualOperation::
 NotEqualOperation(GatePosition m,
                   GatePosition x1,
@@ -73,6 +99,12 @@ computeMagicGates(PWSCircuit& c)
   }
 }
 
+MagicVarOperation* NotEqualOperation::
+shifted(const vector<int>& offsets) const
+{
+  return new NotEqualOperation(shift(M, offsets), shift(X1, offsets), shift(X2, offsets));
+}
+
 LessThanIntOperation::
 LessThanIntOperation(vector<GatePosition>& ms,
                      vector<GatePosition>& ns,
@@ -183,6 +215,14 @@ computeMagicGates(PWSCircuit& c)
   mpz_clear(diff);
 }
 
+MagicVarOperation* LessThanIntOperation::
+shifted(const vector<int>& offsets) const
+{
+  vector<GatePosition> ms = shift(Ms, offsets);
+  vector<GatePosition> ns = shift(Ns, offsets);
+  return new LessThanIntOperation(ms, ns, shift(X1, offsets), shift(X2, offsets));
+}
+
 LessThanFloatOperation::
 LessThanFloatOperation(vector<GatePosition>& ms,
                        vector<GatePosition>& ns,
@@ -234,3 +274,11 @@ computeMagicGates(PWSCircuit& c)
   mpq_clear(diff);
 }
 
+MagicVarOperation* LessThanFloatOperation::
+shifted(const vector<int>& offsets) const
+{
+  vector<GatePosition> ms = shift(Ms, offsets);
+  vector<GatePosition> ns = shift(Ns, offsets);
+  vector<GatePosition> ds = shift(Ds, offsets);
+  return new LessThanFloatOperation(ms, ns, ds, shift(X1, offsets), shift(X2, offsets));
+}
@@ -10,13 +10,24 @@
 
 #include "pws_primitives.h"
 
+class PWSCompiledCircuit;
+class PWSCodegenWriter;
+
 class MagicVarOperation
 {
   public:
   virtual ~MagicVarOperation() { }
   virtual void computeMagicGates(PWSCircuit& c) = 0;
 
+  // The same operation on another copy of the circuit, whose gates sit
+  // offsets[layer] further along each layer (see
+  // PWSCircuitParser::replicate()).
+  virtual MagicVarOperation* shifted(const std::vector<int>& offsets) const = 0;
+
   protected:
+  static GatePosition shift(const GatePosition& pos, const std::vector<int>& offsets);
+  static std::vector<GatePosition> shift(const std::vector<GatePosition>& pos, const std::vector<int>& offsets);
+
   Gate getGate(PWSCircuit& c, const GatePosition& pos);
 
   mpz_t& getZ(PWSCircuit& c, const GatePosition& pos);
@@ -28,6 +39,9 @@ class MagicVarOperation
 
 class NotEqualOperation : public MagicVarOperation
 {
+  friend class PWSCompiledCircuit;
+  friend class PWSCodegenWriter;
+
   protected:
   GatePosition M;
   GatePosition X1;
@@ -40,6 +54,7 @@ class NotEqualOperation : public MagicVarOperation
       GatePosition x2);
 
   void computeMagicGates(PWSCircuit& c);
+  MagicVarOperation* shifted(const std::vector<int>& offsets) const;
 };
 
 class LessThanIntOperation : public MagicVarOperation
@@ -59,6 +74,7 @@ class LessThanIntOperation : public MagicVarOperation
       GatePosition x2);
 
   void computeMagicGates(PWSCircuit& c);
+  MagicVarOperation* shifted(const std::vector<int>& offsets) const;
 
   protected:
   void computeMs(PWSCircuit& c, int sgn);
@@ -67,6 +83,8 @@ class LessThanIntOperation : public MagicVarOperation
 
 class LessThanFloatOperation : public LessThanIntOperation
 {
+  friend class PWSCompiledCircuit;
+
   protected:
   std::vector<GatePosition> Ds;
 
@@ -79,6 +97,7 @@ class LessThanFloatOperation : public LessThanIntOperation
       GatePosition x2);
 
   void computeMagicGates(PWSCircuit& c);
+  MagicVarOperation* shifted(const std::vector<int>& offsets) const;
 };
 
 #endif
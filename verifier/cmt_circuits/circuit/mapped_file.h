@@ -0,0 +1,80 @@
+#ifndef CODE_PEPPER_CMTGKR_CIRCUIT_MAPPED_FILE_H_
+#define CODE_PEPPER_CMTGKR_CIRCUIT_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A whole file mapped read-only, for the PWS parser, the compiled-circuit
+// loader, and the verifier's precomputation and trace files. The mapping
+// goes away with the object.
+class MappedFile
+{
+  void* addr;
+  size_t len;
+
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  public:
+  MappedFile()
+    : addr(NULL), len(0)
+  { }
+
+  ~MappedFile() { close(); }
+
+  // false (with errno set) if the file can't be opened or mapped. advice
+  // is for madvise(): the default suits a file read front to back, once,
+  // like a worksheet; MADV_RANDOM one read a record at a time in any
+  // order, like a precomputation file; MADV_NORMAL one read front to back
+  // more than once, like a trace being replayed.
+  bool open(const std::string& fileName, int advice = MADV_SEQUENTIAL)
+  {
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+      ::close(fd);
+      return false;
+    }
+
+    len = st.st_size;
+    if (len > 0)
+    {
+      addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED)
+      {
+        addr = NULL;
+        len = 0;
+        ::close(fd);
+        return false;
+      }
+      madvise(addr, len, advice);
+    }
+
+    ::close(fd);
+    return true;
+  }
+
+  void close()
+  {
+    if (addr != NULL)
+      munmap(addr, len);
+    addr = NULL;
+    len = 0;
+  }
+
+  const char* data() const { return static_cast<const char*>(addr); }
+  size_t size() const { return len; }
+};
+
+#endif
@@ -1,15 +1,23 @@
+#include <cassert>
 #include <iostream>
 
+#include <common/parallel.h>
+
 #include "cmtgkr_env.h"
 
 #include "magic_var_operation.h"
 #include "pws_circuit_parser.h"
 #include "pws_circuit.h"
+#include "pws_codegen.h"
 
 using namespace std;
 
 typedef map<int, int>::const_iterator ConstGateMapIt;
 
+// don't hand a thread fewer gates than this; below it, waking the
+// thread costs more than it saves.
+#define EVAL_MIN_CHUNK 1024
+
 static const bool DEBUG_MODE = true;
 static void
 error(const string& msg)
@@ -20,12 +28,51 @@ error(const string& msg)
 
 PWSCircuit::
 PWSCircuit(PWSCircuitParser& pp)
-  : parser(pp)
+  : parser(pp), evalThreads(1), pool(NULL), compiled(NULL)
 {
   // Inherit the parser's prime
   setPrime(parser.prime);
 }
 
+PWSCircuit::
+~PWSCircuit()
+{
+  delete pool;
+}
+
+void PWSCircuit::
+setEvalThreads(int nthreads)
+{
+  nthreads = nthreads > 0 ? nthreads : 1;
+  if (nthreads == evalThreads)
+    return;
+  evalThreads = nthreads;
+  delete pool;
+  pool = NULL;
+}
+
+ThreadPool& PWSCircuit::
+threads()
+{
+  if (pool == NULL)
+    pool = new ThreadPool(evalThreads);
+  return *pool;
+}
+
+void PWSCircuit::
+setCompiled(const PWSCompiledEval* ev, const vector<bool>& muxBits)
+{
+  compiled = ev;
+  compiledMuxBits = muxBits;
+}
+
+void PWSCircuit::
+evaluateCompiled(bool magic)
+{
+  assert(compiled != NULL && fieldValues != NULL);
+  compiled->evaluate(fieldValues, compiledMuxBits, magic);
+}
+
 CircuitLayer& PWSCircuit::
 getGatePosLayer(int gatePosLayer)
 {
@@ -48,6 +95,11 @@ evalGates(const vector<int>& start)
     CircuitLayer& layer = getGatePosLayer(lNum);
 
     int gNumStart = start.size() > (size_t) lNum ? start[lNum] : 0;
+    if (fieldValues)
+    {
+      evalLayer(layer, lNum, gNumStart, layer.size());
+      continue;
+    }
     for (int gNum = gNumStart; gNum < layer.size(); gNum++)
     {
       Gate rop = layer.gate(gNum);
@@ -66,6 +118,11 @@ evalGates(const vector<int>& start, const vector<int>& end)
     CircuitLayer& layer = getGatePosLayer(lNum);
 
     int gNumStart = start.size() > lNum ? start[lNum] : 0;
+    if (fieldValues)
+    {
+      evalLayer(layer, lNum, gNumStart, end[lNum]);
+      continue;
+    }
     for (int gNum = gNumStart; gNum < end[lNum]; gNum++)
     {
       Gate rop = layer.gate(gNum);
@@ -74,9 +131,33 @@ evalGates(const vector<int>& start, const vector<int>& end)
   }
 }
 
+// Gates [begin, end) of gate-position layer lNum, in field-only mode.
+// The gates of a layer only read the layer below, so they're split across
+// the circuit's threads; parallelFor() returns once they're all done, so
+// each layer (and each magic op, in evaluate()) sees the layers below it
+// finished.
+//
+// (The mpq/mpz stores aren't shared this way: CircuitData loads and evicts
+// layers as they're touched, so the dual-store path stays serial.)
+void PWSCircuit::
+evalLayer(CircuitLayer& layer, int lNum, int begin, int end)
+{
+  const int lvl = depth() - 1 - lNum;
+  FieldStore* fv = fieldValues;
+  threads().parallelFor(end - begin, [&layer, fv, lvl, begin](int b, int e, int) {
+    fv->evalGates(layer, lvl, begin + b, begin + e);
+  }, EVAL_MIN_CHUNK);
+}
+
 void PWSCircuit::
 evaluate()
 {
+  if (compiled && fieldValues)
+  {
+    evaluateCompiled(true);
+    return;
+  }
+
   // Here, we assume all of the inputs have been filled in, but not the magic
   // variables. We proceed in order.
   vector<pair<vector<int>, MagicVarOperation*> >::const_iterator it = parser.magicOps.begin();
@@ -102,6 +183,20 @@ evaluate()
   evalGates(lastGuard);
 }
 
+// Only the less-than-float operation looks at the rationals: the other
+// magic ops, and DIV_INT gates, are fine with field values.
+bool PWSCircuit::
+needsRationals() const
+{
+  vector<pair<vector<int>, MagicVarOperation*> >::const_iterator it;
+  for (it = parser.magicOps.begin(); it != parser.magicOps.end(); ++it)
+  {
+    if (dynamic_cast<LessThanFloatOperation*>(it->second))
+      return true;
+  }
+  return false;
+}
+
 void PWSCircuit::
 makeGateMapping(vector<Gate*>& gates, CircuitLayer& layer, const vector<int>& mapping)
 {
@@ -162,6 +257,7 @@ constructCircuit()
       numGates++;
       layer[i].makeGate(clayer()[i]);
     }
+    clayer().setCopies(parser.copies);
 
     // only try to copy in the mux gates if they exist!
     if (layerIdx < parser.muxGates.size()) {
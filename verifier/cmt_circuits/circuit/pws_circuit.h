@@ -8,19 +8,47 @@
 #include "cmt_circuit.h"
 #include "cmt_circuit_builder.h"
 
+class PWSCompiledEval;
+class ThreadPool;
+
 class PWSCircuit : public CMTCircuit
 {
   private:
   PWSCircuitParser& parser;
+  int evalThreads;
+  ThreadPool* pool;
+  const PWSCompiledEval* compiled;
+  std::vector<bool> compiledMuxBits;
 
   public:
   PWSCircuit(PWSCircuitParser& pp);
+  virtual ~PWSCircuit();
+
+  // Split each layer's gates across this many threads in evaluate() (in
+  // field-only mode; see Circuit::setFieldEvaluation()).
+  void setEvalThreads(int nthreads);
+  // The circuit's pool of that many threads, started on first use and
+  // kept for the circuit's lifetime; the prover runs its per-layer work
+  // on it too.
+  ThreadPool& threads();
+
+  // Evaluate with code generated for this worksheet (see pws_codegen.h)
+  // instead of interpreting the layers, whenever field-only mode is on.
+  // muxBits are the selector bits V hands out.
+  void setCompiled(const PWSCompiledEval* ev, const std::vector<bool>& muxBits);
+  bool hasCompiled() const { return compiled != NULL; }
+  bool hasMagic() const { return !parser.magicOps.empty(); }
+
+  // Run the compiled code; with magic false, the magic gates are taken as
+  // given (they're inputs, as far as P is concerned).
+  void evaluateCompiled(bool magic);
 
   Gate getGate(const GatePosition& pos);
   CircuitLayer& getGatePosLayer(int gatePosLayer);
   void evalGates(const std::vector<int>& start);
   void evalGates(const std::vector<int>& start, const std::vector<int>& end);
   virtual void evaluate();
+  virtual bool needsRationals() const;
 
   virtual void initializeInputs(const MPQVector& inputs, const MPQVector& magic = MPQVector(0));
   virtual void initializeOutputs(const MPQVector& outputs);
@@ -29,6 +57,7 @@ class PWSCircuit : public CMTCircuit
   virtual void constructCircuit();
 
   private:
+  void evalLayer(CircuitLayer& layer, int lNum, int begin, int end);
   void makeGateMapping(std::vector<Gate*>& gates, CircuitLayer& layer, const std::vector<int>& mapping);
   void makeGateMapping(std::vector<Gate*>& gates, CircuitLayer& layer, const std::map<int, int>& mapping, int offset);
 };
@@ -1,19 +1,21 @@
-#include <fstream>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <limits>
 
 #include <common/math.h>
 
 #include "magic_var_operation.h"
+#include "mapped_file.h"
 #include "pws_circuit_parser.h"
+#include "pws_compiled.h"
 
 using namespace std;
 
 static const bool DEBUG_MODE = true;
 bool a = false;
 
-typedef map<string, int>::iterator ConstMapIt;
-typedef map<int, CVar*>::iterator CVarIt;
+typedef vector<CVar*>::const_iterator CVarIt;
 typedef vector<CConst*>::iterator CConstIt;
 
 #define ASSERT_RETURN(pws, expected, parseContext)    \
@@ -30,12 +32,9 @@ parseError(const string& msg)
 }
 
 static bool
-assert(Tokenizer& pws, string expected, string parseCtx)
+assert(Tokenizer& pws, const char* expected, const char* parseCtx)
 {
-  string token;
-  pws >> token;
-
-  if (token != expected){
+  if (!pws.nextIs(expected)){
     stringstream ss("Missing '");
     ss << expected << "' in " << parseCtx << ".";
     parseError(ss.str());
@@ -62,19 +61,11 @@ clearPairVector(vector< pair<T1, T2*> >& vec)
   vec.clear();
 }
 
-template<class T1, class T2> void
-clearMap(map<T1, T2*>& m)
-{
-  typename map<T1, T2*>::iterator it;
-  for (it = m.begin(); it != m.end(); ++it)
-    delete it->second;
-  m.clear();
-}
-
 PWSCircuitParser::
 PWSCircuitParser(const mpz_t p)
   : varMap(), inOutVarsMap(), outConstantDesc(), constants(),
-    constMap(), token(), circuitDesc(), outputGateBegin(0), muxGates(0), largestMuxBitIndex(0)
+    constMap(), token(), circuitDesc(), outputGateBegin(0), muxGates(0), largestMuxBitIndex(0),
+    copies(1)
 {
   mpz_init(prime);
   mpz_set(prime, p);
@@ -90,6 +81,7 @@ clear()
   clearPairVector(magicOps);
 
   opCount.clear();
+  copies = 1;
 }
 
 const CircuitDescription& PWSCircuitParser::
@@ -103,14 +95,23 @@ parse(const string& pwsFileName)
 {
   clear();
 
-  ifstream pwsFile(pwsFileName.c_str());
-  if (!pwsFile.is_open()){
+  // Already compiled by pwsc: map it in rather than parsing it again.
+  if (PWSCompiledCircuit::isCompiled(pwsFileName))
+  {
+    PWSCompiledCircuit::load(*this, pwsFileName);
+    return;
+  }
+
+  MappedFile pwsFile;
+  if (!pwsFile.open(pwsFileName)){
     parseError("Couldn't open pws file: " + pwsFileName);
     return;
   }
 
+  findLastUses(pwsFile.data(), pwsFile.size());
+
   int i =0;
-  Tokenizer pws(pwsFile);
+  Tokenizer pws(pwsFile.data(), pwsFile.size());
   while (pws.hasNext())
   {
     pws >> token;
@@ -138,6 +139,8 @@ parse(const string& pwsFileName)
         parseMux(pws);
     else if (token[0] == '/' && token[1] == '/')
       pws.ignoreLine();
+
+    evictDeadVariables(pws.offset());
   }
   pwsFile.close();
 
@@ -149,6 +152,166 @@ parse(const string& pwsFileName)
   clearPrivate();
 }
 
+void PWSCircuitParser::
+replicate(int n)
+{
+  if (n <= 1 || circuitDesc.empty())
+    return;
+
+  const int depth = circuitDesc.size();
+  vector<int> stride(depth);
+  for (int l = 0; l < depth; l++)
+    stride[l] = 1 << log2i(max(circuitDesc[l].size(), size_t(1)));
+
+  // The gates. Padding reads the copy's first gate below, so it's an
+  // ordinary gate with nothing depending on it.
+  CircuitDescription desc(depth);
+  for (int l = 0; l < depth; l++)
+  {
+    const LayerDescription& sub = circuitDesc[l];
+    LayerDescription& layer = desc[l];
+    layer.reserve(size_t(n) * stride[l]);
+    for (int k = 0; k < n; k++)
+    {
+      const int base = k * stride[l];
+      const int inBase = l > 0 ? k * stride[l - 1] : 0;
+      for (int g = 0; g < stride[l]; g++)
+      {
+        if ((size_t) g < sub.size())
+        {
+          GateDescription gate = sub[g];
+          gate.pos.name += base;
+          if (l > 0)
+          {
+            gate.in1 += inBase;
+            gate.in2 += inBase;
+          }
+          layer.push_back(gate);
+        }
+        else if (l == 0)
+        {
+          layer.push_back(GateDescription(base + g));
+        }
+        else
+        {
+          layer.push_back(GateDescription(GateDescription::ADD, l, base + g, inBase, inBase));
+        }
+      }
+    }
+  }
+  circuitDesc.swap(desc);
+
+  // Every copy shares the mux selector bits (pwsrepeat's default).
+  for (size_t l = 0; l < muxGates.size(); l++)
+  {
+    map<int, int> mux;
+    for (int k = 0; k < n; k++)
+    {
+      typedef map<int, int>::const_iterator MuxIt;
+      for (MuxIt it = muxGates[l].begin(); it != muxGates[l].end(); ++it)
+        mux.insert(mux.end(), pair<int, int>(k * stride[l] + it->first, it->second));
+    }
+    muxGates[l].swap(mux);
+  }
+
+  const int inStride = stride[0];
+  const int outStride = stride[depth - 1];
+  typedef map<int, int>::const_iterator GateMapIt;
+
+  if (!inGates.empty())
+  {
+    const int numIn = inGates.rbegin()->first + 1;
+    map<int, int> gates;
+    for (int k = 0; k < n; k++)
+    {
+      for (GateMapIt it = inGates.begin(); it != inGates.end(); ++it)
+        gates.insert(gates.end(), pair<int, int>(k * numIn + it->first, k * inStride + it->second));
+    }
+    inGates.swap(gates);
+  }
+
+  if (!outGates.empty())
+  {
+    const int numOut = outGates.rbegin()->first - outputGateBegin + 1;
+    map<int, int> gates;
+    for (int k = 0; k < n; k++)
+    {
+      for (GateMapIt it = outGates.begin(); it != outGates.end(); ++it)
+        gates.insert(gates.end(), pair<int, int>(k * numOut + it->first, k * outStride + it->second));
+    }
+    outGates.swap(gates);
+  }
+
+  vector<int> magic;
+  magic.reserve(magicGates.size() * n);
+  for (int k = 0; k < n; k++)
+  {
+    for (size_t i = 0; i < magicGates.size(); i++)
+      magic.push_back(k * inStride + magicGates[i]);
+  }
+  magicGates.swap(magic);
+
+  // Constants aren't shared between copies: each copy's input slot carries
+  // its own, so that the input layer is a tensor product like the others.
+  vector< pair<string, int> > inConsts;
+  inConsts.reserve(inConstants.size() * n);
+  for (int k = 0; k < n; k++)
+  {
+    for (size_t i = 0; i < inConstants.size(); i++)
+      inConsts.push_back(pair<string, int>(inConstants[i].first, k * inStride + inConstants[i].second));
+  }
+  inConstants.swap(inConsts);
+
+  typedef map<string, vector<int> >::iterator OutConstIt;
+  for (OutConstIt it = outConstants.begin(); it != outConstants.end(); ++it)
+  {
+    vector<int> gates;
+    gates.reserve(it->second.size() * n);
+    for (int k = 0; k < n; k++)
+    {
+      for (size_t i = 0; i < it->second.size(); i++)
+        gates.push_back(k * outStride + it->second[i]);
+    }
+    it->second.swap(gates);
+  }
+
+  // The magic ops go copy by copy. Copy k's guards are offset into its
+  // slots, so they still only grow: by the time copy k+1's first op runs,
+  // all of copy k's magic variables are set, and evaluate() finishes copy k
+  // on its way to the new guard.
+  vector< pair<vector<int>, MagicVarOperation*> > ops;
+  ops.reserve(magicOps.size() * n);
+  for (int k = 0; k < n; k++)
+  {
+    vector<int> offsets(depth);
+    for (int l = 0; l < depth; l++)
+      offsets[l] = k * stride[l];
+
+    for (size_t i = 0; i < magicOps.size(); i++)
+    {
+      vector<int> guard = magicOps[i].first;
+      for (size_t l = 0; l < guard.size(); l++)
+        guard[l] += offsets[l];
+
+      MagicVarOperation* op = magicOps[i].second;
+      if (k > 0)
+        op = op->shifted(offsets);
+      ops.push_back(pair<vector<int>, MagicVarOperation*>(guard, op));
+    }
+  }
+  magicOps.swap(ops);
+
+  opCount.numMults *= n;
+  opCount.numAdds *= n;
+  opCount.numIntDivs *= n;
+  opCount.numIneqs *= n;
+  opCount.numCmps *= n;
+  opCount.numSubs *= n;
+  opCount.numMuxs *= n;
+
+  copies = n;
+}
+
 void PWSCircuitParser::
 makeOutputLayer()
 {
@@ -163,9 +326,11 @@ makeOutputLayer()
   }
 
   int numOutputs = 0;
-  for (CVarIt it = inOutVarsMap.begin(); it != inOutVarsMap.end(); ++it)
+  for (CVarIt it = inOutVarsMap.byName().begin(); it != inOutVarsMap.byName().end(); ++it)
   {
-    const CVar* cVar = it->second;
+    const CVar* cVar = *it;
+    if (cVar == NULL)
+      continue;
     if (cVar->isOutput() && cVar->isBound())
     {
       outputGateBegin = min(outputGateBegin, cVar->name);
@@ -184,9 +349,11 @@ makeOutputLayer()
   }
 
   //cout << "Promoted outputs." << endl;
-  for (CVarIt it = inOutVarsMap.begin(); it != inOutVarsMap.end(); ++it)
+  for (CVarIt it = inOutVarsMap.byName().begin(); it != inOutVarsMap.byName().end(); ++it)
   {
-    CVar* cVar = it->second;
+    CVar* cVar = *it;
+    if (cVar == NULL)
+      continue;
     if (cVar->isOutput() && cVar->isBound())
     {
       promotePrimitive(*cVar, outputLayer);
@@ -198,9 +365,11 @@ void PWSCircuitParser::
 constructInvertedIndexes()
 {
   // IO Vars
-  for (CVarIt it = inOutVarsMap.begin(); it != inOutVarsMap.end(); ++it)
+  for (CVarIt it = inOutVarsMap.byName().begin(); it != inOutVarsMap.byName().end(); ++it)
   {
-    CVar* cVar = it->second;
+    CVar* cVar = *it;
+    if (cVar == NULL)
+      continue;
     if (cVar->isBound())
     {
       if (cVar->isOutput())
@@ -211,9 +380,11 @@ constructInvertedIndexes()
   }
 
   // Magic Vars
-  for (CVarIt it = varMap.begin(); it != varMap.end(); ++it)
+  for (CVarIt it = varMap.byName().begin(); it != varMap.byName().end(); ++it)
   {
-    CVar* cVar = it->second;
+    CVar* cVar = *it;
+    if (cVar == NULL)
+      continue;
     if (cVar->isBound() && cVar->isMagic())
       magicGates.push_back(cVar->gateIndex.front());
   }
@@ -273,7 +444,7 @@ getCircuitVariable(const Primitive& p)
 {
   Maybe<CVar*> out;
   if (p.isVariable())
-    out = getVarMap(p)[p.idx];
+    out = getVarMap(p).get(p.idx);
   return out;
 }
 
@@ -299,7 +470,7 @@ getOpGuard(vector<int>& guard)
   }
 }
 
-map<int, CVar*>& PWSCircuitParser::
+CVarTable& PWSCircuitParser::
 getVarMap(const Primitive& p)
 {
   if (p.isInputOutput())
@@ -311,14 +482,18 @@ getVarMap(const Primitive& p)
 void PWSCircuitParser::
 clearPrivate()
 {
-  clearMap(varMap);
-  clearMap(inOutVarsMap);
+  varMap.clear();
+  inOutVarsMap.clear();
 
   outConstantDesc.clear();
 
   clearVector(constants);
   constMap.clear();
 
+  lastUse.clear();
+  stmtVars.clear();
+  keepVars.clear();
+
   // Unbound all gates now that we've cleared the primitives they were bound to.
   typedef CircuitDescription::iterator LayerIt;
   typedef LayerDescription::iterator GateIt;
@@ -340,6 +515,143 @@ clearIndexes()
   magicGates.clear();
 }
 
+// Worksheet tokens that can name an intermediate variable: parseVar() reads
+// the name with atoi(), so this does too (and so counts a few keywords, like
+// Mlt, as mentions of variable 0, which only keeps it alive longer).
+static bool
+intermediateName(const char* tok, size_t len, int& name)
+{
+  if (len < 2 || (tok[0] != 'V' && tok[0] != 'M'))
+    return false;
+
+  char buf[32];
+  len = min(len - 1, sizeof(buf) - 1);
+  memcpy(buf, tok + 1, len);
+  buf[len] = '\0';
+  name = atoi(buf);
+  return name >= 0;
+}
+
+static bool
+integerToken(const char* tok, size_t len, int& value)
+{
+  if (len == 0 || tok[0] < '0' || tok[0] > '9')
+    return false;
+
+  char buf[32];
+  len = min(len, sizeof(buf) - 1);
+  memcpy(buf, tok, len);
+  buf[len] = '\0';
+  value = atoi(buf);
+  return true;
+}
+
+// A pass over the worksheet ahead of the real parse, recording where each
+// intermediate variable is last mentioned, so that evictDeadVariables() can
+// free it as soon as the parse is past that point.
+//
+// The less-than constraints also create the variables N_0 .. N_0 + N (and
+// D_0 .. D_0 + Nb) without naming them; those count as mentioned there.
+void PWSCircuitParser::
+findLastUses(const char* pws, size_t len)
+{
+  enum { NONE, N_BASE, D_BASE, N_COUNT, D_COUNT } want = NONE;
+  int nBase = -1;
+  int dBase = -1;
+
+  Tokenizer t(pws, len);
+  const char* tok;
+  size_t n;
+  while (t.next(tok, n))
+  {
+    int name, count;
+
+    if (n >= 2 && tok[0] == '/' && tok[1] == '/')
+    {
+      t.ignoreLine();
+      continue;
+    }
+
+    if (want == N_COUNT || want == D_COUNT)
+    {
+      int base = want == N_COUNT ? nBase : dBase;
+      want = NONE;
+      if (integerToken(tok, n, count))
+      {
+        for (int i = 0; i <= count + 1; i++)
+          markUsed(base + i, t.offset());
+        continue;
+      }
+    }
+
+    if (intermediateName(tok, n, name))
+    {
+      if (want == N_BASE)
+        nBase = name;
+      else if (want == D_BASE)
+        dBase = name;
+      markUsed(name, t.offset());
+    }
+    want = NONE;
+
+    if (n == 3 && memcmp(tok, "N_0", 3) == 0)
+      want = N_BASE;
+    else if (n == 3 && memcmp(tok, "D_0", 3) == 0)
+      want = D_BASE;
+    else if (nBase >= 0 && ((n == 1 && tok[0] == 'N') || (n == 2 && memcmp(tok, "Na", 2) == 0)))
+      want = N_COUNT;
+    else if (dBase >= 0 && n == 2 && memcmp(tok, "Nb", 2) == 0)
+      want = D_COUNT;
+  }
+}
+
+void PWSCircuitParser::
+markUsed(int name, size_t offset)
+{
+  if ((size_t) name >= lastUse.size())
+    lastUse.resize(name + 1, 0);
+  lastUse[name] = offset;
+}
+
+void PWSCircuitParser::
+keepVariable(const Primitive& p)
+{
+  if (p.pType != Primitive::INTERMEDIATE)
+    return;
+  if ((size_t) p.idx >= keepVars.size())
+    keepVars.resize(p.idx + 1, false);
+  keepVars[p.idx] = true;
+}
+
+// Free the variables the statement just parsed mentioned for the last
+// time, unbinding their gates (nothing will promote those again). Magic
+// variables and the inputs and outputs are needed after the parse, so
+// they stay.
+void PWSCircuitParser::
+evictDeadVariables(size_t offset)
+{
+  for (size_t i = 0; i < stmtVars.size(); i++)
+  {
+    int name = stmtVars[i];
+    CVar* cVar = varMap.get(name);
+    if (cVar == NULL || cVar->isMagic() ||
+        ((size_t) name < keepVars.size() && keepVars[name]) ||
+        ((size_t) name < lastUse.size() && lastUse[name] > offset))
+      continue;
+
+    for (size_t k = 0; k < cVar->gateIndex.size(); k++)
+    {
+      GateDescription& g = getGate(GatePosition(cVar->minLayer + k, cVar->gateIndex[k]));
+      if (g.isBound() &&
+          g.boundPrimitive.value().pType == Primitive::INTERMEDIATE &&
+          g.boundPrimitive.value().idx == name)
+        g.unbind();
+    }
+    varMap.remove(name);
+  }
+  stmtVars.clear();
+}
+
 GatePosition PWSCircuitParser::
 addGate(GateDescription::OpType op, int in1, int in2, int outLayerNum)
 {
@@ -364,15 +676,13 @@ addVariable(CVar::VarType type, int name)
 {
   CVar testVar(type, name);
 
-  map<int, CVar*>& vMap = getVarMap(testVar.toPrimitive());
+  CVarTable& vMap = getVarMap(testVar.toPrimitive());
 
-  map<int, CVar*>::iterator it = vMap.find(name);
-  if (it == vMap.end())
-  {
-    vMap[name] = new CVar(testVar);;
-  }
+  CVar* var = vMap.get(name);
+  if (var == NULL)
+    var = vMap.add(new CVar(testVar));
 
-  return *vMap[name];
+  return *var;
 }
 
 CConst& PWSCircuitParser::
@@ -394,22 +704,21 @@ addConstant(mpz_t constant)
 CConst& PWSCircuitParser::
 addConstant(int constant)
 {
-  stringstream ss;
-  ss << constant;
+  // called for every promoted gate, so skip the stringstream.
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", constant);
 
-  return addConstant(ss.str());
+  return addConstant(string(buf));
 }
 
 CConst& PWSCircuitParser::
 addConstant(const string& constant)
 {
-  ConstMapIt it = constMap.find(constant);
-  if (it == constMap.end())
-  {
+  pair<unordered_map<string, int>::iterator, bool> ins =
+    constMap.insert(pair<string, int>(constant, constants.size()));
+  if (ins.second)
     constants.push_back(new CConst(constant, constants.size()));
-    constMap[constant] = constants.size() - 1;
-  }
-  return *constants[constMap[constant]];
+  return *constants[ins.first->second];
 }
 
 void PWSCircuitParser::
@@ -457,6 +766,13 @@ promoteGate(const GatePosition g, int layer)
 void PWSCircuitParser::
 bindVariable(const Primitive& var, const GatePosition gate)
 {
+  // The gate already stands for another primitive, whose later uses will
+  // promote it through var (see promoteGate()), so var has to stay around.
+  const Maybe<Primitive>& prev = getGate(gate).boundPrimitive;
+  if (prev.isValid() &&
+      (prev.value().pType != var.pType || prev.value().idx != var.idx))
+    keepVariable(var);
+
   CPrimitive& v = getCircuitPrimitive(var);
 
   if (v.isBound())
@@ -481,6 +797,10 @@ bindOutputConstant(const GatePosition outGate, int val)
 
   ConstOutputDescription desc(outGate, ss.str());
   outConstantDesc.push_back(desc);
+
+  // makeOutputLayer() promotes the gate through what it's bound to.
+  if (getGate(outGate).isBound())
+    keepVariable(getGate(outGate).boundPrimitive.value());
 }
 
 void PWSCircuitParser::
@@ -491,6 +811,9 @@ bindOutputConstant(const Primitive val, const GatePosition outGate)
   {
     ConstOutputDescription desc(outGate, cConst.value()->value);
     outConstantDesc.push_back(desc);
+
+    if (getGate(outGate).isBound())
+      keepVariable(getGate(outGate).boundPrimitive.value());
   }
 }
 
@@ -699,6 +1022,8 @@ parseVar(const string& token)
       {
         CVar& var = addVariable(varType.value(), name);
         p = var.toPrimitive();
+        if (!var.isIO())
+          stmtVars.push_back(name);
       }
     }
   }
@@ -733,7 +1058,7 @@ parseConst(const string& token)
 }
 
 Maybe<GatePosition> PWSCircuitParser::
-parsePoly(Tokenizer& pws, const string end)
+parsePoly(Tokenizer& pws, const char* end)
 {
   bool abort = false;
   bool isMinus = false;
@@ -1379,9 +1704,11 @@ printCircuitDescription()
   }
 
   cout << endl << "=== IO ===" << endl;
-  for (CVarIt it = inOutVarsMap.begin(); it != inOutVarsMap.end(); ++it)
+  for (CVarIt it = inOutVarsMap.byName().begin(); it != inOutVarsMap.byName().end(); ++it)
   {
-    CVar* cVar = it->second;
+    CVar* cVar = *it;
+    if (cVar == NULL)
+      continue;
     if (!cVar->isBound())
       continue;
 
@@ -1400,9 +1727,11 @@ printCircuitDescription()
   }
 
   cout << endl << "=== VARIABLES ===" << endl;
-  for (CVarIt it = varMap.begin(); it != varMap.end(); ++it)
+  for (CVarIt it = varMap.byName().begin(); it != varMap.byName().end(); ++it)
   {
-    CVar* cVar = it->second;
+    CVar* cVar = *it;
+    if (cVar == NULL)
+      continue;
     printf("%02d || %s%d\n", cVar->gateIndex.front(),
                              cVar->varTypeStr().c_str(),
                              cVar->name);
@@ -1466,8 +1795,8 @@ void PWSCircuitParser::
 printMemoryStats() const
 {
   size_t nLayers = circuitDesc.size();
-  printMemoryStat("varMapsize:       ", varMap, nLayers);
-  printMemoryStat("inoutvarsmapsize: ", inOutVarsMap, nLayers);
+  printMemoryStat("varMapsize:       ", varMap.byName(), nLayers);
+  printMemoryStat("inoutvarsmapsize: ", inOutVarsMap.byName(), nLayers);
   printMemoryStat("constsize:        ", constants, nLayers);
   printMemoryStat("constmapsize:     ", constMap, nLayers);
   printMemoryStat("outconstdescsize: ", outConstantDesc, nLayers);
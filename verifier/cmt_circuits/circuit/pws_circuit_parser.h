@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <gmp.h>
 
@@ -15,10 +16,59 @@
 // Required predeclaration.
 class MagicVarOperation;
 
+// Variables by name. Worksheet variables are numbered densely from 0, so
+// the name indexes a vector directly; walking byName() visits them in name
+// order, skipping the NULLs of unused names.
+class CVarTable
+{
+  std::vector<CVar*> vars;
+  size_t count;
+
+  public:
+  CVarTable()
+    : count(0)
+  { }
+
+  CVar* get(int name) const
+  {
+    return (size_t) name < vars.size() ? vars[name] : NULL;
+  }
+
+  CVar* add(CVar* var)
+  {
+    if ((size_t) var->name >= vars.size())
+      vars.resize(var->name + 1, NULL);
+    if (vars[var->name] == NULL)
+      count++;
+    vars[var->name] = var;
+    return var;
+  }
+
+  void remove(int name)
+  {
+    if (get(name) == NULL)
+      return;
+    delete vars[name];
+    vars[name] = NULL;
+    count--;
+  }
+
+  const std::vector<CVar*>& byName() const { return vars; }
+  size_t size() const { return count; }
+
+  void clear()
+  {
+    for (size_t i = 0; i < vars.size(); i++)
+      delete vars[i];
+    vars.clear();
+    count = 0;
+  }
+};
+
 class PWSCircuitParser
 {
-  std::map<int, CVar*> varMap;
-  std::map<int, CVar*> inOutVarsMap;
+  CVarTable varMap;
+  CVarTable inOutVarsMap;
 
 
 
@@ -27,10 +77,17 @@ class PWSCircuitParser
 
   //TODO: Unpublic this.
   std::vector<CConst*> constants;
-  std::map<std::string, int> constMap;
+  std::unordered_map<std::string, int> constMap;
 
   std::string token;
 
+  // Liveness of the intermediate variables (see findLastUses()): the offset
+  // in the worksheet just past each name's last mention, the names the
+  // current statement mentioned, and the names that must outlive that.
+  std::vector<size_t> lastUse;
+  std::vector<int> stmtVars;
+  std::vector<bool> keepVars;
+
   public:
   CircuitDescription circuitDesc;
 
@@ -58,6 +115,10 @@ class PWSCircuitParser
   PWSOpCount opCount;
   mpz_t prime;
 
+  // Data-parallel copies of the worksheet laid out by replicate(); 1 for a
+  // plain parse.
+  int copies;
+
   public:
   PWSCircuitParser(const mpz_t prime);
 
@@ -67,6 +128,14 @@ class PWSCircuitParser
 
   void parse(const std::string& pwsFileName);
 
+  // Turn the parsed circuit into n independent copies of itself, as
+  // pwsrepeat does textually. Copy k of layer l takes the slot
+  // [k * 2^s, (k+1) * 2^s), where 2^s is the parsed layer's size rounded up
+  // (the rest of the slot is padding), so every layer's wiring is the
+  // parsed layer's tensored with the identity on the copy index. Copy k's
+  // inputs, outputs and magic variables are numbered after copy k-1's.
+  void replicate(int n);
+
   void printCircuitDescription();
   void printCircuitStats();
   void printMemoryStats() const;
@@ -83,11 +152,16 @@ class PWSCircuitParser
   Maybe<CConst*> getCircuitConstant(const Primitive& p);
 
   void getOpGuard(std::vector<int>& guard);
-  std::map<int, CVar*>& getVarMap(const Primitive& p);
+  CVarTable& getVarMap(const Primitive& p);
 
   void clearPrivate();
   void clearIndexes();
 
+  void findLastUses(const char* pws, size_t len);
+  void markUsed(int name, size_t offset);
+  void keepVariable(const Primitive& p);
+  void evictDeadVariables(size_t offset);
+
   GatePosition addGate(GateDescription::OpType op, int in1, int in2, int outLayerNum);
   void addToCircuit(CPrimitive& p);
 
@@ -123,7 +197,7 @@ class PWSCircuitParser
   Maybe<Primitive> parseVar(const std::string& token);
   Maybe<Primitive> parseConst(const std::string& token);
 
-  Maybe<GatePosition> parsePoly(Tokenizer& pws, const std::string end = ")");
+  Maybe<GatePosition> parsePoly(Tokenizer& pws, const char* end = ")");
   Maybe<GatePosition> parsePolyTerm(Tokenizer& pws, bool& isMinus);
 
   void parsePolyConstraint(Tokenizer& pws);
@@ -0,0 +1,590 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <dlfcn.h>
+
+#include "circuit.h"
+#include "field_store.h"
+#include "magic_var_operation.h"
+#include "pws_circuit_parser.h"
+#include "pws_codegen.h"
+
+using namespace std;
+
+// A run of at least this many gates whose inputs step through the layer
+// below by constant strides becomes a loop rather than one statement per
+// gate.
+#define PWS_EVAL_MIN_RUN 8
+
+static void
+codegenError(const string& fileName, const string& msg)
+{
+  cerr << "ERROR: " << fileName << ": " << msg << endl;
+  exit(1);
+}
+
+// is prime = 2^bits - delta?
+static bool
+isPrime(const mpz_t prime, unsigned long bits, unsigned long delta)
+{
+  mpz_t p;
+  mpz_init_set_ui(p, 1);
+  mpz_mul_2exp(p, p, bits);
+  mpz_sub_ui(p, p, delta);
+  bool eq = mpz_cmp(p, prime) == 0;
+  mpz_clear(p);
+  return eq;
+}
+
+static string
+primeString(const mpz_t prime)
+{
+  char* primeStr = mpz_get_str(NULL, 10, prime);
+  string s(primeStr);
+  void (*freefunc) (void *, size_t);
+  mp_get_memory_functions(NULL, NULL, &freefunc);
+  freefunc(primeStr, strlen(primeStr) + 1);
+  return s;
+}
+
+// What the gate computes, as FieldStore sees it: DIV_INT is a product in
+// the field, and anything else that isn't a real op is wired as an ADD
+// (see GateDescription::makeGate()).
+static GateDescription::OpType
+fieldOp(GateDescription::OpType op)
+{
+  switch (op)
+  {
+    case GateDescription::MUL:
+    case GateDescription::DIV_INT:
+      return GateDescription::MUL;
+    case GateDescription::SUB:
+    case GateDescription::MUX:
+      return op;
+    default:
+      return GateDescription::ADD;
+  }
+}
+
+static const char*
+opName(GateDescription::OpType op)
+{
+  switch (op)
+  {
+    case GateDescription::MUL:
+      return "mul";
+    case GateDescription::SUB:
+      return "sub";
+    default:
+      return "add";
+  }
+}
+
+static const char*
+opString(GateDescription::OpType op)
+{
+  switch (op)
+  {
+    case GateDescription::MUL:
+      return " * ";
+    case GateDescription::SUB:
+      return " - ";
+    default:
+      return " + ";
+  }
+}
+
+// The runtime written into every generated file: the magic ops, with the
+// same arithmetic as NotEqualOperation and LessThanIntOperation on the
+// native field type, and the loops over runs of gates.
+static const char* const MAGIC_RUNTIME =
+"namespace {\n"
+"\n"
+"struct Prime\n"
+"{\n"
+"  mpz_t p, half;\n"
+"  Prime() { mpz_init_set_str(p, pws_eval_prime, 10); mpz_init(half); mpz_tdiv_q_2exp(half, p, 1); }\n"
+"  ~Prime() { mpz_clear(p); mpz_clear(half); }\n"
+"};\n"
+"\n"
+"inline const Prime& prime()\n"
+"{\n"
+"  static Prime pr;\n"
+"  return pr;\n"
+"}\n"
+"\n"
+"// m = 1 / (x1 - x2), or 0 if they're equal.\n"
+"inline void notEqual(F& m, const F& x1, const F& x2)\n"
+"{\n"
+"  if (x1 == x2)\n"
+"  {\n"
+"    m = F();\n"
+"    return;\n"
+"  }\n"
+"  mpz_t t;\n"
+"  mpz_init(t);\n"
+"  (x1 - x2).get(t);\n"
+"  mpz_invert(t, t, prime().p);\n"
+"  m.set(t);\n"
+"  mpz_clear(t);\n"
+"}\n"
+"\n"
+"// ms = which of x1 < x2, x1 = x2, x1 > x2 holds, as signed integers;\n"
+"// ns = the bits of 2^nn - |x1 - x2|, each scaled by its place value.\n"
+"inline void lessThanInt(F* const* ms, F* const* ns, int nn, const F& x1, const F& x2)\n"
+"{\n"
+"  const Prime& pr = prime();\n"
+"  mpz_t a, b, t;\n"
+"  mpz_init(a);\n"
+"  mpz_init(b);\n"
+"  mpz_init(t);\n"
+"  x1.get(a);\n"
+"  x2.get(b);\n"
+"  if (mpz_cmp(pr.half, a) < 0)\n"
+"    mpz_sub(a, a, pr.p);\n"
+"  if (mpz_cmp(pr.half, b) < 0)\n"
+"    mpz_sub(b, b, pr.p);\n"
+"\n"
+"  int sgn = mpz_cmp(a, b);\n"
+"  *ms[0] = F((uint64_t) (sgn < 0));\n"
+"  *ms[1] = F((uint64_t) (sgn == 0));\n"
+"  *ms[2] = F((uint64_t) (sgn > 0));\n"
+"\n"
+"  if (sgn < 0)\n"
+"    mpz_sub(a, a, b);\n"
+"  else\n"
+"    mpz_sub(a, b, a);\n"
+"  mpz_setbit(t, nn);\n"
+"  mpz_add(a, a, t);\n"
+"  for (int i = 0; i < nn; i++)\n"
+"  {\n"
+"    if (mpz_tstbit(a, i))\n"
+"    {\n"
+"      mpz_set_ui(t, 0);\n"
+"      mpz_setbit(t, i);\n"
+"      ns[i]->set(t);\n"
+"    }\n"
+"    else\n"
+"    {\n"
+"      *ns[i] = F();\n"
+"    }\n"
+"  }\n"
+"\n"
+"  mpz_clear(a);\n"
+"  mpz_clear(b);\n"
+"  mpz_clear(t);\n"
+"}\n"
+"\n"
+"// out[i] = a[i * da] op b[i * db], and out[i] = in[w[2i]] op in[w[2i + 1]],\n"
+"// for i < n. Kept out of line: the runs are many, and each call site\n"
+"// would otherwise get its own copy of the field arithmetic to compile.\n"
+"#define PWS_EVAL_RUNS(name, op) \\\n"
+"  inline __attribute__((noinline)) void \\\n"
+"  name##Run(F* out, const F* a, int da, const F* b, int db, int n) \\\n"
+"  { \\\n"
+"    for (int i = 0; i < n; i++) \\\n"
+"      out[i] = a[i * da] op b[i * db]; \\\n"
+"  } \\\n"
+"  inline __attribute__((noinline)) void \\\n"
+"  name##Table(F* out, const F* in, const int32_t* w, int n) \\\n"
+"  { \\\n"
+"    for (int i = 0; i < n; i++) \\\n"
+"      out[i] = in[w[2 * i]] op in[w[2 * i + 1]]; \\\n"
+"  }\n"
+"\n"
+"PWS_EVAL_RUNS(add, +)\n"
+"PWS_EVAL_RUNS(sub, -)\n"
+"PWS_EVAL_RUNS(mul, *)\n"
+"\n"
+"}\n"
+"\n";
+
+// Writes the evaluation code a statement at a time, opening a new part
+// function every PWS_EVAL_FN_STMTS statements.
+class PWSCodegenWriter
+{
+  const PWSCircuitParser& parser;
+  const string& fileName;
+  ostream& out;
+
+  int parts;
+  int stmts;
+
+  public:
+  PWSCodegenWriter(const PWSCircuitParser& p, const string& name, ostream& o)
+    : parser(p), fileName(name), out(o), parts(0), stmts(0)
+  { }
+
+  int numParts() const { return parts; }
+
+  void finish()
+  {
+    if (stmts > 0)
+      out << "}\n\n";
+    stmts = 0;
+  }
+
+  // Gates [begin, end) of gate-position layer l.
+  void gates(int l, int begin, int end)
+  {
+    const LayerDescription& layer = parser.circuitDesc[l];
+    const map<int, int>* mux = (size_t) l < parser.muxGates.size() ? &parser.muxGates[l] : NULL;
+
+    int g = begin;
+    while (g < end)
+    {
+      const GateDescription& gate = layer[g];
+      GateDescription::OpType op = fieldOp(gate.op);
+      if (op == GateDescription::MUX)
+      {
+        map<int, int>::const_iterator it;
+        if (mux == NULL || (it = mux->find(g)) == mux->end())
+          codegenError(fileName, "mux gate without a selector bit");
+
+        stmt() << "L[" << l << "][" << g << "] = mux[" << it->second << "] ? "
+               << "L[" << l - 1 << "][" << gate.in2 << "] : "
+               << "L[" << l - 1 << "][" << gate.in1 << "];\n";
+        g++;
+        continue;
+      }
+
+      // The gates from g on with g's op: stretches of them whose inputs
+      // step by constant strides become loops, and what's between those,
+      // loops over a wiring table.
+      int m = opRun(layer, g, end);
+      int pending = g;
+      int j = g;
+      while (j < g + m)
+      {
+        int n = strideRun(layer, j, g + m);
+        if (n < PWS_EVAL_MIN_RUN)
+        {
+          j++;
+          continue;
+        }
+        irregular(l, pending, j, op);
+        strided(l, j, n, op);
+        j += n;
+        pending = j;
+      }
+      irregular(l, pending, g + m, op);
+      g += m;
+    }
+  }
+
+  void magicOp(const MagicVarOperation* magicOp)
+  {
+    if (dynamic_cast<const LessThanFloatOperation*>(magicOp))
+      codegenError(fileName, "less-than on floats needs rationals, which compiled code doesn't have");
+
+    if (const NotEqualOperation* ne = dynamic_cast<const NotEqualOperation*>(magicOp))
+    {
+      stmt() << "if (magic) notEqual(" << pos(ne->M) << ", "
+             << pos(ne->X1) << ", " << pos(ne->X2) << ");\n";
+      return;
+    }
+
+    const LessThanIntOperation* lt = dynamic_cast<const LessThanIntOperation*>(magicOp);
+    if (lt == NULL)
+      codegenError(fileName, "unknown magic op");
+
+    ostream& s = stmt();
+    s << "if (magic)\n"
+      << "  {\n"
+      << "    F* const ms[] = { " << ptrs(lt->Ms) << " };\n";
+    if (lt->Ns.empty())
+      s << "    F* const* ns = NULL;\n";
+    else
+      s << "    F* const ns[] = { " << ptrs(lt->Ns) << " };\n";
+    s << "    lessThanInt(ms, ns, " << lt->Ns.size() << ", "
+      << pos(lt->X1) << ", " << pos(lt->X2) << ");\n"
+      << "  }\n";
+  }
+
+  private:
+  // Starts a statement, in a new part function if this one's full.
+  ostream& stmt()
+  {
+    if (stmts == PWS_EVAL_FN_STMTS)
+      finish();
+    if (stmts == 0)
+    {
+      out << "static void part" << parts++ << "(F* const* L, const unsigned char* mux, int magic)\n"
+          << "{\n"
+          << "  (void) mux;\n"
+          << "  (void) magic;\n";
+    }
+    stmts++;
+    out << "  ";
+    return out;
+  }
+
+  // Gates [g, g + n) of layer l, whose inputs step by constant strides.
+  void strided(int l, int g, int n, GateDescription::OpType op)
+  {
+    const LayerDescription& layer = parser.circuitDesc[l];
+    int d1 = layer[g + 1].in1 - layer[g].in1;
+    int d2 = layer[g + 1].in2 - layer[g].in2;
+    stmt() << opName(op) << "Run(&L[" << l << "][" << g << "], "
+           << "&L[" << l - 1 << "][" << layer[g].in1 << "], " << d1 << ", "
+           << "&L[" << l - 1 << "][" << layer[g].in2 << "], " << d2 << ", " << n << ");\n";
+  }
+
+  // Gates [begin, end) of layer l, all with op but wired any which way:
+  // one statement each if there are only a few, otherwise a loop over a
+  // table of their inputs, which is much less code to compile.
+  void irregular(int l, int begin, int end, GateDescription::OpType op)
+  {
+    const LayerDescription& layer = parser.circuitDesc[l];
+    if (end - begin < PWS_EVAL_MIN_RUN)
+    {
+      for (int g = begin; g < end; g++)
+      {
+        stmt() << "L[" << l << "][" << g << "] = "
+               << "L[" << l - 1 << "][" << layer[g].in1 << "]" << opString(op)
+               << "L[" << l - 1 << "][" << layer[g].in2 << "];\n";
+      }
+      return;
+    }
+
+    ostream& s = stmt();
+    s << "{\n"
+      << "    static const int32_t w[] = {";
+    for (int g = begin; g < end; g++)
+    {
+      if ((g - begin) % 8 == 0)
+        s << "\n     ";
+      s << " " << layer[g].in1 << ", " << layer[g].in2 << ",";
+    }
+    s << "\n    };\n"
+      << "    " << opName(op) << "Table(&L[" << l << "][" << begin << "], L[" << l - 1 << "], w, "
+      << end - begin << ");\n"
+      << "  }\n";
+  }
+
+  // How many gates from g on (but before end) share g's op.
+  static int opRun(const LayerDescription& layer, int g, int end)
+  {
+    int n = 1;
+    while (g + n < end && fieldOp(layer[g + n].op) == fieldOp(layer[g].op))
+      n++;
+    return n;
+  }
+
+  // How many gates from g on (but before end) share g's op and step both
+  // inputs by the same strides.
+  static int strideRun(const LayerDescription& layer, int g, int end)
+  {
+    if (g + 1 >= end || fieldOp(layer[g + 1].op) != fieldOp(layer[g].op))
+      return 1;
+
+    int d1 = layer[g + 1].in1 - layer[g].in1;
+    int d2 = layer[g + 1].in2 - layer[g].in2;
+    int n = 2;
+    while (g + n < end &&
+           fieldOp(layer[g + n].op) == fieldOp(layer[g].op) &&
+           layer[g + n].in1 - layer[g + n - 1].in1 == d1 &&
+           layer[g + n].in2 - layer[g + n - 1].in2 == d2)
+      n++;
+    return n;
+  }
+
+  static string pos(const GatePosition& p)
+  {
+    ostringstream s;
+    s << "L[" << p.layer << "][" << p.name << "]";
+    return s.str();
+  }
+
+  static string ptrs(const vector<GatePosition>& ps)
+  {
+    ostringstream s;
+    for (size_t i = 0; i < ps.size(); i++)
+      s << (i ? ", " : "") << "&" << pos(ps[i]);
+    return s.str();
+  }
+};
+
+void PWSCodegen::
+write(const PWSCircuitParser& parser, const Circuit& c, const string& fileName)
+{
+  const char* header;
+  const char* type;
+  if (isPrime(parser.prime, 61, 1))
+  {
+    header = "common/fp61.h";
+    type = "Fp61";
+  }
+  else if (isPrime(parser.prime, 255, 19))
+  {
+    header = "common/fp25519.h";
+    type = "Fp25519";
+  }
+  else
+  {
+    codegenError(fileName, "no native field type for this prime");
+    return;
+  }
+
+  ofstream out(fileName.c_str());
+  if (!out)
+  {
+    perror("Couldn't open generated code for writing");
+    exit(1);
+  }
+
+  const CircuitDescription& desc = parser.circuitDesc;
+  const int depth = desc.size();
+
+  out << "// Evaluation code for one worksheet, generated by pws2cpp; don't edit.\n"
+      << "// See verifier/cmt_circuits/circuit/pws_codegen.h.\n"
+      << "\n"
+      << "#include <stdint.h>\n"
+      << "#include <gmp.h>\n"
+      << "\n"
+      << "#include <" << header << ">\n"
+      << "\n"
+      << "typedef " << type << " F;\n"
+      << "\n"
+      << "extern \"C\" const int pws_eval_abi = " << PWS_EVAL_ABI << ";\n"
+      << "extern \"C\" const char pws_eval_prime[] = \"" << primeString(parser.prime) << "\";\n"
+      << "extern \"C\" const unsigned char pws_eval_digest[] = {";
+  uint8_t digest[CIRCUIT_DIGEST_BYTES];
+  c.wiringDigest(digest);
+  for (int i = 0; i < CIRCUIT_DIGEST_BYTES; i++)
+    out << (i ? ", " : " ") << (int) digest[i];
+  out << " };\n"
+      << "extern \"C\" const int pws_eval_depth = " << depth << ";\n"
+      << "extern \"C\" const int pws_eval_mux_bits = " << parser.largestMuxBitIndex + 1 << ";\n"
+      << "extern \"C\" const int pws_eval_sizes[] = {";
+  for (int l = 0; l < depth; l++)
+    out << (l ? ", " : " ") << desc[l].size();
+  out << " };\n\n"
+      << MAGIC_RUNTIME;
+
+  // The copies laid out by PWSCircuitParser::replicate() are wired alike,
+  // relative to the start of their slots, so the code is written for the
+  // first copy and run once per copy. Its magic ops are the first ones.
+  const int copies = parser.copies;
+  const size_t copyOps = parser.magicOps.size() / copies;
+  vector<int> slot(depth);
+  for (int l = 0; l < depth; l++)
+    slot[l] = desc[l].size() / copies;
+
+  // Same order as PWSCircuit::evaluate(): the gates below each magic op's
+  // guard, then the op.
+  PWSCodegenWriter w(parser, fileName, out);
+  vector<int> lastGuard;
+  for (size_t i = 0; i < copyOps; i++)
+  {
+    const vector<int>& guard = parser.magicOps[i].first;
+    for (size_t l = 1; l < guard.size(); l++)
+      w.gates(l, lastGuard.size() > l ? lastGuard[l] : 0, guard[l]);
+    w.magicOp(parser.magicOps[i].second);
+    lastGuard = guard;
+  }
+  for (int l = 1; l < depth; l++)
+    w.gates(l, lastGuard.size() > (size_t) l ? lastGuard[l] : 0, slot[l]);
+  w.finish();
+
+  out << "extern \"C\" void pws_eval(void* const* layers, const unsigned char* mux, int magic)\n"
+      << "{\n"
+      << "  for (int k = 0; k < " << copies << "; k++)\n"
+      << "  {\n"
+      << "    F* const L[] = {";
+  for (int l = 0; l < depth; l++)
+    out << (l ? ", " : " ") << "(F*) layers[" << l << "] + k * " << slot[l];
+  out << " };\n";
+  for (int i = 0; i < w.numParts(); i++)
+    out << "    part" << i << "(L, mux, magic);\n";
+  out << "  }\n"
+      << "}\n";
+
+  if (!out)
+    codegenError(fileName, "couldn't write generated code");
+}
+
+PWSCompiledEval::
+PWSCompiledEval()
+  : handle(NULL), fn(NULL), depth(0), numMuxBits(0)
+{ }
+
+PWSCompiledEval::
+~PWSCompiledEval()
+{
+  if (handle != NULL)
+    dlclose(handle);
+}
+
+static const void*
+symbol(void* handle, const string& soName, const char* name)
+{
+  const void* sym = dlsym(handle, name);
+  if (sym == NULL)
+    codegenError(soName, string("no ") + name + "; not generated by pws2cpp?");
+  return sym;
+}
+
+void PWSCompiledEval::
+load(const string& soName, const PWSCircuitParser& parser, const Circuit& c)
+{
+  // dlopen() only searches the library path for a bare name.
+  string path = soName.find('/') == string::npos ? "./" + soName : soName;
+  handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL)
+    codegenError(soName, dlerror());
+
+  const int abi = *static_cast<const int*>(symbol(handle, soName, "pws_eval_abi"));
+  if (abi != PWS_EVAL_ABI)
+    codegenError(soName, "generated by another version of pws2cpp; regenerate it");
+
+  const char* prime = static_cast<const char*>(symbol(handle, soName, "pws_eval_prime"));
+  if (primeString(parser.prime) != prime)
+    codegenError(soName, "generated for another prime");
+
+  const CircuitDescription& desc = parser.circuitDesc;
+  depth = *static_cast<const int*>(symbol(handle, soName, "pws_eval_depth"));
+  const int* sizes = static_cast<const int*>(symbol(handle, soName, "pws_eval_sizes"));
+  bool sameShape = depth == (int) desc.size();
+  for (int l = 0; sameShape && l < depth; l++)
+    sameShape = sizes[l] == (int) desc[l].size();
+  if (!sameShape)
+    codegenError(soName, "generated from another worksheet (or number of copies)");
+
+  numMuxBits = *static_cast<const int*>(symbol(handle, soName, "pws_eval_mux_bits"));
+  if (numMuxBits != parser.largestMuxBitIndex + 1)
+    codegenError(soName, "generated from another worksheet (mux bits differ)");
+
+  // same shape isn't same circuit.
+  uint8_t digest[CIRCUIT_DIGEST_BYTES];
+  c.wiringDigest(digest);
+  if (memcmp(symbol(handle, soName, "pws_eval_digest"), digest, CIRCUIT_DIGEST_BYTES))
+    codegenError(soName, "generated from another worksheet (wiring differs)");
+
+  // POSIX guarantees that a function pointer survives a trip through
+  // void*, but C++ won't cast one directly.
+  const void* f = symbol(handle, soName, "pws_eval");
+  memcpy(&fn, &f, sizeof(fn));
+}
+
+void PWSCompiledEval::
+evaluate(FieldStore* values, const vector<bool>& muxBits, bool magic) const
+{
+  // the store is indexed by circuit level, the generated code by gate
+  // position: the input layer comes first.
+  vector<void*> layers(depth);
+  for (int l = 0; l < depth; l++)
+    layers[l] = values->data(depth - 1 - l);
+
+  if ((int) muxBits.size() < numMuxBits)
+  {
+    cerr << "ERROR: compiled circuit needs " << numMuxBits << " mux bits" << endl;
+    exit(1);
+  }
+  vector<unsigned char> mux(muxBits.begin(), muxBits.end());
+
+  fn(&layers[0], mux.empty() ? NULL : &mux[0], magic);
+}
@@ -0,0 +1,72 @@
+#ifndef CODE_PEPPER_CMTGKR_CIRCUIT_PWS_CODEGEN_H_
+#define CODE_PEPPER_CMTGKR_CIRCUIT_PWS_CODEGEN_H_
+
+#include <string>
+#include <vector>
+
+class Circuit;
+class FieldStore;
+class PWSCircuitParser;
+
+// Ahead-of-time evaluation code for a fixed worksheet. PWSCodegen writes
+// out a C++ translation unit that evaluates the parsed circuit with the
+// native field type for its prime: every layer is a plain array, a run of
+// gates whose inputs step by constant strides is one loop, other runs of
+// gates with the same op a loop over a table of their inputs (short ones
+// a statement per gate), and the magic ops are inlined at the point
+// PWSCircuit::evaluate() would run them. Data-parallel copies (see
+// PWSCircuitParser::replicate()) share one copy's code. Built as a shared object (see pws2sv/pws2cpp.cpp), it's loaded
+// back with PWSCompiledEval and evaluates straight out of a FieldStore.
+//
+// The shared object exports plain C symbols: PWS_EVAL_ABI, the prime as a
+// decimal string, the circuit's wiring digest (see Circuit::wiringDigest()),
+// the depth, the layer sizes (input layer first), the number of mux
+// selector bits, and
+//
+//   void pws_eval(void* const* layers, const unsigned char* mux, int magic);
+//
+// which takes one array per layer (again input layer first), and computes
+// the magic gates along the way iff magic is nonzero.
+#define PWS_EVAL_ABI 2
+
+// Straight-line code is cut into functions of at most this many
+// statements, so that the compiler's per-function passes stay cheap.
+#define PWS_EVAL_FN_STMTS 2000
+
+class PWSCodegen
+{
+  public:
+  // c is the circuit as constructed from parser. Exits if it can't be
+  // compiled: no native field for its prime, or a magic op that needs
+  // rationals (less-than on floats).
+  static void write(const PWSCircuitParser& parser, const Circuit& c, const std::string& fileName);
+};
+
+class PWSCompiledEval
+{
+  typedef void (*EvalFn)(void* const*, const unsigned char*, int);
+
+  void* handle;
+  EvalFn fn;
+  int depth;
+  int numMuxBits;
+
+  PWSCompiledEval(const PWSCompiledEval&);
+  PWSCompiledEval& operator=(const PWSCompiledEval&);
+
+  public:
+  PWSCompiledEval();
+  ~PWSCompiledEval();
+
+  // c is the circuit as constructed from parser. Exits if soName can't be
+  // loaded, or wasn't generated from that circuit (replicated the same
+  // way, under the same prime, wired the same).
+  void load(const std::string& soName, const PWSCircuitParser& parser, const Circuit& c);
+  bool loaded() const { return fn != NULL; }
+
+  // Evaluate the circuit whose input layer has been filled in in values,
+  // the circuit's FieldStore (see Circuit::setFieldEvaluation()).
+  void evaluate(FieldStore* values, const std::vector<bool>& muxBits, bool magic) const;
+};
+
+#endif
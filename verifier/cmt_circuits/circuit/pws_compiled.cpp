@@ -0,0 +1,441 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <stdint.h>
+
+#include "magic_var_operation.h"
+#include "mapped_file.h"
+#include "pws_circuit_parser.h"
+#include "pws_compiled.h"
+
+using namespace std;
+
+// magic, version (u32), payload length (u64), payload hash (u64)
+#define PWSC_HEADER_LEN 24
+
+enum MagicOpKind {
+  NOT_EQUAL,
+  LESS_THAN_INT,
+  LESS_THAN_FLOAT
+};
+
+static void
+compiledError(const string& fileName, const string& msg)
+{
+  cerr << "ERROR: " << fileName << ": " << msg << endl;
+  exit(1);
+}
+
+// 64-bit FNV-1a
+static uint64_t
+hashBytes(const char* data, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (unsigned char) data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// Appends sections to the payload. Every section starts 8-byte aligned,
+// so the reader can hand out pointers straight into the mapping.
+class PWSCWriter
+{
+  public:
+  vector<char> buf;
+
+  void bytes(const void* data, size_t len)
+  {
+    const char* p = static_cast<const char*>(data);
+    buf.insert(buf.end(), p, p + len);
+    buf.resize((buf.size() + 7) & ~(size_t) 7, 0);
+  }
+
+  void u64(uint64_t v) { bytes(&v, sizeof(v)); }
+
+  void str(const string& s)
+  {
+    u64(s.size());
+    bytes(s.data(), s.size());
+  }
+
+  void ints(const vector<int>& v)
+  {
+    vector<int32_t> tmp(v.begin(), v.end());
+    u64(tmp.size());
+    bytes(tmp.data(), tmp.size() * sizeof(int32_t));
+  }
+
+  void positions(const vector<GatePosition>& v)
+  {
+    vector<int32_t> tmp;
+    for (size_t i = 0; i < v.size(); i++)
+    {
+      tmp.push_back(v[i].layer);
+      tmp.push_back(v[i].name);
+    }
+    u64(v.size());
+    bytes(tmp.data(), tmp.size() * sizeof(int32_t));
+  }
+
+  void intMap(const map<int, int>& m)
+  {
+    vector<int32_t> tmp;
+    for (map<int, int>::const_iterator it = m.begin(); it != m.end(); ++it)
+    {
+      tmp.push_back(it->first);
+      tmp.push_back(it->second);
+    }
+    u64(m.size());
+    bytes(tmp.data(), tmp.size() * sizeof(int32_t));
+  }
+};
+
+class PWSCReader
+{
+  const char* p;
+  const char* end;
+  const string& fileName;
+
+  public:
+  PWSCReader(const char* data, size_t len, const string& name)
+    : p(data), end(data + len), fileName(name)
+  { }
+
+  template<typename T> const T* array(size_t n)
+  {
+    size_t len = n * sizeof(T);
+    size_t padded = (len + 7) & ~(size_t) 7;
+    if (n > (size_t) (end - p) / sizeof(T) || padded > (size_t) (end - p))
+      compiledError(fileName, "truncated compiled circuit");
+    const T* ret = reinterpret_cast<const T*>(p);
+    p += padded;
+    return ret;
+  }
+
+  uint64_t u64() { return *array<uint64_t>(1); }
+
+  string str()
+  {
+    size_t n = u64();
+    return string(array<char>(n), n);
+  }
+
+  void ints(vector<int>& v)
+  {
+    size_t n = u64();
+    const int32_t* a = array<int32_t>(n);
+    v.assign(a, a + n);
+  }
+
+  void positions(vector<GatePosition>& v)
+  {
+    size_t n = u64();
+    const int32_t* a = array<int32_t>(2 * n);
+    v.clear();
+    v.reserve(n);
+    for (size_t i = 0; i < n; i++)
+      v.push_back(GatePosition(a[2 * i], a[2 * i + 1]));
+  }
+
+  // the writer emits the pairs in key order, so each insert is at the end.
+  void intMap(map<int, int>& m)
+  {
+    size_t n = u64();
+    const int32_t* a = array<int32_t>(2 * n);
+    m.clear();
+    for (size_t i = 0; i < n; i++)
+      m.insert(m.end(), pair<int, int>(a[2 * i], a[2 * i + 1]));
+  }
+};
+
+bool PWSCompiledCircuit::
+isCompiled(const string& fileName)
+{
+  char magic[PWSC_MAGIC_LEN];
+  FILE* f = fopen(fileName.c_str(), "rb");
+  if (f == NULL)
+    return false;
+  bool ret = fread(magic, 1, PWSC_MAGIC_LEN, f) == PWSC_MAGIC_LEN &&
+             memcmp(magic, PWSC_MAGIC, PWSC_MAGIC_LEN) == 0;
+  fclose(f);
+  return ret;
+}
+
+void PWSCompiledCircuit::
+write(const PWSCircuitParser& parser, const string& fileName)
+{
+  PWSCWriter w;
+
+  char* primeStr = mpz_get_str(NULL, 10, parser.prime);
+  w.str(primeStr);
+  void (*freefunc) (void *, size_t);
+  mp_get_memory_functions(NULL, NULL, &freefunc);
+  freefunc(primeStr, strlen(primeStr) + 1);
+
+  const PWSOpCount& ops = parser.opCount;
+  w.u64(ops.numMults);
+  w.u64(ops.numAdds);
+  w.u64(ops.numIntDivs);
+  w.u64(ops.numIneqs);
+  w.u64(ops.numCmps);
+  w.u64(ops.numSubs);
+  w.u64(ops.numMuxs);
+  w.u64((int64_t) parser.outputGateBegin);
+  w.u64((int64_t) parser.largestMuxBitIndex);
+
+  // Gates, one array per field. A gate's position is implied by where it
+  // sits: the parser only ever appends (see addGate()).
+  const CircuitDescription& desc = parser.circuitDesc;
+  w.u64(desc.size());
+  for (size_t l = 0; l < desc.size(); l++)
+  {
+    const LayerDescription& layer = desc[l];
+    size_t n = layer.size();
+    vector<uint8_t> op(n);
+    vector<int32_t> in1(n), in2(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      if (layer[i].pos.layer != (int) l || layer[i].pos.name != (int) i)
+        compiledError(fileName, "gate position doesn't match its index");
+      op[i] = layer[i].op;
+      in1[i] = layer[i].in1;
+      in2[i] = layer[i].in2;
+    }
+    w.u64(n);
+    w.bytes(op.data(), n);
+    w.bytes(in1.data(), n * sizeof(int32_t));
+    w.bytes(in2.data(), n * sizeof(int32_t));
+  }
+
+  w.u64(parser.muxGates.size());
+  for (size_t l = 0; l < parser.muxGates.size(); l++)
+    w.intMap(parser.muxGates[l]);
+
+  w.intMap(parser.inGates);
+  w.intMap(parser.outGates);
+  w.ints(parser.magicGates);
+
+  w.u64(parser.inConstants.size());
+  for (size_t i = 0; i < parser.inConstants.size(); i++)
+  {
+    w.str(parser.inConstants[i].first);
+    w.u64((int64_t) parser.inConstants[i].second);
+  }
+
+  w.u64(parser.outConstants.size());
+  map<string, vector<int> >::const_iterator oit;
+  for (oit = parser.outConstants.begin(); oit != parser.outConstants.end(); ++oit)
+  {
+    w.str(oit->first);
+    w.ints(oit->second);
+  }
+
+  w.u64(parser.magicOps.size());
+  for (size_t i = 0; i < parser.magicOps.size(); i++)
+  {
+    w.ints(parser.magicOps[i].first);
+
+    MagicVarOperation* op = parser.magicOps[i].second;
+    if (LessThanFloatOperation* lt = dynamic_cast<LessThanFloatOperation*>(op))
+    {
+      w.u64(LESS_THAN_FLOAT);
+      w.positions(lt->Ms);
+      w.positions(lt->Ns);
+      w.positions(lt->Ds);
+      w.positions(vector<GatePosition>(1, lt->X1));
+      w.positions(vector<GatePosition>(1, lt->X2));
+    }
+    else if (LessThanIntOperation* lt = dynamic_cast<LessThanIntOperation*>(op))
+    {
+      w.u64(LESS_THAN_INT);
+      w.positions(lt->Ms);
+      w.positions(lt->Ns);
+      w.positions(vector<GatePosition>(1, lt->X1));
+      w.positions(vector<GatePosition>(1, lt->X2));
+    }
+    else if (NotEqualOperation* ne = dynamic_cast<NotEqualOperation*>(op))
+    {
+      w.u64(NOT_EQUAL);
+      w.positions(vector<GatePosition>(1, ne->M));
+      w.positions(vector<GatePosition>(1, ne->X1));
+      w.positions(vector<GatePosition>(1, ne->X2));
+    }
+    else
+    {
+      compiledError(fileName, "unknown magic op");
+    }
+  }
+
+  char header[PWSC_HEADER_LEN];
+  uint32_t version = PWSC_VERSION;
+  uint64_t len = w.buf.size();
+  uint64_t hash = hashBytes(w.buf.data(), w.buf.size());
+  memcpy(header, PWSC_MAGIC, PWSC_MAGIC_LEN);
+  memcpy(header + 4, &version, sizeof(version));
+  memcpy(header + 8, &len, sizeof(len));
+  memcpy(header + 16, &hash, sizeof(hash));
+
+  FILE* f = fopen(fileName.c_str(), "wb");
+  if (f == NULL)
+  {
+    perror("Couldn't open compiled circuit for writing");
+    exit(1);
+  }
+  if (fwrite(header, 1, PWSC_HEADER_LEN, f) != PWSC_HEADER_LEN ||
+      fwrite(w.buf.data(), 1, w.buf.size(), f) != w.buf.size() ||
+      fclose(f) != 0)
+  {
+    perror("Couldn't write compiled circuit");
+    exit(1);
+  }
+}
+
+static GatePosition
+onePosition(PWSCReader& r, const string& fileName)
+{
+  vector<GatePosition> v;
+  r.positions(v);
+  if (v.size() != 1)
+    compiledError(fileName, "malformed magic op");
+  return v[0];
+}
+
+void PWSCompiledCircuit::
+load(PWSCircuitParser& parser, const string& fileName)
+{
+  MappedFile file;
+  if (!file.open(fileName))
+  {
+    perror("Couldn't map compiled circuit");
+    exit(1);
+  }
+  size_t fileLen = file.size();
+  if (fileLen < PWSC_HEADER_LEN)
+    compiledError(fileName, "truncated compiled circuit");
+  const char* data = file.data();
+
+  uint32_t version;
+  uint64_t len, hash;
+  memcpy(&version, data + 4, sizeof(version));
+  memcpy(&len, data + 8, sizeof(len));
+  memcpy(&hash, data + 16, sizeof(hash));
+  if (memcmp(data, PWSC_MAGIC, PWSC_MAGIC_LEN) != 0)
+    compiledError(fileName, "not a compiled circuit");
+  if (version != PWSC_VERSION)
+    compiledError(fileName, "compiled circuit has the wrong version; recompile it with pwsc");
+  if (len != fileLen - PWSC_HEADER_LEN)
+    compiledError(fileName, "truncated compiled circuit");
+
+  const char* payload = data + PWSC_HEADER_LEN;
+  if (hashBytes(payload, len) != hash)
+    compiledError(fileName, "compiled circuit is corrupt (hash mismatch)");
+
+  PWSCReader r(payload, len, fileName);
+
+  mpz_t prime;
+  mpz_init_set_str(prime, r.str().c_str(), 10);
+  if (mpz_cmp(prime, parser.prime) != 0)
+    compiledError(fileName, "circuit was compiled for a different prime");
+  mpz_clear(prime);
+
+  PWSOpCount& ops = parser.opCount;
+  ops.numMults = r.u64();
+  ops.numAdds = r.u64();
+  ops.numIntDivs = r.u64();
+  ops.numIneqs = r.u64();
+  ops.numCmps = r.u64();
+  ops.numSubs = r.u64();
+  ops.numMuxs = r.u64();
+  parser.outputGateBegin = (int64_t) r.u64();
+  parser.largestMuxBitIndex = (int64_t) r.u64();
+
+  CircuitDescription& desc = parser.circuitDesc;
+  desc.resize(r.u64());
+  for (size_t l = 0; l < desc.size(); l++)
+  {
+    size_t n = r.u64();
+    const uint8_t* op = r.array<uint8_t>(n);
+    const int32_t* in1 = r.array<int32_t>(n);
+    const int32_t* in2 = r.array<int32_t>(n);
+
+    LayerDescription& layer = desc[l];
+    layer.clear();
+    layer.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      if (op[i] > GateDescription::MUX)
+        compiledError(fileName, "bad gate type");
+      layer.push_back(GateDescription((GateDescription::OpType) op[i], l, i, in1[i], in2[i]));
+    }
+  }
+
+  parser.muxGates.resize(r.u64());
+  for (size_t l = 0; l < parser.muxGates.size(); l++)
+    r.intMap(parser.muxGates[l]);
+
+  r.intMap(parser.inGates);
+  r.intMap(parser.outGates);
+  r.ints(parser.magicGates);
+
+  size_t nIn = r.u64();
+  for (size_t i = 0; i < nIn; i++)
+  {
+    string value = r.str();
+    parser.inConstants.push_back(pair<string, int>(value, (int64_t) r.u64()));
+  }
+
+  size_t nOut = r.u64();
+  for (size_t i = 0; i < nOut; i++)
+  {
+    string value = r.str();
+    r.ints(parser.outConstants[value]);
+  }
+
+  size_t nMagic = r.u64();
+  for (size_t i = 0; i < nMagic; i++)
+  {
+    vector<int> guard;
+    r.ints(guard);
+
+    vector<GatePosition> ms, ns, ds;
+    MagicVarOperation* op = NULL;
+    switch (r.u64())
+    {
+      case NOT_EQUAL:
+      {
+        GatePosition m = onePosition(r, fileName);
+        GatePosition x1 = onePosition(r, fileName);
+        GatePosition x2 = onePosition(r, fileName);
+        op = new NotEqualOperation(m, x1, x2);
+        break;
+      }
+      case LESS_THAN_INT:
+      {
+        r.positions(ms);
+        r.positions(ns);
+        GatePosition x1 = onePosition(r, fileName);
+        GatePosition x2 = onePosition(r, fileName);
+        op = new LessThanIntOperation(ms, ns, x1, x2);
+        break;
+      }
+      case LESS_THAN_FLOAT:
+      {
+        r.positions(ms);
+        r.positions(ns);
+        r.positions(ds);
+        GatePosition x1 = onePosition(r, fileName);
+        GatePosition x2 = onePosition(r, fileName);
+        op = new LessThanFloatOperation(ms, ns, ds, x1, x2);
+        break;
+      }
+      default:
+        compiledError(fileName, "unknown magic op");
+    }
+    parser.magicOps.push_back(pair<vector<int>, MagicVarOperation*>(guard, op));
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef CODE_PEPPER_CMTGKR_CIRCUIT_PWS_COMPILED_H_
+#define CODE_PEPPER_CMTGKR_CIRCUIT_PWS_COMPILED_H_
+
+#include <string>
+
+class PWSCircuitParser;
+
+// Compiled ("pwsc") circuits: what PWSCircuitParser::parse() leaves behind
+// for a .pws file, written out once so later runs can map it back in
+// instead of re-parsing the text.
+//
+// The file is a header (PWSC_MAGIC, PWSC_VERSION, payload length and an
+// FNV-1a hash of the payload) followed by 8-byte-aligned sections: the
+// prime, the op counts, then per layer the gate ops, in1s and in2s as
+// three separate arrays, then the mux maps, the in/out/magic gate maps,
+// the input and output constants, and the magic ops with their guards.
+//
+// parse() recognizes a compiled file by its magic, so any tool that takes
+// a .pws file also takes a .pwsc one (see pws2sv/pwsc.cpp).
+#define PWSC_MAGIC "PWSC"
+#define PWSC_MAGIC_LEN 4
+#define PWSC_VERSION 1
+
+class PWSCompiledCircuit
+{
+  public:
+  static bool isCompiled(const std::string& fileName);
+
+  static void write(const PWSCircuitParser& parser, const std::string& fileName);
+  static void load(PWSCircuitParser& parser, const std::string& fileName);
+};
+
+#endif
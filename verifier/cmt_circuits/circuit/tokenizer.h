@@ -1,63 +1,107 @@
 #ifndef CODE_PEPPER_CMTGKR_CIRCUIT_TOKENIZER_H_
 #define CODE_PEPPER_CMTGKR_CIRCUIT_TOKENIZER_H_
 
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Whitespace-separated tokens, scanned in place from a buffer holding the
+// whole worksheet (see MappedFile). Nothing is allocated per token: a token
+// is copied into the caller's string, whose capacity gets reused, and
+// nextIs() compares against the buffer directly.
 class Tokenizer
 {
-  std::streampos lastPos;
-  std::istream& in;
+  const char* begin;
+  const char* cur;
+  const char* end;
+  const char* lastPos;
 
-  public:
-  Tokenizer(std::istream& is)
-    : in(is)
+  static bool isSpace(char c)
   {
-    lastPos = in.tellg();
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
   }
 
-  bool hasNext()
+  void skipSpace()
   {
-    return !in.eof();
+    while (cur < end && isSpace(*cur))
+      cur++;
   }
 
-  std::istream& stream() { return in; }
+  public:
+  Tokenizer(const char* data, size_t len)
+    : begin(data), cur(data), end(data + len), lastPos(data)
+  { }
 
-  template<class T>
-  bool next(T& var)
+  // The next token is [tok, tok + len); false (and len == 0) if there is none.
+  bool next(const char*& tok, size_t& len)
   {
-    bool success = false;
-    lastPos = in.tellg();
+    lastPos = cur;
+    skipSpace();
+    tok = cur;
+    while (cur < end && !isSpace(*cur))
+      cur++;
+    len = cur - tok;
+    return len > 0;
+  }
 
-    if (hasNext())
-    {
-      in >> var;
-      success = in.good();
-    }
+  // Bytes consumed so far.
+  size_t offset() const { return cur - begin; }
 
-    return success;
+  bool hasNext()
+  {
+    skipSpace();
+    return cur < end;
   }
 
   bool operator >>(int& integer)
   {
-    return next(integer);
+    const char* tok;
+    size_t len;
+    if (!next(tok, len))
+      return false;
+
+    // the buffer isn't NUL-terminated, so strtol gets a copy.
+    char buf[32];
+    len = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
+    memcpy(buf, tok, len);
+    buf[len] = '\0';
+
+    char* numEnd;
+    integer = strtol(buf, &numEnd, 10);
+    return numEnd != buf;
   }
 
   bool operator >>(std::string& token)
   {
-    return next(token);
+    const char* tok;
+    size_t len;
+    bool success = next(tok, len);
+    token.assign(tok, len);
+    return success;
+  }
+
+  // Consume the next token; is it expected?
+  bool nextIs(const char* expected)
+  {
+    const char* tok;
+    size_t len;
+    next(tok, len);
+    return len == strlen(expected) && memcmp(tok, expected, len) == 0;
   }
 
   void rewind()
   {
-    if (lastPos >= 0)
-      in.seekg(lastPos);
+    cur = lastPos;
   }
 
   void ignoreLine()
   {
-    lastPos = in.tellg();
-    std::string str;
-    std::getline(in, str);
+    lastPos = cur;
+    while (cur < end && *cur != '\n')
+      cur++;
+    if (cur < end)
+      cur++;
   }
 };
 
 #endif
-
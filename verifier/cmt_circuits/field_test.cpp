@@ -0,0 +1,123 @@
+#include <cstdlib>
+#include <iostream>
+
+#include <gmp.h>
+#include <gmpxx.h>
+#include <common/fp25519.h>
+#include <common/fp61.h>
+
+using namespace std;
+
+// Checks Fp25519 and Fp61 (set, get, +, -, *, negation, half) against
+// GMP on random operands mixed with edge values, including operands
+// outside [0, p) for set(). Exits nonzero on the first mismatch.
+
+static gmp_randstate_t rnd;
+
+// any integer set() might be given: mostly below p, but also p itself,
+// 2^k - 1 up to twice the width of an element, and negative numbers.
+static mpz_class
+randomArg(const mpz_class& p)
+{
+  const unsigned long bits = mpz_sizeinbase(p.get_mpz_t(), 2);
+  mpz_class x;
+  switch (gmp_urandomm_ui(rnd, 12))
+  {
+    case 0: x = 0; break;
+    case 1: x = 1; break;
+    case 2: x = p - 1; break;
+    case 3: x = p; break;
+    case 4: x = p + 1; break;
+    case 5: x = (mpz_class(1) << gmp_urandomm_ui(rnd, 2 * bits + 2)) - 1; break;
+    case 6: mpz_urandomb(x.get_mpz_t(), rnd, 2 * bits + 64); break;
+    case 7: mpz_urandomm(x.get_mpz_t(), rnd, p.get_mpz_t()); x = -x; break;
+    default: mpz_urandomm(x.get_mpz_t(), rnd, p.get_mpz_t());
+  }
+  return x;
+}
+
+static mpz_class
+modp(const mpz_class& x, const mpz_class& p)
+{
+  mpz_class r;
+  mpz_mod(r.get_mpz_t(), x.get_mpz_t(), p.get_mpz_t());
+  return r;
+}
+
+template<typename F> static mpz_class
+value(const F& x)
+{
+  mpz_class r;
+  x.get(r.get_mpz_t());
+  return r;
+}
+
+template<typename F> static bool
+check(const char* field, const char* op, const F& got, const mpz_class& want,
+      const mpz_class& a, const mpz_class& b)
+{
+  if (value(got) == want)
+    return true;
+  cout << field << ": " << op << " differs for a = " << a.get_str(16) << ", b = " << b.get_str(16)
+       << ": got " << value(got).get_str(16) << ", want " << want.get_str(16) << endl;
+  return false;
+}
+
+template<typename F> static bool
+checkField(const char* field, const mpz_class& p, int trials)
+{
+  const mpz_class inv2 = (p + 1) / 2;
+  bool ok = true;
+
+  for (int t = 0; t < trials && ok; t++)
+  {
+    const mpz_class a = randomArg(p), b = randomArg(p);
+    const mpz_class ra = modp(a, p), rb = modp(b, p);
+    const F fa(a.get_mpz_t()), fb(b.get_mpz_t());
+
+    ok = ok && check(field, "set", fa, ra, a, b);
+    ok = ok && check(field, "+", fa + fb, modp(ra + rb, p), a, b);
+    ok = ok && check(field, "-", fa - fb, modp(ra - rb, p), a, b);
+    ok = ok && check(field, "*", fa * fb, modp(ra * rb, p), a, b);
+    ok = ok && check(field, "negation", -fa, modp(-ra, p), a, b);
+    ok = ok && check(field, "half", fa.half(), modp(ra * inv2, p), a, b);
+
+    F acc(fa);
+    acc *= fb;
+    acc += fa;
+    acc -= fb;
+    ok = ok && check(field, "*=, +=, -=", acc, modp(ra * rb + ra - rb, p), a, b);
+
+    if ((fa == fb) != (ra == rb) || fa.isZero() != (ra == 0))
+    {
+      cout << field << ": == or isZero() wrong for a = " << a.get_str(16) << ", b = " << b.get_str(16) << endl;
+      ok = false;
+    }
+  }
+
+  // the uint64_t constructor, which takes anything up to 2^64 - 1.
+  const uint64_t smalls[] = { 0, 1, 19, (1ULL << 61) - 2, (1ULL << 61) - 1, 1ULL << 61, ~0ULL };
+  for (size_t i = 0; i < sizeof(smalls) / sizeof(smalls[0]); i++)
+  {
+    const mpz_class x(static_cast<unsigned long>(smalls[i]));
+    ok = ok && check(field, "F(uint64_t)", F(smalls[i]), modp(x, p), x, x);
+  }
+
+  cout << field << ": " << trials << " trials " << (ok ? "ok" : "FAILED") << endl;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+    gmp_randinit_default(rnd);
+    gmp_randseed_ui(rnd, (argc > 1) ? strtoul(argv[1], NULL, 0) : 1);
+    const int trials = (argc > 2) ? atoi(argv[2]) : 200000;
+
+    const mpz_class p61 = (mpz_class(1) << 61) - 1;
+    const mpz_class p25519 = (mpz_class(1) << 255) - 19;
+
+    bool ok = checkField<Fp61>("Fp61", p61, trials);
+    ok = checkField<Fp25519>("Fp25519", p25519, trials) && ok;
+
+    gmp_randclear(rnd);
+    return ok ? 0 : 1;
+}
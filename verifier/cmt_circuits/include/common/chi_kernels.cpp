@@ -0,0 +1,478 @@
+#include <cstdlib>
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include "chi_kernels.h"
+#include "poly_utils.h"
+
+// The kernels work on the raw residues (see Fp61::raw() and
+// Fp25519::raw()).
+static_assert(sizeof(Fp61) == sizeof(uint64_t), "Fp61 must be a bare uint64_t");
+static_assert(sizeof(Fp25519) == 4 * sizeof(uint64_t), "Fp25519 must be four bare limbs");
+
+#define FP61_P 0x1FFFFFFFFFFFFFFFULL
+
+// the generic chiDoubleStep() in poly_utils.h.
+template<typename F> static void
+chiStepScalar(F* tab, size_t base, size_t nhi, const F& r)
+{
+  chiDoubleStep<F>(tab, base, nhi, r);
+}
+
+/*
+ * The vector multiply, for a, b < p = 2^61 - 1: split each into 32-bit
+ * halves, a = ah 2^32 + al (so ah < 2^29), and use the 32x32 -> 64
+ * multiplies. With 2^61 = 1 (mod p),
+ *     ah bh 2^64          = 8 ah bh
+ *     (ah bl + al bh) 2^32 = m 2^32 = (m >> 29) + ((m mod 2^29) << 32)
+ *     al bl               = (al bl mod 2^61) + (al bl >> 61)
+ * and the sum of those is < 2^63, so one more fold and a conditional
+ * subtract reduce it.
+ */
+
+__attribute__((target("avx2"))) static inline __m256i
+mulFp61x4(__m256i a, __m256i b)
+{
+  const __m256i P = _mm256_set1_epi64x(FP61_P);
+  const __m256i LO29 = _mm256_set1_epi64x((1LL << 29) - 1);
+
+  __m256i ah = _mm256_srli_epi64(a, 32);
+  __m256i bh = _mm256_srli_epi64(b, 32);
+
+  __m256i ll = _mm256_mul_epu32(a, b);
+  __m256i hh = _mm256_mul_epu32(ah, bh);
+  __m256i m = _mm256_add_epi64(_mm256_mul_epu32(ah, b), _mm256_mul_epu32(a, bh));
+
+  __m256i s = _mm256_slli_epi64(hh, 3);
+  s = _mm256_add_epi64(s, _mm256_srli_epi64(m, 29));
+  s = _mm256_add_epi64(s, _mm256_slli_epi64(_mm256_and_si256(m, LO29), 32));
+  s = _mm256_add_epi64(s, _mm256_and_si256(ll, P));
+  s = _mm256_add_epi64(s, _mm256_srli_epi64(ll, 61));
+
+  s = _mm256_add_epi64(_mm256_and_si256(s, P), _mm256_srli_epi64(s, 61));
+  // s < 2^62, so the signed compare is safe.
+  __m256i ge = _mm256_cmpgt_epi64(s, _mm256_set1_epi64x(FP61_P - 1));
+  return _mm256_sub_epi64(s, _mm256_and_si256(ge, P));
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+subFp61x4(__m256i a, __m256i b)
+{
+  __m256i lt = _mm256_cmpgt_epi64(b, a);
+  return _mm256_add_epi64(_mm256_sub_epi64(a, b), _mm256_and_si256(lt, _mm256_set1_epi64x(FP61_P)));
+}
+
+__attribute__((target("avx2"))) static void
+chiStepFp61AVX2(Fp61* t, size_t base, size_t nhi, const Fp61& fr)
+{
+  uint64_t* tab = reinterpret_cast<uint64_t*>(t);
+  const Fp61 fomr = Fp61(1) - fr;
+  const __m256i vr = _mm256_set1_epi64x(fr.raw());
+  const __m256i vomr = _mm256_set1_epi64x(fomr.raw());
+
+  size_t i = 0;
+  for (; i + 4 <= nhi; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i*) (tab + i));
+    __m256i y = mulFp61x4(x, vr);
+    _mm256_storeu_si256((__m256i*) (tab + base + i), y);
+    _mm256_storeu_si256((__m256i*) (tab + i), subFp61x4(x, y));
+  }
+  // the first few levels, and whatever doesn't fill a vector.
+  for (; i < nhi; i++)
+  {
+    t[base + i] = t[i] * fr;
+    t[i] -= t[base + i];
+  }
+
+  for (; i + 4 <= base; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i*) (tab + i));
+    _mm256_storeu_si256((__m256i*) (tab + i), mulFp61x4(x, vomr));
+  }
+  for (; i < base; i++)
+    t[i] *= fomr;
+}
+
+__attribute__((target("avx512f"))) static inline __m512i
+mulFp61x8(__m512i a, __m512i b)
+{
+  const __m512i P = _mm512_set1_epi64(FP61_P);
+  const __m512i LO29 = _mm512_set1_epi64((1LL << 29) - 1);
+
+  __m512i ah = _mm512_srli_epi64(a, 32);
+  __m512i bh = _mm512_srli_epi64(b, 32);
+
+  __m512i ll = _mm512_mul_epu32(a, b);
+  __m512i hh = _mm512_mul_epu32(ah, bh);
+  __m512i m = _mm512_add_epi64(_mm512_mul_epu32(ah, b), _mm512_mul_epu32(a, bh));
+
+  __m512i s = _mm512_slli_epi64(hh, 3);
+  s = _mm512_add_epi64(s, _mm512_srli_epi64(m, 29));
+  s = _mm512_add_epi64(s, _mm512_slli_epi64(_mm512_and_si512(m, LO29), 32));
+  s = _mm512_add_epi64(s, _mm512_and_si512(ll, P));
+  s = _mm512_add_epi64(s, _mm512_srli_epi64(ll, 61));
+
+  s = _mm512_add_epi64(_mm512_and_si512(s, P), _mm512_srli_epi64(s, 61));
+  __mmask8 ge = _mm512_cmpge_epu64_mask(s, P);
+  return _mm512_mask_sub_epi64(s, ge, s, P);
+}
+
+__attribute__((target("avx512f"))) static inline __m512i
+subFp61x8(__m512i a, __m512i b)
+{
+  __mmask8 lt = _mm512_cmplt_epu64_mask(a, b);
+  __m512i d = _mm512_sub_epi64(a, b);
+  return _mm512_mask_add_epi64(d, lt, d, _mm512_set1_epi64(FP61_P));
+}
+
+__attribute__((target("avx512f"))) static void
+chiStepFp61AVX512(Fp61* t, size_t base, size_t nhi, const Fp61& fr)
+{
+  uint64_t* tab = reinterpret_cast<uint64_t*>(t);
+  const Fp61 fomr = Fp61(1) - fr;
+  const __m512i vr = _mm512_set1_epi64(fr.raw());
+  const __m512i vomr = _mm512_set1_epi64(fomr.raw());
+
+  size_t i = 0;
+  for (; i + 8 <= nhi; i += 8)
+  {
+    __m512i x = _mm512_loadu_si512((const void*) (tab + i));
+    __m512i y = mulFp61x8(x, vr);
+    _mm512_storeu_si512((void*) (tab + base + i), y);
+    _mm512_storeu_si512((void*) (tab + i), subFp61x8(x, y));
+  }
+  for (; i < nhi; i++)
+  {
+    t[base + i] = t[i] * fr;
+    t[i] -= t[base + i];
+  }
+
+  for (; i + 8 <= base; i += 8)
+  {
+    __m512i x = _mm512_loadu_si512((const void*) (tab + i));
+    _mm512_storeu_si512((void*) (tab + i), mulFp61x8(x, vomr));
+  }
+  for (; i < base; i++)
+    t[i] *= fomr;
+}
+
+/*
+ * Fp25519, p = 2^255 - 19, with AVX-512 IFMA. A vector holds the same
+ * limb of 8 elements, so each element is first split into five 52-bit
+ * limbs, which the 52x52 -> 104 bit multiply-adds take whole, and the
+ * products summed by column: each column is at most ten 52-bit halves.
+ * Carrying the top five columns to 52 bits first keeps 608 times them
+ * below 2^62, and 2^260 = 2^5 * 19 = 608 (mod p) folds them down. The
+ * result is carried back to 52-bit limbs, with the bits above 2^255
+ * folded in times 19, and frozen (x - p if x >= p), since Fp25519s are
+ * kept fully reduced.
+ *
+ * There's no AVX2 version: with only 32x32 -> 64 bit multiplies it takes
+ * ten 25.5-bit limbs and 100 multiplies per product, and even before the
+ * carries that is slower than the scalar code's 16 64-bit multiplies.
+ */
+
+#define F52_MASK ((1ULL << 52) - 1)
+#define F47_MASK ((1ULL << 47) - 1)
+
+// four vectors, the limbs of elements 2j and 2j + 1 in vector j, to one
+// vector per limb, element j in lane j.
+__attribute__((target("avx512f"))) static inline void
+transposeIn52(__m512i x[4], const uint64_t* p)
+{
+  const __m512i a0 = _mm512_loadu_si512((const void*) p);
+  const __m512i a1 = _mm512_loadu_si512((const void*) (p + 8));
+  const __m512i a2 = _mm512_loadu_si512((const void*) (p + 16));
+  const __m512i a3 = _mm512_loadu_si512((const void*) (p + 24));
+
+  for (int k = 0; k < 4; k++)
+  {
+    const __m512i idx = _mm512_setr_epi64(k, 4 + k, 8 + k, 12 + k, k, 4 + k, 8 + k, 12 + k);
+    __m512i lo = _mm512_permutex2var_epi64(a0, idx, a1);
+    __m512i hi = _mm512_permutex2var_epi64(a2, idx, a3);
+    x[k] = _mm512_shuffle_i64x2(lo, hi, 0x44);
+  }
+}
+
+__attribute__((target("avx512f"))) static inline void
+transposeOut52(uint64_t* p, const __m512i x[4])
+{
+  const __m512i pairLo = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+  const __m512i pairHi = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+  const __m512i quadLo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+  const __m512i quadHi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+
+  __m512i t01 = _mm512_permutex2var_epi64(x[0], pairLo, x[1]);
+  __m512i t23 = _mm512_permutex2var_epi64(x[2], pairLo, x[3]);
+  __m512i u01 = _mm512_permutex2var_epi64(x[0], pairHi, x[1]);
+  __m512i u23 = _mm512_permutex2var_epi64(x[2], pairHi, x[3]);
+
+  _mm512_storeu_si512((void*) p, _mm512_permutex2var_epi64(t01, quadLo, t23));
+  _mm512_storeu_si512((void*) (p + 8), _mm512_permutex2var_epi64(t01, quadHi, t23));
+  _mm512_storeu_si512((void*) (p + 16), _mm512_permutex2var_epi64(u01, quadLo, u23));
+  _mm512_storeu_si512((void*) (p + 24), _mm512_permutex2var_epi64(u01, quadHi, u23));
+}
+
+__attribute__((target("avx512f"))) static inline void
+toLimbs52(__m512i z[5], const __m512i x[4])
+{
+  const __m512i M = _mm512_set1_epi64(F52_MASK);
+  z[0] = _mm512_and_si512(x[0], M);
+  z[1] = _mm512_and_si512(_mm512_or_si512(_mm512_srli_epi64(x[0], 52), _mm512_slli_epi64(x[1], 12)), M);
+  z[2] = _mm512_and_si512(_mm512_or_si512(_mm512_srli_epi64(x[1], 40), _mm512_slli_epi64(x[2], 24)), M);
+  z[3] = _mm512_and_si512(_mm512_or_si512(_mm512_srli_epi64(x[2], 28), _mm512_slli_epi64(x[3], 36)), M);
+  z[4] = _mm512_srli_epi64(x[3], 16);
+}
+
+// z must be fully reduced.
+__attribute__((target("avx512f"))) static inline void
+fromLimbs52(__m512i x[4], const __m512i z[5])
+{
+  x[0] = _mm512_or_si512(z[0], _mm512_slli_epi64(z[1], 52));
+  x[1] = _mm512_or_si512(_mm512_srli_epi64(z[1], 12), _mm512_slli_epi64(z[2], 40));
+  x[2] = _mm512_or_si512(_mm512_srli_epi64(z[2], 24), _mm512_slli_epi64(z[3], 28));
+  x[3] = _mm512_or_si512(_mm512_srli_epi64(z[3], 36), _mm512_slli_epi64(z[4], 16));
+}
+
+// any limbs below 2^62 to the residue of their sum, fully reduced.
+__attribute__((target("avx512f"))) static inline void
+freeze52(__m512i z[5])
+{
+  const __m512i M = _mm512_set1_epi64(F52_MASK);
+  const __m512i M47 = _mm512_set1_epi64(F47_MASK);
+
+  for (int k = 0; k < 4; k++)
+  {
+    z[k + 1] = _mm512_add_epi64(z[k + 1], _mm512_srli_epi64(z[k], 52));
+    z[k] = _mm512_and_si512(z[k], M);
+  }
+
+  // 2^255 = 19; the top is < 2^15.
+  __m512i top = _mm512_srli_epi64(z[4], 47);
+  z[4] = _mm512_and_si512(z[4], M47);
+  z[0] = _mm512_add_epi64(z[0], _mm512_add_epi64(_mm512_slli_epi64(top, 4),
+                                                 _mm512_add_epi64(_mm512_slli_epi64(top, 1), top)));
+  for (int k = 0; k < 4; k++)
+  {
+    z[k + 1] = _mm512_add_epi64(z[k + 1], _mm512_srli_epi64(z[k], 52));
+    z[k] = _mm512_and_si512(z[k], M);
+  }
+
+  // now z < 2p, and z >= p iff z + 19 >= 2^255.
+  __m512i t[5];
+  t[0] = _mm512_add_epi64(z[0], _mm512_set1_epi64(19));
+  for (int k = 0; k < 4; k++)
+  {
+    t[k + 1] = _mm512_add_epi64(z[k + 1], _mm512_srli_epi64(t[k], 52));
+    t[k] = _mm512_and_si512(t[k], M);
+  }
+  __mmask8 ge = _mm512_test_epi64_mask(t[4], _mm512_set1_epi64(1ULL << 47));
+  t[4] = _mm512_and_si512(t[4], M47);
+  for (int k = 0; k < 5; k++)
+    z[k] = _mm512_mask_mov_epi64(z[k], ge, t[k]);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) static inline void
+mul52(__m512i h[5], const __m512i a[5], const __m512i b[5])
+{
+  const __m512i M = _mm512_set1_epi64(F52_MASK);
+
+  __m512i z[10];
+  for (int k = 0; k < 10; k++)
+    z[k] = _mm512_setzero_si512();
+  for (int i = 0; i < 5; i++)
+  {
+    for (int j = 0; j < 5; j++)
+    {
+      z[i + j] = _mm512_madd52lo_epu64(z[i + j], a[i], b[j]);
+      z[i + j + 1] = _mm512_madd52hi_epu64(z[i + j + 1], a[i], b[j]);
+    }
+  }
+
+  for (int k = 0; k < 9; k++)
+  {
+    z[k + 1] = _mm512_add_epi64(z[k + 1], _mm512_srli_epi64(z[k], 52));
+    z[k] = _mm512_and_si512(z[k], M);
+  }
+
+  // 2^260 = 608 = 512 + 64 + 32.
+  for (int k = 0; k < 5; k++)
+  {
+    __m512i w = z[k + 5];
+    w = _mm512_add_epi64(_mm512_slli_epi64(w, 9),
+                         _mm512_add_epi64(_mm512_slli_epi64(w, 6), _mm512_slli_epi64(w, 5)));
+    h[k] = _mm512_add_epi64(z[k], w);
+  }
+  freeze52(h);
+}
+
+// a - b for fully reduced a and b, as a + 2p - b, which keeps every limb
+// positive.
+__attribute__((target("avx512f"))) static inline void
+sub52(__m512i h[5], const __m512i a[5], const __m512i b[5])
+{
+  const __m512i P2[5] = {
+    _mm512_set1_epi64(2 * (F52_MASK - 18)), _mm512_set1_epi64(2 * F52_MASK),
+    _mm512_set1_epi64(2 * F52_MASK), _mm512_set1_epi64(2 * F52_MASK),
+    _mm512_set1_epi64(2 * F47_MASK)
+  };
+  for (int k = 0; k < 5; k++)
+    h[k] = _mm512_sub_epi64(_mm512_add_epi64(a[k], P2[k]), b[k]);
+  freeze52(h);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) static void
+chiStepFp25519IFMA(Fp25519* t, size_t base, size_t nhi, const Fp25519& fr)
+{
+  uint64_t* tab = reinterpret_cast<uint64_t*>(t);
+  const Fp25519 fomr = Fp25519(1) - fr;
+
+  __m512i x[4], vr[5], vomr[5];
+  for (int k = 0; k < 4; k++)
+    x[k] = _mm512_set1_epi64(fr.raw()[k]);
+  toLimbs52(vr, x);
+  for (int k = 0; k < 4; k++)
+    x[k] = _mm512_set1_epi64(fomr.raw()[k]);
+  toLimbs52(vomr, x);
+
+  __m512i a[5], y[5], d[5];
+  size_t i = 0;
+  for (; i + 8 <= nhi; i += 8)
+  {
+    transposeIn52(x, tab + 4 * i);
+    toLimbs52(a, x);
+    mul52(y, a, vr);
+    sub52(d, a, y);
+    fromLimbs52(x, y);
+    transposeOut52(tab + 4 * (base + i), x);
+    fromLimbs52(x, d);
+    transposeOut52(tab + 4 * i, x);
+  }
+  for (; i < nhi; i++)
+  {
+    t[base + i] = t[i] * fr;
+    t[i] -= t[base + i];
+  }
+
+  for (; i + 8 <= base; i += 8)
+  {
+    transposeIn52(x, tab + 4 * i);
+    toLimbs52(a, x);
+    mul52(y, a, vomr);
+    fromLimbs52(x, y);
+    transposeOut52(tab + 4 * i, x);
+  }
+  for (; i < base; i++)
+    t[i] *= fomr;
+}
+
+// The kernels for each field, best first; a kernel runs if the CPU has
+// what it needs.
+template<typename F> struct ChiKernel
+{
+  void (*fn)(F* tab, size_t base, size_t nhi, const F& r);
+  const char* name;
+  bool (*runs)();
+};
+
+static bool always() { return true; }
+static bool haveAVX2() { __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }
+static bool haveAVX512F() { __builtin_cpu_init(); return __builtin_cpu_supports("avx512f"); }
+static bool haveIFMA()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+}
+
+static const ChiKernel<Fp61> fp61Kernels[] = {
+  { chiStepFp61AVX512, "avx512f", haveAVX512F },
+  { chiStepFp61AVX2, "avx2", haveAVX2 },
+  { chiStepScalar<Fp61>, "scalar", always },
+};
+
+static const ChiKernel<Fp25519> fp25519Kernels[] = {
+  { chiStepFp25519IFMA, "avx512ifma", haveIFMA },
+  { chiStepScalar<Fp25519>, "scalar", always },
+};
+
+template<typename F, size_t N> static std::vector<const ChiKernel<F>*>
+runnable(const ChiKernel<F> (&all)[N])
+{
+  std::vector<const ChiKernel<F>*> ks;
+  for (size_t k = 0; k < N; k++)
+  {
+    if (all[k].runs())
+      ks.push_back(&all[k]);
+  }
+  return ks;
+}
+
+static const std::vector<const ChiKernel<Fp61>*>&
+kernels(const Fp61*)
+{
+  static const std::vector<const ChiKernel<Fp61>*> ks = runnable(fp61Kernels);
+  return ks;
+}
+
+static const std::vector<const ChiKernel<Fp25519>*>&
+kernels(const Fp25519*)
+{
+  static const std::vector<const ChiKernel<Fp25519>*> ks = runnable(fp25519Kernels);
+  return ks;
+}
+
+// the one chiDoubleStep() uses.
+template<typename F> static const ChiKernel<F>&
+chiKernel()
+{
+  static const ChiKernel<F>& k =
+    *(getenv("CMT_NO_SIMD") != NULL ? kernels((F*) NULL).back() : kernels((F*) NULL).front());
+  return k;
+}
+
+void
+chiDoubleStep(Fp61* tab, size_t base, size_t nhi, const Fp61& r)
+{
+  chiKernel<Fp61>().fn(tab, base, nhi, r);
+}
+
+void
+chiDoubleStep(Fp25519* tab, size_t base, size_t nhi, const Fp25519& r)
+{
+  chiKernel<Fp25519>().fn(tab, base, nhi, r);
+}
+
+template<typename F> const char*
+chiKernelName()
+{
+  return chiKernel<F>().name;
+}
+
+template<typename F> size_t
+chiKernelCount()
+{
+  return kernels((F*) NULL).size();
+}
+
+template<typename F> const char*
+chiKernelName(size_t k)
+{
+  return kernels((F*) NULL).at(k)->name;
+}
+
+template<typename F> void
+chiDoubleStep(size_t k, F* tab, size_t base, size_t nhi, const F& r)
+{
+  kernels((F*) NULL).at(k)->fn(tab, base, nhi, r);
+}
+
+template const char* chiKernelName<Fp61>();
+template const char* chiKernelName<Fp25519>();
+template size_t chiKernelCount<Fp61>();
+template size_t chiKernelCount<Fp25519>();
+template const char* chiKernelName<Fp61>(size_t);
+template const char* chiKernelName<Fp25519>(size_t);
+template void chiDoubleStep<Fp61>(size_t, Fp61*, size_t, size_t, const Fp61&);
+template void chiDoubleStep<Fp25519>(size_t, Fp25519*, size_t, size_t, const Fp25519&);
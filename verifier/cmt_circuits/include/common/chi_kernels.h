@@ -0,0 +1,37 @@
+#ifndef CODE_PEPPER_COMMON_CHI_KERNELS_H_
+#define CODE_PEPPER_COMMON_CHI_KERNELS_H_
+
+#include <stddef.h>
+
+#include "fp25519.h"
+#include "fp61.h"
+
+/*
+ * One doubling step of a chi table over a new coordinate r:
+ *     tab[base + i]  = tab[i] * r        for i < nhi (nhi <= base)
+ *     tab[i]        *= 1 - r             for i < base
+ *
+ * extendChiAll() (poly_utils.h) does one of these per coordinate. The
+ * generic version there works for any field type; these overloads run
+ * the multiplies several lanes at a time if the CPU can (checked once,
+ * at the first call) and plain scalar code otherwise:
+ *     Fp61     AVX-512F (8 lanes) or AVX2 (4 lanes)
+ *     Fp25519  AVX-512 IFMA (8 lanes)
+ * Setting CMT_NO_SIMD in the environment forces the scalar code, e.g.,
+ * for comparison.
+ */
+void chiDoubleStep(Fp61* tab, size_t base, size_t nhi, const Fp61& r);
+void chiDoubleStep(Fp25519* tab, size_t base, size_t nhi, const Fp25519& r);
+
+// which implementation chiDoubleStep() uses for F, e.g., "avx2" or
+// "scalar".
+template<typename F> const char* chiKernelName();
+
+// Every implementation this CPU can run for F, regardless of
+// CMT_NO_SIMD, with "scalar" last; and one step with the kth of them.
+// For chi_kernel_test, which checks each against the scalar one.
+template<typename F> size_t chiKernelCount();
+template<typename F> const char* chiKernelName(size_t k);
+template<typename F> void chiDoubleStep(size_t k, F* tab, size_t base, size_t nhi, const F& r);
+
+#endif  // CODE_PEPPER_COMMON_CHI_KERNELS_H_
@@ -0,0 +1,224 @@
+#ifndef CODE_PEPPER_COMMON_FP25519_H_
+#define CODE_PEPPER_COMMON_FP25519_H_
+
+#include <stdint.h>
+#include <gmp.h>
+#include <vector>
+
+#if GMP_NUMB_BITS != 64
+#error "Fp25519 assumes 64-bit GMP limbs"
+#endif
+
+__extension__ typedef unsigned __int128 fp25519_u128;
+
+// An element of GF(2^255 - 19), as four 64-bit limbs (least significant
+// first) kept fully reduced, so equality is limb equality. Unlike an
+// mpz_t it never touches the heap, so vectors of them are one flat
+// allocation and temporaries are free.
+//
+// Reduction is pseudo-Mersenne: 2^255 = 19, so 2^256 = 38 (mod p).
+class Fp25519
+{
+  private:
+    static constexpr uint64_t P0 = 0xFFFFFFFFFFFFFFEDULL;
+    static constexpr uint64_t P1 = 0xFFFFFFFFFFFFFFFFULL;
+    static constexpr uint64_t P3 = 0x7FFFFFFFFFFFFFFFULL;
+
+    uint64_t v[4];
+
+    // x < 2^256 - 19 to x mod p, given that x < 2p.
+    static void freeze(uint64_t x[4])
+    {
+      uint64_t t[4];
+      fp25519_u128 c = (fp25519_u128) x[0] + 19;
+      t[0] = (uint64_t) c;
+      for (int i = 1; i < 4; i++)
+      {
+        c = (fp25519_u128) x[i] + (uint64_t) (c >> 64);
+        t[i] = (uint64_t) c;
+      }
+
+      // x + 19 >= 2^255 iff x >= p, and then x - p = x + 19 - 2^255.
+      if (t[3] >> 63)
+      {
+        x[0] = t[0]; x[1] = t[1]; x[2] = t[2];
+        x[3] = t[3] & P3;
+      }
+    }
+
+    // any x < 2^256 to x mod p.
+    static void reduce256(uint64_t x[4])
+    {
+      uint64_t c = 19 * (x[3] >> 63);
+      x[3] &= P3;
+      for (int i = 0; i < 4 && c; i++)
+      {
+        x[i] += c;
+        c = x[i] < c;
+      }
+      freeze(x);
+    }
+
+    // a 512-bit product to its value mod p.
+    static void reduce512(uint64_t r[4], const uint64_t t[8])
+    {
+      fp25519_u128 c = 0;
+      for (int i = 0; i < 4; i++)
+      {
+        c += (fp25519_u128) t[i + 4] * 38 + t[i];
+        r[i] = (uint64_t) c;
+        c >>= 64;
+      }
+
+      // fold the carry (at most 38) back in; this can carry out of the
+      // top limb at most once more, and then only into a tiny value.
+      uint64_t top = (uint64_t) c;
+      while (top)
+      {
+        c = (fp25519_u128) r[0] + (fp25519_u128) top * 38;
+        r[0] = (uint64_t) c;
+        for (int i = 1; i < 4; i++)
+        {
+          c = (fp25519_u128) r[i] + (uint64_t) (c >> 64);
+          r[i] = (uint64_t) c;
+        }
+        top = (uint64_t) (c >> 64);
+      }
+      reduce256(r);
+    }
+
+  public:
+    Fp25519() : v{0, 0, 0, 0} { }
+    explicit Fp25519(uint64_t x) : v{x, 0, 0, 0} { }
+    explicit Fp25519(mpz_srcptr x) { set(x); }
+
+    // x may be anything, e.g., straight from the prover.
+    void set(mpz_srcptr x)
+    {
+      if (mpz_sgn(x) < 0 || mpz_size(x) > 4)
+      {
+        mpz_t tmp, prime;
+        mpz_init(tmp);
+        mpz_init_set_ui(prime, 1);
+        mpz_mul_2exp(prime, prime, 255);
+        mpz_sub_ui(prime, prime, 19);
+        mpz_mod(tmp, x, prime);
+        set(tmp);
+        mpz_clear(prime);
+        mpz_clear(tmp);
+        return;
+      }
+
+      for (int i = 0; i < 4; i++)
+        v[i] = (i < (int) mpz_size(x)) ? mpz_getlimbn(x, i) : 0;
+      reduce256(v);
+    }
+
+    void get(mpz_ptr rop) const
+    {
+      mpz_import(rop, 4, -1, sizeof(uint64_t), 0, 0, v);
+    }
+
+    bool isZero() const
+    {
+      return (v[0] | v[1] | v[2] | v[3]) == 0;
+    }
+
+    // the limbs themselves; for the vectorized kernels in chi_kernels.cpp,
+    // which also treat an array of these as an array of limbs.
+    const uint64_t* raw() const { return v; }
+
+    bool operator==(const Fp25519& o) const
+    {
+      return ((v[0] ^ o.v[0]) | (v[1] ^ o.v[1]) | (v[2] ^ o.v[2]) | (v[3] ^ o.v[3])) == 0;
+    }
+    bool operator!=(const Fp25519& o) const { return !(*this == o); }
+
+    Fp25519& operator+=(const Fp25519& o)
+    {
+      fp25519_u128 c = 0;
+      for (int i = 0; i < 4; i++)
+      {
+        c += (fp25519_u128) v[i] + o.v[i];
+        v[i] = (uint64_t) c;
+        c >>= 64;
+      }
+      freeze(v);
+      return *this;
+    }
+
+    Fp25519& operator-=(const Fp25519& o)
+    {
+      uint64_t borrow = 0;
+      for (int i = 0; i < 4; i++)
+      {
+        uint64_t d = v[i] - o.v[i];
+        uint64_t b = (v[i] < o.v[i]) | (d < borrow);
+        v[i] = d - borrow;
+        borrow = b;
+      }
+
+      // went negative: add p back (mod 2^256).
+      if (borrow)
+      {
+        const uint64_t p[4] = {P0, P1, P1, P3};
+        fp25519_u128 c = 0;
+        for (int i = 0; i < 4; i++)
+        {
+          c += (fp25519_u128) v[i] + p[i];
+          v[i] = (uint64_t) c;
+          c >>= 64;
+        }
+      }
+      return *this;
+    }
+
+    Fp25519& operator*=(const Fp25519& o)
+    {
+      uint64_t t[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+      for (int i = 0; i < 4; i++)
+      {
+        fp25519_u128 c = 0;
+        for (int j = 0; j < 4; j++)
+        {
+          c += (fp25519_u128) v[i] * o.v[j] + t[i + j];
+          t[i + j] = (uint64_t) c;
+          c >>= 64;
+        }
+        t[i + 4] = (uint64_t) c;
+      }
+      reduce512(v, t);
+      return *this;
+    }
+
+    Fp25519 operator+(const Fp25519& o) const { Fp25519 r(*this); return r += o; }
+    Fp25519 operator-(const Fp25519& o) const { Fp25519 r(*this); return r -= o; }
+    Fp25519 operator*(const Fp25519& o) const { Fp25519 r(*this); return r *= o; }
+    Fp25519 operator-() const { return Fp25519() - *this; }
+
+    // this / 2.
+    Fp25519 half() const
+    {
+      Fp25519 r(*this);
+      if (r.v[0] & 1)
+      {
+        // odd, so halve this + p instead, which is even (and < 2^256).
+        const uint64_t p[4] = {P0, P1, P1, P3};
+        fp25519_u128 c = 0;
+        for (int i = 0; i < 4; i++)
+        {
+          c += (fp25519_u128) r.v[i] + p[i];
+          r.v[i] = (uint64_t) c;
+          c >>= 64;
+        }
+      }
+      for (int i = 0; i < 3; i++)
+        r.v[i] = (r.v[i] >> 1) | (r.v[i + 1] << 63);
+      r.v[3] >>= 1;
+      return r;
+    }
+};
+
+typedef std::vector<Fp25519> Fp25519Vector;
+
+#endif  // CODE_PEPPER_COMMON_FP25519_H_
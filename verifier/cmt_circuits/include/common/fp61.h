@@ -0,0 +1,94 @@
+#ifndef CODE_PEPPER_COMMON_FP61_H_
+#define CODE_PEPPER_COMMON_FP61_H_
+
+#include <stdint.h>
+#include <gmp.h>
+#include <vector>
+
+// An element of GF(2^61 - 1) in a single uint64_t, kept fully reduced.
+// Same interface as Fp25519 (see fp25519.h), so code templated on the
+// field works with either.
+//
+// Reduction is Mersenne: 2^61 = 1 (mod p), so a product folds down with
+// a shift, a mask and an add.
+class Fp61
+{
+  private:
+    static constexpr uint64_t P = 0x1FFFFFFFFFFFFFFFULL;
+
+    uint64_t v;
+
+    // any x < 2^64 to x mod p.
+    static uint64_t reduce64(uint64_t x)
+    {
+      x = (x & P) + (x >> 61);
+      return (x >= P) ? x - P : x;
+    }
+
+  public:
+    Fp61() : v(0) { }
+    explicit Fp61(uint64_t x) : v(reduce64(x)) { }
+    explicit Fp61(mpz_srcptr x) { set(x); }
+
+    // x may be anything, e.g., straight from the prover.
+    void set(mpz_srcptr x)
+    {
+      if (mpz_sgn(x) >= 0 && mpz_size(x) <= 1)
+        v = reduce64(mpz_getlimbn(x, 0));
+      else
+        v = mpz_fdiv_ui(x, P);
+    }
+
+    void get(mpz_ptr rop) const
+    {
+      mpz_set_ui(rop, v);
+    }
+
+    bool isZero() const { return v == 0; }
+
+    // the residue itself, and back (r must already be < p); for the
+    // vectorized kernels in chi_kernels.cpp.
+    uint64_t raw() const { return v; }
+    static Fp61 fromRaw(uint64_t r) { Fp61 x; x.v = r; return x; }
+
+    bool operator==(const Fp61& o) const { return v == o.v; }
+    bool operator!=(const Fp61& o) const { return v != o.v; }
+
+    Fp61& operator+=(const Fp61& o)
+    {
+      v += o.v;
+      if (v >= P)
+        v -= P;
+      return *this;
+    }
+
+    Fp61& operator-=(const Fp61& o)
+    {
+      v = (v >= o.v) ? v - o.v : v + P - o.v;
+      return *this;
+    }
+
+    Fp61& operator*=(const Fp61& o)
+    {
+      __extension__ unsigned __int128 t = (unsigned __int128) v * o.v;
+      v = reduce64(((uint64_t) t & P) + (uint64_t) (t >> 61));
+      return *this;
+    }
+
+    Fp61 operator+(const Fp61& o) const { Fp61 r(*this); return r += o; }
+    Fp61 operator-(const Fp61& o) const { Fp61 r(*this); return r -= o; }
+    Fp61 operator*(const Fp61& o) const { Fp61 r(*this); return r *= o; }
+    Fp61 operator-() const { return Fp61() - *this; }
+
+    // this / 2.
+    Fp61 half() const
+    {
+      Fp61 r;
+      r.v = (v & 1) ? (v + P) >> 1 : v >> 1;
+      return r;
+    }
+};
+
+typedef std::vector<Fp61> Fp61Vector;
+
+#endif  // CODE_PEPPER_COMMON_FP61_H_
@@ -0,0 +1,139 @@
+#ifndef CODE_PEPPER_COMMON_PARALLEL_H_
+#define CODE_PEPPER_COMMON_PARALLEL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Run fn(begin, end, tid) over [0, n) split into (at most) nthreads
+ * contiguous chunks of at least minChunk items, one thread per chunk.
+ * Returns once every chunk is done, so a call is also a barrier.
+ */
+template<typename Fn> void
+parallelFor(int nthreads, int n, Fn fn, int minChunk = 1)
+{
+  int nchunks = std::min(nthreads, n / std::max(minChunk, 1));
+  if (nchunks <= 1)
+  {
+    fn(0, n, 0);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(nchunks);
+  for (int t = 0; t < nchunks; t++)
+  {
+    int begin = (int) (((long) n * t) / nchunks);
+    int end = (int) (((long) n * (t + 1)) / nchunks);
+    workers.push_back(std::thread(fn, begin, end, t));
+  }
+
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+}
+
+/*
+ * parallelFor() on a fixed set of nthreads - 1 worker threads (the caller
+ * takes the first chunk), started once and reused, so a loop that runs
+ * many times (a layer of the circuit, a round of the sumcheck) doesn't pay
+ * for starting threads each time. Chunks are as in parallelFor(), and a
+ * call returns once every chunk is done. One caller at a time.
+ */
+class ThreadPool
+{
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::condition_variable start;
+  std::condition_variable done;
+  std::function<void(int, int, int)> job;
+  int n;
+  int nchunks;
+  unsigned generation;
+  int pending;
+  bool stopping;
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  static int chunkBegin(int n, int nchunks, int t)
+  {
+    return (int) (((long) n * t) / nchunks);
+  }
+
+  void work(int t)
+  {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> l(lock);
+    while (1)
+    {
+      start.wait(l, [&]() { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+
+      if (t < nchunks)
+      {
+        int len = n, chunks = nchunks;
+        l.unlock();
+        job(chunkBegin(len, chunks, t), chunkBegin(len, chunks, t + 1), t);
+        l.lock();
+      }
+      if (--pending == 0)
+        done.notify_one();
+    }
+  }
+
+  public:
+  explicit ThreadPool(int nthreads)
+    : n(0), nchunks(0), generation(0), pending(0), stopping(false)
+  {
+    for (int t = 1; t < nthreads; t++)
+      workers.push_back(std::thread(&ThreadPool::work, this, t));
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> l(lock);
+      stopping = true;
+    }
+    start.notify_all();
+    for (size_t t = 0; t < workers.size(); t++)
+      workers[t].join();
+  }
+
+  int size() const { return workers.size() + 1; }
+
+  template<typename Fn> void
+  parallelFor(int len, Fn fn, int minChunk = 1)
+  {
+    int chunks = std::min(size(), len / std::max(minChunk, 1));
+    if (chunks <= 1)
+    {
+      fn(0, len, 0);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> l(lock);
+      job = fn;
+      n = len;
+      nchunks = chunks;
+      pending = workers.size();
+      generation++;
+    }
+    start.notify_all();
+
+    fn(0, chunkBegin(len, chunks, 1), 0);
+
+    std::unique_lock<std::mutex> l(lock);
+    done.wait(l, [&]() { return pending == 0; });
+    job = nullptr;
+  }
+};
+
+#endif  // CODE_PEPPER_COMMON_PARALLEL_H_
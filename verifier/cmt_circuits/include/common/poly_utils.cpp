@@ -11,9 +11,63 @@ void computeChiAll(MPZVector& rop, const MPZVector& r, const mpz_t prime)
   computeChiAll(rop, rop.size(), r, 0, prime);
 }
 
+// The primes with a fixed-width element type (fp61.h, fp25519.h), whose
+// chi tables are built there instead, with the vectorized
+// chiDoubleStep()s, and converted at either end.
+enum NativePrime { NATIVE_NONE, NATIVE_P61, NATIVE_P25519 };
+
+static NativePrime
+nativePrime(const mpz_t prime)
+{
+  static const mpz_class p61 = (mpz_class(1) << 61) - 1;
+  static const mpz_class p25519 = (mpz_class(1) << 255) - 19;
+
+  if (mpz_cmp(prime, p61.get_mpz_t()) == 0)
+    return NATIVE_P61;
+  if (mpz_cmp(prime, p25519.get_mpz_t()) == 0)
+    return NATIVE_P25519;
+  return NATIVE_NONE;
+}
+
+template<typename F> static void
+extendChiNative(MPZVector& rop, size_t n, const MPZVector& r, size_t startAt, size_t fromLog)
+{
+  const size_t logn = log2i(n);
+  assert(r.size() >= startAt + logn);
+
+  vector<F> tab(n);
+  vector<F> fr(startAt + logn);
+  for (size_t i = fromLog; i < logn; i++)
+    fr[startAt + i].set(r[startAt + i]);
+  for (size_t i = 0; fromLog > 0 && i < std::min(size_t(1) << fromLog, n); i++)
+    tab[i].set(rop[i]);
+
+  extendChiAll(tab, n, fr, startAt, fromLog);
+  for (size_t i = 0; i < n; i++)
+    tab[i].get(rop[i]);
+}
+
 void computeChiAll(MPZVector& rop, size_t n, const MPZVector& r, size_t startAt, const mpz_t prime)
 {
-  computeMLEAll(rop, n, r, startAt, prime, one_sub, mpz_set);
+  extendChiAll(rop, n, r, startAt, 0, prime);
+}
+
+// Finish a chi table whose first 2^fromLog entries already hold the chi
+// table over r[startAt .. startAt + fromLog), e.g., copied from another
+// table whose point shares those coordinates.
+void extendChiAll(MPZVector& rop, size_t n, const MPZVector& r, size_t startAt, size_t fromLog, const mpz_t prime)
+{
+  switch (nativePrime(prime))
+  {
+    case NATIVE_P61:
+      extendChiNative<Fp61>(rop, n, r, startAt, fromLog);
+      break;
+    case NATIVE_P25519:
+      extendChiNative<Fp25519>(rop, n, r, startAt, fromLog);
+      break;
+    default:
+      computeMLEAll(rop, n, r, startAt, prime, one_sub, mpz_set, fromLog);
+  }
 }
 
 void
@@ -6,11 +6,15 @@
 #include <gmpxx.h>
 #include <stdint.h>
 
+#include <vector>
+
+#include "chi_kernels.h"
 #include "math.h"
 #include "mpnvector.h"
 
 void computeChiAll(MPZVector& rop, const MPZVector& r, const mpz_t prime);
 void computeChiAll(MPZVector& rop, size_t n, const MPZVector& r, size_t startAt, const mpz_t prime);
+void extendChiAll(MPZVector& rop, size_t n, const MPZVector& r, size_t startAt, size_t fromLog, const mpz_t prime);
 
 void mul_chi(mpz_t rop, const uint64_t v, const mpz_t* r, int n, const mpz_t prime);
 void chi(mpz_t rop, const uint64_t v, const mpz_t* r, int n, const mpz_t prime);
@@ -29,10 +33,11 @@ computeMLEAll(
     MPZVector& rop, size_t n,
     const MPZVector& r, size_t startAt,
     const mpz_t prime,
-    Fn0 fn0, Fn1 fn1)
+    Fn0 fn0, Fn1 fn1, size_t fromLog = 0)
 {
   size_t logn = log2i(n);
   assert(r.size() >= logn);
+  assert(fromLog <= logn);
 
   mpz_class tmp;
 
@@ -41,8 +46,11 @@ computeMLEAll(
   //   1 :  fn0(r1)            fn1(r1)
   //   2 :  fn0(r2) fn0(r1)    fn0(r2) fn1(r1)   fn1(r2) fn0(r1)   fn1(r2) fn1(r1)
   //   etc.
-  mpz_set_ui(rop[0], 1);
-  for (size_t logi = 0; logi < logn; logi++)
+  // If fromLog > 0, rop[0 .. 2^fromLog) already holds the result of the
+  // first fromLog steps.
+  if (fromLog == 0)
+    mpz_set_ui(rop[0], 1);
+  for (size_t logi = fromLog; logi < logn; logi++)
   {
     size_t base = 1 << logi;
 
@@ -69,4 +77,94 @@ computeMLEAll(
 }
 
 
+/*
+ * The same, directly on fixed-width field elements: F is Fp25519 or Fp61
+ * (fp25519.h, fp61.h), or anything else with their interface.
+ */
+template<typename F> void
+toField(std::vector<F>& rop, const MPZVector& op)
+{
+  rop.resize(op.size());
+  for (size_t i = 0; i < op.size(); i++)
+    rop[i].set(op[i]);
+}
+
+// One level of a chi table; see chi_kernels.h, which also has
+// vectorized overloads for Fp61 and Fp25519. Where both halves are
+// written, x (1 - r) = x - x r saves a multiply.
+template<typename F> void
+chiDoubleStep(F* tab, size_t base, size_t nhi, const F& r)
+{
+  const F one_sub_r = F(1) - r;
+
+  for (size_t i = 0; i < nhi; i++)
+  {
+    tab[base + i] = tab[i] * r;
+    tab[i] -= tab[base + i];
+  }
+  for (size_t i = nhi; i < base; i++)
+    tab[i] *= one_sub_r;
+}
+
+// As computeMLEAll(), with fn0 = 1 - r and fn1 = r.
+template<typename F> void
+extendChiAll(std::vector<F>& rop, size_t n, const std::vector<F>& r, size_t startAt, size_t fromLog)
+{
+  size_t logn = log2i(n);
+  assert(r.size() >= logn);
+  assert(fromLog <= logn);
+
+  if (fromLog == 0)
+    rop[0] = F(1);
+  for (size_t logi = fromLog; logi < logn; logi++)
+  {
+    const size_t base = 1 << logi;
+    chiDoubleStep(&rop[0], base, std::min(base, n - base), r[logi + startAt]);
+  }
+}
+
+template<typename F> void
+computeChiAll(std::vector<F>& rop, size_t n, const std::vector<F>& r, size_t startAt)
+{
+  extendChiAll(rop, n, r, startAt, 0);
+}
+
+template<typename F> void
+computeChiAll(std::vector<F>& rop, const std::vector<F>& r)
+{
+  computeChiAll(rop, rop.size(), r, 0);
+}
+
+template<typename F> void
+bary_precompute_weights3(std::vector<F>& weights, const F& r)
+{
+  weights.resize(3);
+
+  F tmp[3];
+  for (int i = 0; i < 3; i++)
+    tmp[i] = r - F(i);
+
+  // weights = (r-1)(r-2)/2, -r(r-2), r(r-1)/2
+  weights[0] = (tmp[1] * tmp[2]).half();
+  weights[1] = -(tmp[2] * tmp[0]);
+  weights[2] = (tmp[0] * tmp[1]).half();
+}
+
+template<typename F> void
+bary_extrap(std::vector<F>& rop, const std::vector<F>& vec, const std::vector<F>& weights)
+{
+  assert(vec.size() == rop.size() * weights.size());
+
+  for (size_t b = 0; b < rop.size(); b++)
+  {
+    const F *y = &vec[b * weights.size()];
+
+    F acc;
+    for (size_t i = 0; i < weights.size(); i++)
+      acc += weights[i] * y[i];
+    rop[b] = acc;
+  }
+}
+
+
 #endif
@@ -9,6 +9,8 @@ Prng::Prng(int type) {
 Prng::~Prng() {
 
   delete []random_state;
+  // undo aligned_malloc()
+  free(((void**)chacha)[-1]);
 }
 
 Prng::Prng(int type, u8 *key, u8 *iv) {
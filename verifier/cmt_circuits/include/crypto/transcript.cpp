@@ -0,0 +1,113 @@
+#include <crypto/transcript.h>
+
+#include <string.h>
+#include <vector>
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)                    \
+  a += b; d ^= a; d = ROTL32(d, 16);                \
+  c += d; b ^= c; b = ROTL32(b, 12);                \
+  a += b; d ^= a; d = ROTL32(d, 8);                 \
+  c += d; b ^= c; b = ROTL32(b, 7);
+
+Transcript::Transcript(const char *label) {
+  memset(state, 0, sizeof(state));
+
+  // the capacity starts out as ChaCha's constants, so that an all-zero
+  // rate doesn't meet an all-zero (fixed) point of the permutation.
+  state[8] = 0x61707865;
+  state[9] = 0x3320646e;
+  state[10] = 0x79622d32;
+  state[11] = 0x6b206574;
+
+  pos = 0;
+  squeezing = false;
+
+  size_t len = strlen(label);
+  absorb((uint32_t) len);
+  absorb(label, len);
+}
+
+void Transcript::permute() {
+  uint32_t *x = state;
+  for (int i = 0; i < 20; i += 2) {
+    QUARTERROUND(x[0], x[4], x[8], x[12])
+    QUARTERROUND(x[1], x[5], x[9], x[13])
+    QUARTERROUND(x[2], x[6], x[10], x[14])
+    QUARTERROUND(x[3], x[7], x[11], x[15])
+    QUARTERROUND(x[0], x[5], x[10], x[15])
+    QUARTERROUND(x[1], x[6], x[11], x[12])
+    QUARTERROUND(x[2], x[7], x[8], x[13])
+    QUARTERROUND(x[3], x[4], x[9], x[14])
+  }
+}
+
+// the rate is the first TRANSCRIPT_RATE bytes of the state, little-endian.
+static inline void xorByte(uint32_t *state, int i, uint8_t b) {
+  state[i / 4] ^= (uint32_t) b << (8 * (i % 4));
+}
+
+static inline uint8_t getByte(const uint32_t *state, int i) {
+  return (state[i / 4] >> (8 * (i % 4))) & 0xff;
+}
+
+void Transcript::absorb(const void *data, size_t len) {
+  if (squeezing) {
+    permute();
+    pos = 0;
+    squeezing = false;
+  }
+
+  const uint8_t *bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < len; i++) {
+    if (pos == TRANSCRIPT_RATE) {
+      permute();
+      pos = 0;
+    }
+    xorByte(state, pos++, bytes[i]);
+  }
+}
+
+void Transcript::absorb(uint32_t val) {
+  uint8_t bytes[4];
+  for (int i = 0; i < 4; i++)
+    bytes[i] = (val >> (8 * i)) & 0xff;
+  absorb(bytes, sizeof(bytes));
+}
+
+void Transcript::squeeze(uint8_t *out, size_t len) {
+  if (!squeezing) {
+    // pad10*1, so that absorbing a message and absorbing it with zeros
+    // on the end differ.
+    if (pos == TRANSCRIPT_RATE) {
+      permute();
+      pos = 0;
+    }
+    xorByte(state, pos, 0x01);
+    xorByte(state, TRANSCRIPT_RATE - 1, 0x80);
+    permute();
+    pos = 0;
+    squeezing = true;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    if (pos == TRANSCRIPT_RATE) {
+      permute();
+      pos = 0;
+    }
+    out[i] = getByte(state, pos++);
+  }
+}
+
+void Transcript::challenge(mpz_t out, const mpz_t prime) {
+  int nbits = mpz_sizeinbase(prime, 2);
+  int nbytes = (nbits + 7) / 8;
+  std::vector<uint8_t> buf(nbytes);
+
+  do {
+    squeeze(&buf[0], nbytes);
+    buf[nbytes - 1] &= 0xff >> (8 * nbytes - nbits);
+    mpz_import(out, nbytes, -1, 1, 0, 0, &buf[0]);
+  } while (mpz_cmp(out, prime) >= 0);
+}
@@ -0,0 +1,36 @@
+#ifndef CODE_PEPPER_CRYPTO_TRANSCRIPT_H_
+#define CODE_PEPPER_CRYPTO_TRANSCRIPT_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+
+// bytes absorbed or squeezed per permutation
+#define TRANSCRIPT_RATE 32
+
+// A Fiat-Shamir transcript: a sponge over the ChaCha permutation (20
+// rounds of the block function, without the final feed-forward), with a
+// 256-bit rate and a 256-bit capacity. Both sides absorb the same
+// messages in the same order and squeeze the same challenges; a copy
+// carries on from where the original was, so a common prefix (e.g. the
+// circuit) need only be absorbed once.
+class Transcript {
+  private:
+    uint32_t state[16];
+    int pos; // bytes of the rate used since the last permutation
+    bool squeezing;
+
+    void permute();
+
+  public:
+    // label separates transcripts for different purposes.
+    explicit Transcript(const char *label);
+
+    void absorb(const void *data, size_t len);
+    void absorb(uint32_t val); // little-endian
+
+    // a uniform element of [0, prime), by rejection.
+    void challenge(mpz_t out, const mpz_t prime);
+    // len raw bytes (e.g. for a digest).
+    void squeeze(uint8_t *out, size_t len);
+};
+#endif  // CODE_PEPPER_CRYPTO_TRANSCRIPT_H_
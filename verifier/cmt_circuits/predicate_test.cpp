@@ -0,0 +1,295 @@
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <gmp.h>
+#include <gmpxx.h>
+#include "circuit/circuit_layer.h"
+#include <common/fp25519.h>
+#include <common/fp61.h>
+#include <common/math.h>
+#include <common/poly_utils.h>
+
+using namespace std;
+
+// Checks the mpz and the Fp61/Fp25519 CircuitLayer::computeWirePredicates()
+// against the plain sum of chi_g(p) chi_in1(w1) chi_in2(w2) over every gate
+// of the layer (all copies included), at random points. The layers cover
+// the bit-regular wirings (identity, aligned offset, butterfly, reduction
+// tree, broadcast) and one that only looks regular, groups of
+// non-power-of-two size, replicated layers with a non-power-of-two number
+// of copies, and regular groups on both sides of BIT_WIRING_MIN_GATES next
+// to irregular ones that need the chi tables. Exits nonzero if any of them
+// differs.
+
+static gmp_randstate_t rnd;
+
+// The first copy of a layer: its gates' wiring, and the mux index of each
+// MUX gate.
+struct LayerSpec
+{
+  const char* name;
+  int copySize;
+  int inCopySize; // size of one copy of the next layer
+  vector<GateWiring> wiring;
+  map<int, int> mux;
+
+  LayerSpec(const char* n, int size, int inSize)
+    : name(n), copySize(size), inCopySize(inSize), wiring(size) { }
+
+  void set(int g, GateWiring::GateType t, int in1, int in2) { wiring[g].setWiring(t, in1, in2); }
+};
+
+static const char* predNames[] = { "add", "mul", "sub", "muxl", "muxr" };
+
+// identity: gate g adds input g to itself.
+static LayerSpec
+identity()
+{
+  LayerSpec s("identity", 64, 64);
+  for (int g = 0; g < 64; g++)
+    s.set(g, GateWiring::ADD, g, g);
+  return s;
+}
+
+// aligned offset: gate g multiplies inputs g and g + 64.
+static LayerSpec
+offset()
+{
+  LayerSpec s("aligned offset", 64, 128);
+  for (int g = 0; g < 64; g++)
+    s.set(g, GateWiring::MUL, g, g + 64);
+  return s;
+}
+
+// one FFT-style butterfly on bit 3: the gates with it clear add the pair,
+// the others subtract it.
+static LayerSpec
+butterfly()
+{
+  LayerSpec s("butterfly", 64, 64);
+  for (int g = 0; g < 64; g++)
+  {
+    if (g & 8)
+      s.set(g, GateWiring::SUB, g & ~8, g);
+    else
+      s.set(g, GateWiring::ADD, g, g | 8);
+  }
+  return s;
+}
+
+// pairwise reduction tree: gate g adds inputs 2g and 2g + 1.
+static LayerSpec
+reduction()
+{
+  LayerSpec s("reduction tree", 32, 64);
+  for (int g = 0; g < 32; g++)
+    s.set(g, GateWiring::ADD, 2 * g, 2 * g + 1);
+  return s;
+}
+
+// broadcast: input 64 times each of inputs 0..7 in turn.
+static LayerSpec
+broadcast()
+{
+  LayerSpec s("broadcast", 64, 128);
+  for (int g = 0; g < 64; g++)
+    s.set(g, GateWiring::MUL, g % 8, 64);
+  return s;
+}
+
+// reversal: in2's bits are the complement of the gate's, which the closed
+// form can't express, so the group must be left to the chi tables.
+static LayerSpec
+reversal()
+{
+  LayerSpec s("reversal", 64, 64);
+  for (int g = 0; g < 64; g++)
+    s.set(g, GateWiring::ADD, g, 63 - g);
+  return s;
+}
+
+// regular groups of 24 (not a power of two), 8 and 32 gates.
+static LayerSpec
+oddSizes()
+{
+  LayerSpec s("non-power-of-two group", 64, 128);
+  for (int g = 0; g < 24; g++)
+    s.set(g, GateWiring::ADD, g, g + 64);
+  for (int g = 24; g < 32; g++)
+    s.set(g, GateWiring::SUB, g, g);
+  for (int g = 32; g < 64; g++)
+    s.set(g, GateWiring::MUL, 2 * (g - 32), 2 * (g - 32) + 1);
+  return s;
+}
+
+// a regular ADD group of 40 gates (>= BIT_WIRING_MIN_GATES, so closed
+// form), a regular MUL group of 16 (summed from the tables), irregular
+// SUB gates and mux gates.
+static LayerSpec
+mixed()
+{
+  LayerSpec s("mixed", 128, 128);
+  for (int g = 0; g < 40; g++)
+    s.set(g, GateWiring::ADD, g, g + 64);
+  for (int g = 64; g < 80; g++)
+    s.set(g, GateWiring::MUL, 2 * (g - 64), 2 * (g - 64) + 1);
+  for (int g = 40; g < 64; g++)
+    s.set(g, GateWiring::SUB, gmp_urandomm_ui(rnd, 128), gmp_urandomm_ui(rnd, 128));
+  for (int g = 80; g < 120; g++)
+    s.set(g, GateWiring::SUB, gmp_urandomm_ui(rnd, 128), gmp_urandomm_ui(rnd, 128));
+  for (int g = 120; g < 128; g++)
+  {
+    s.set(g, GateWiring::MUX, gmp_urandomm_ui(rnd, 128), gmp_urandomm_ui(rnd, 128));
+    s.mux[g] = g % 3;
+  }
+  return s;
+}
+
+// copies of spec side by side, as PWSCircuitParser::replicate() lays them
+// out.
+static void
+buildLayer(CircuitLayer& layer, const LayerSpec& spec, int copies)
+{
+  for (int k = 0; k < copies; k++)
+  {
+    for (int g = 0; g < spec.copySize; g++)
+    {
+      const GateWiring& w = spec.wiring[g];
+      const int at = k * spec.copySize + g;
+      layer[at].setWiring(w.type, k * spec.inCopySize + w.in1, k * spec.inCopySize + w.in2);
+      map<int, int>::const_iterator m = spec.mux.find(g);
+      if (m != spec.mux.end())
+        layer.muxGates[at] = m->second;
+    }
+  }
+  layer.setCopies(copies);
+  layer.groupGates();
+}
+
+// what computeWirePredicates() did before the copies and the regular
+// groups were factored out.
+static void
+bruteForce(mpz_class preds[5], const CircuitLayer& layer, const vector<bool>& muxBits,
+           const MPZVector& rand, int inputLayerSize, const mpz_t prime)
+{
+  const int mi = layer.logSize();
+  const int mip1 = log2i(inputLayerSize);
+  MPZVector pChi(layer.size()), w1Chi(inputLayerSize), w2Chi(inputLayerSize);
+  computeChiAll(pChi, layer.size(), rand, 0, prime);
+  computeChiAll(w1Chi, inputLayerSize, rand, mi, prime);
+  computeChiAll(w2Chi, inputLayerSize, rand, mi + mip1, prime);
+
+  for (int k = 0; k < 5; k++)
+    preds[k] = 0;
+  for (int i = 0; i < layer.size(); i++)
+  {
+    const GateWiring& w = layer[i];
+    int k;
+    if (w.shouldBeTreatedAs(GateWiring::ADD))
+      k = 0;
+    else if (w.shouldBeTreatedAs(GateWiring::MUL))
+      k = 1;
+    else if (w.shouldBeTreatedAs(GateWiring::SUB))
+      k = 2;
+    else
+      k = muxBits[layer.getMuxIdx(i)] ? 4 : 3;
+    preds[k] += mpz_class(pChi[i]) * mpz_class(w1Chi[w.in1]) * mpz_class(w2Chi[w.in2]);
+  }
+  for (int k = 0; k < 5; k++)
+    mpz_mod(preds[k].get_mpz_t(), preds[k].get_mpz_t(), prime);
+}
+
+template<typename F> static bool
+checkLayer(const char* field, const mpz_class& p, const LayerSpec& spec, int copies, int trials)
+{
+  CircuitLayer layer(NULL, 0, spec.copySize * copies);
+  buildLayer(layer, spec, copies);
+  const int inputLayerSize = spec.inCopySize * copies;
+  const int mi = layer.logSize();
+  const int mip1 = log2i(inputLayerSize);
+  const int n = mi + 2 * mip1;
+
+  vector<bool> muxBits(3);
+  MPZVector rand(n);
+  vector<F> frand(n);
+  bool ok = true;
+  for (int t = 0; t < trials && ok; t++)
+  {
+    for (size_t j = 0; j < muxBits.size(); j++)
+      muxBits[j] = gmp_urandomm_ui(rnd, 2);
+    for (int j = 0; j < n; j++)
+      mpz_urandomm(rand[j], rnd, p.get_mpz_t());
+    // every other trial, w1 and w2 agree on a prefix (whose chi table
+    // computeWirePredicates() then shares).
+    if (t % 2)
+    {
+      const int shared = gmp_urandomm_ui(rnd, mip1 + 1);
+      for (int j = 0; j < shared; j++)
+        mpz_set(rand[mi + mip1 + j], rand[mi + j]);
+    }
+    for (int j = 0; j < n; j++)
+      frand[j] = F(rand[j]);
+
+    mpz_class want[5];
+    bruteForce(want, layer, muxBits, rand, inputLayerSize, p.get_mpz_t());
+
+    mpz_t zpreds[5];
+    for (int k = 0; k < 5; k++)
+      mpz_init(zpreds[k]);
+    layer.computeWirePredicates(zpreds[0], zpreds[1], zpreds[2], zpreds[3], zpreds[4],
+                                muxBits, rand, inputLayerSize, p.get_mpz_t());
+
+    F fpreds[5];
+    layer.computeWirePredicates(fpreds[0], fpreds[1], fpreds[2], fpreds[3], fpreds[4],
+                                muxBits, frand, inputLayerSize);
+
+    for (int k = 0; k < 5; k++)
+    {
+      mpz_class got;
+      fpreds[k].get(got.get_mpz_t());
+      if (mpz_cmp(zpreds[k], want[k].get_mpz_t()) != 0 || got != want[k])
+      {
+        cout << field << ": " << spec.name << " x " << copies << ": " << predNames[k]
+             << " predicate differs from the chi table sum (trial " << t << ")" << endl;
+        ok = false;
+      }
+    }
+    for (int k = 0; k < 5; k++)
+      mpz_clear(zpreds[k]);
+  }
+  return ok;
+}
+
+template<typename F> static bool
+checkField(const char* field, const mpz_class& p, int trials)
+{
+  const LayerSpec specs[] = { identity(), offset(), butterfly(), reduction(), broadcast(), reversal(),
+                              oddSizes(), mixed() };
+  const int copies[] = { 1, 2, 3, 5 };
+
+  bool ok = true;
+  for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++)
+  {
+    for (size_t c = 0; c < sizeof(copies) / sizeof(copies[0]); c++)
+      ok = checkLayer<F>(field, p, specs[i], copies[c], trials) && ok;
+  }
+  cout << field << ": wiring predicates " << (ok ? "ok" : "FAILED") << endl;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+    gmp_randinit_default(rnd);
+    gmp_randseed_ui(rnd, (argc > 1) ? strtoul(argv[1], NULL, 0) : 1);
+    const int trials = (argc > 2) ? atoi(argv[2]) : 20;
+
+    const mpz_class p61 = (mpz_class(1) << 61) - 1;
+    const mpz_class p25519 = (mpz_class(1) << 255) - 19;
+
+    bool ok = checkField<Fp61>("Fp61", p61, trials);
+    ok = checkField<Fp25519>("Fp25519", p25519, trials) && ok;
+
+    gmp_randclear(rnd);
+    return ok ? 0 : 1;
+}
@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <iostream>
 
 #include "circuit/pws_circuit_parser.h"
@@ -22,6 +23,11 @@ int main(int argc, char **argv) {
 
         cout << "Constructing circuit" << endl;
         c.construct();
+        // optional: evaluate in the field-only mode, with this many threads
+        if (argc > 2) {
+            c.setFieldEvaluation(true);
+            c.setEvalThreads(atoi(argv[2]));
+        }
         MPQVector vec(c.getInputSize());
         for (size_t i = 0; i < vec.size(); i++)
             mpq_set_ui(vec[i], i, 1);
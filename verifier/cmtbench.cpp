@@ -0,0 +1,332 @@
+// cmtbench.cpp
+// benchmark harness for the verifier: times each of V's kernels, per layer
+// where it varies by layer, with warm-up and repeated samples.
+//
+// The verifier itself runs every check exactly once; this is where to go
+// for numbers stable enough to compare.
+
+#include "cmtbench.h"
+
+#include <circuit/pws_circuit_parser.h>
+#include <circuit/pws_circuit.h>
+#include <common/poly_utils.h>
+#include <crypto/prng.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <time.h>
+
+using namespace std;
+
+//results of the inlined native-field kernels go here, so that they can't
+//be optimized away.
+static volatile bool benchSink;
+
+static double nowNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * (double) BILLION + t.tv_nsec;
+}
+
+//run fn in batches of itersPerSample, sized so that one batch takes at
+//least BENCH_SAMPLE_NS, and report per-iteration statistics over samples
+//batches.
+static BenchResult runBench(const string& name, int samples, const function<void()>& fn) {
+    //warm-up, which also calibrates the batch size.
+    long iters = 0;
+    double start = nowNs(), elapsed;
+    do {
+        fn();
+        iters++;
+        elapsed = nowNs() - start;
+    } while (elapsed < BENCH_WARMUP_NS);
+
+    long itersPerSample = max(1L, (long) ceil(BENCH_SAMPLE_NS / (elapsed / iters)));
+
+    vector<double> t(samples);
+    for (int s = 0; s < samples; s++) {
+        double t1 = nowNs();
+        for (long i = 0; i < itersPerSample; i++)
+            fn();
+        t[s] = (nowNs() - t1) / itersPerSample;
+    }
+
+    BenchResult r;
+    r.name = name;
+    r.itersPerSample = itersPerSample;
+    r.samples = samples;
+
+    sort(t.begin(), t.end());
+    r.min = t[0];
+    r.median = (samples % 2) ? t[samples / 2] : (t[samples / 2 - 1] + t[samples / 2]) / 2;
+
+    double sum = 0, sq = 0;
+    for (int s = 0; s < samples; s++)
+        sum += t[s];
+    r.mean = sum / samples;
+    for (int s = 0; s < samples; s++)
+        sq += (t[s] - r.mean) * (t[s] - r.mean);
+    r.stddev = (samples > 1) ? sqrt(sq / (samples - 1)) : 0;
+
+    return r;
+}
+
+static string fmtTime(double ns) {
+    ostringstream s;
+    s << fixed << setprecision(ns < 10 ? 2 : 1);
+    if (ns < 1e3)
+        s << ns << " ns";
+    else if (ns < 1e6)
+        s << ns / 1e3 << " us";
+    else
+        s << ns / 1e6 << " ms";
+    return s.str();
+}
+
+static void printHeader() {
+    cout << left << setw(32) << "Benchmark" << right
+         << setw(14) << "Mean" << setw(14) << "Median" << setw(14) << "StdDev"
+         << setw(14) << "Min" << setw(12) << "Iterations" << endl;
+    cout << string(32 + 4 * 14 + 12, '-') << endl;
+}
+
+static void printResult(const BenchResult& r) {
+    cout << left << setw(32) << r.name << right
+         << setw(14) << fmtTime(r.mean) << setw(14) << fmtTime(r.median)
+         << setw(14) << fmtTime(r.stddev) << setw(14) << fmtTime(r.min)
+         << setw(12) << r.itersPerSample * r.samples << endl;
+}
+
+//stand-ins for the prover's messages: their values don't change the cost
+//of the checks.
+static void randomVector(MPZVector& v, Prng& prng, const mpz_t prime) {
+    for (size_t i = 0; i < v.size(); i++)
+        prng.get_random(v[i], prime);
+}
+
+int main(int argc, char* argv[]) {
+    int copies = 1;
+    if (argc > 2 && !strcmp(argv[1], "-r")) {
+        copies = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 2) {
+        cout << "usage: " << argv[0] << " [-r copies] <pwsfile> [filter] [samples]" << endl;
+        cout << "    runs the benchmarks whose names contain filter (default: all)" << endl;
+        cout << "    -r: bench copies data-parallel copies of the worksheet" << endl;
+        exit(1);
+    }
+    const string filter = (argc > 2) ? argv[2] : "";
+    int samples = (argc > 3) ? atoi(argv[3]) : BENCH_DEFAULT_SAMPLES;
+    if (samples < 1)
+        samples = 1;
+
+    mpz_t prime;
+    mpz_init_set_ui(prime, 1);
+    mpz_mul_2exp(prime, prime, PRIMEBITS);
+    mpz_sub_ui(prime, prime, PRIMEDELTA);
+
+    PWSCircuitParser parser(prime);
+    PWSCircuit c(parser);
+    parser.parse(argv[1]);
+    parser.replicate(copies);
+    c.construct();
+    parser.printCircuitStats();
+
+    int numMuxBits = parser.largestMuxBitIndex + 1;
+    vector<bool> muxBits(numMuxBits);
+    for (int i = 0; i < numMuxBits; i++) {
+        muxBits[i] = i % 2;
+    }
+
+    //one instance's worth of V's randomness to run the kernels on.
+    uint8_t masterKey[MASTER_KEY_BYTES];
+    VerifierPrecomputation::newMasterKey(masterKey);
+    VerifierPrecomputation p;
+    p.precomputeInstance(&c, muxBits, masterKey, 0);
+
+    Prng prng(PNG_CHACHA);
+    const int depth = p.depth;
+
+#ifdef USE_NATIVE_FIELD
+    cout << "field: native, " << PRIMEBITS << " bits; chi kernel: " << chiKernelName<FieldElt>() << endl;
+#else
+    cout << "field: mpz, " << PRIMEBITS << " bits" << endl;
+#endif
+    cout << samples << " samples per benchmark" << endl << endl;
+
+    vector<pair<string, function<void()> > > benches;
+
+    //all of V's precomputation for one instance.
+    benches.push_back(make_pair(string("precompute"), function<void()>([&]() {
+        VerifierPrecomputation q;
+        q.precomputeInstance(&c, muxBits, masterKey, 1);
+        q.deinit();
+    })));
+
+    //the wiring predicates, layer by layer; computeAddMul() does these.
+    for (int i = 0; i < depth - 1; i++) {
+        int inputLayerSize = c[i + 1].size();
+        int logIn = c[i + 1].logSize();
+        int logOut = c[i].logSize();
+
+        MPZVector rand(logOut + 2 * logIn);
+        for (int j = 0; j < logOut; j++)
+            mpz_set(rand[j], p.qi[i][j]);
+        for (int j = 0; j < 2 * logIn; j++)
+            mpz_set(rand[logOut + j], p.ri[i][j]);
+
+        ostringstream name;
+        name << "wirepred/L" << i;
+#ifdef USE_NATIVE_FIELD
+        FieldEltVector fieldRand;
+        toField(fieldRand, rand);
+        benches.push_back(make_pair(name.str(), function<void()>([&c, &muxBits, fieldRand, inputLayerSize, i]() {
+            FieldElt add, mul, sub, muxl, muxr;
+            c[i].computeWirePredicates(add, mul, sub, muxl, muxr, muxBits, fieldRand, inputLayerSize);
+        })));
+#else
+        benches.push_back(make_pair(name.str(), function<void()>([&c, &muxBits, rand, inputLayerSize, i]() {
+            MPZVector out(5);
+            c[i].computeWirePredicates(out[0], out[1], out[2], out[3], out[4], muxBits, rand, inputLayerSize, c.prime);
+        })));
+#endif
+    }
+
+    //m.l. ext. of the outputs at q0 and of the inputs at q_d, as in
+    //checkOutputs() and doFinalCheck(): chi table, then a dot product.
+    const int mlextLayers[2] = { 0, depth - 1 };
+    const char* mlextNames[2] = { "mlext_output", "mlext_input" };
+    for (int k = 0; k < 2; k++) {
+        int layer = mlextLayers[k];
+        MPZVector vals(p.layerSizes[layer]);
+        randomVector(vals, prng, prime);
+        const MPZVector& point = p.qi[layer];
+#ifdef USE_NATIVE_FIELD
+        FieldEltVector fieldVals, fieldPoint;
+        toField(fieldVals, vals);
+        toField(fieldPoint, point);
+        benches.push_back(make_pair(string(mlextNames[k]), function<void()>([fieldVals, fieldPoint]() {
+            FieldEltVector chis(fieldVals.size());
+            computeChiAll(chis, fieldPoint);
+            FieldElt a;
+            for (size_t i = 0; i < chis.size(); i++)
+                a += fieldVals[i] * chis[i];
+            benchSink = a.isZero();
+        })));
+#else
+        benches.push_back(make_pair(string(mlextNames[k]), function<void()>([vals, &point, &prime]() {
+            MPZVector chis(vals.size());
+            computeChiAll(chis, point, prime);
+            mpz_t a;
+            mpz_init_set_ui(a, 0);
+            for (size_t i = 0; i < chis.size(); i++)
+                mpz_addmul(a, vals[i], chis[i]);
+            mpz_mod(a, a, prime);
+            mpz_clear(a);
+        })));
+#endif
+    }
+
+    //one sumcheck round, as in checkF012(): compare, then extrapolate
+    //F012 to r_j. This doesn't depend on the layer.
+    {
+        MPZVector F012(3);
+        randomVector(F012, prng, prime);
+        const mpz_srcptr rj = p.ri[0].empty() ? p.tau[0] : p.ri[0][0];
+#ifdef USE_NATIVE_FIELD
+        FieldEltVector f;
+        toField(f, F012);
+        const FieldElt fieldRj(rj);
+        benches.push_back(make_pair(string("sumcheck_round"), function<void()>([f, fieldRj]() {
+            FieldEltVector weights(3);
+            bool ok = (f[0] + f[1]) == f[2];
+            bary_precompute_weights3(weights, fieldRj);
+            FieldElt e = f[0] * weights[0] + f[1] * weights[1] + f[2] * weights[2];
+            benchSink = ok ^ e.isZero();
+        })));
+#else
+        benches.push_back(make_pair(string("sumcheck_round"), function<void()>([F012, rj, &prime]() {
+            MPZVector weights(3);
+            mpz_t e;
+            mpz_init(e);
+            mpz_add(e, F012[0], F012[1]);
+            benchSink = mpz_divisible_p(e, prime);
+            bary_precompute_weights3(weights, rj, prime);
+            mpz_mul(e, F012[0], weights[0]);
+            mpz_addmul(e, F012[1], weights[1]);
+            mpz_addmul(e, F012[2], weights[2]);
+            mpz_clear(e);
+        })));
+#endif
+    }
+
+    //the end of each layer's sumcheck, as in checkH(): the wiring
+    //predicate check, then H(tau) from H's coefficients.
+    for (int i = 0; i < depth - 1; i++) {
+        MPZVector H(p.logLayerSizes[i + 1] + 1);
+        randomVector(H, prng, prime);
+        const mpz_srcptr tau = p.tau[i];
+
+        ostringstream name;
+        name << "sumcheck_final/L" << i;
+#ifdef USE_NATIVE_FIELD
+        FieldEltVector h;
+        toField(h, H);
+        const FieldElt pred[5] = { FieldElt(p.add[i]), FieldElt(p.mul[i]), FieldElt(p.sub[i]),
+                                   FieldElt(p.muxl[i]), FieldElt(p.muxr[i]) };
+        const FieldEltVector preds(pred, pred + 5);
+        benches.push_back(make_pair(name.str(), function<void()>([h, preds, tau, &prime]() {
+            const FieldElt& v1 = h[0];
+            const FieldElt& v2 = h[1];
+            FieldElt a = (v1 + v2) * preds[0] + v1 * v2 * preds[1] + (v1 - v2) * preds[2]
+                       + v1 * preds[3] + v2 * preds[4];
+            bool ok = (a == v1);
+
+            MPZVector weights(h.size());
+            FieldEltVector fieldWeights, avec(1);
+            bary_precompute_weights(weights, tau, prime);
+            toField(fieldWeights, weights);
+            bary_extrap(avec, h, fieldWeights);
+            benchSink = ok ^ avec[0].isZero();
+        })));
+#else
+        const int li = i;
+        benches.push_back(make_pair(name.str(), function<void()>([H, tau, &p, li, &prime]() {
+            mpz_t a, tmp;
+            mpz_init(a);
+            mpz_init(tmp);
+            mpz_add(a, H[0], H[1]);
+            mpz_mul(a, a, p.add[li]);
+            mpz_mul(tmp, H[0], H[1]);
+            mpz_addmul(a, tmp, p.mul[li]);
+            mpz_sub(tmp, H[0], H[1]);
+            mpz_addmul(a, tmp, p.sub[li]);
+            mpz_addmul(a, H[0], p.muxl[li]);
+            mpz_addmul(a, H[1], p.muxr[li]);
+            benchSink = mpz_divisible_p(a, prime);
+            mpz_clear(a);
+            mpz_clear(tmp);
+
+            MPZVector weights(H.size()), avec(1);
+            bary_precompute_weights(weights, tau, prime);
+            bary_extrap(avec, H, weights, prime);
+        })));
+#endif
+    }
+
+    printHeader();
+    for (size_t b = 0; b < benches.size(); b++) {
+        if (benches[b].first.find(filter) == string::npos)
+            continue;
+        printResult(runBench(benches[b].first, samples, benches[b].second));
+    }
+
+    p.deinit();
+    mpz_clear(prime);
+    return 0;
+}
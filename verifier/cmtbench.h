@@ -0,0 +1,35 @@
+// cmtbench.h
+// header file for the verifier's benchmark harness
+
+#include <gmp.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "verifier_precomp.h"
+
+extern "C" {
+#include "util.h"
+}
+
+//default number of timed samples per benchmark
+#define BENCH_DEFAULT_SAMPLES 20
+//each sample runs the kernel this long (at least), to swamp timer overhead
+#define BENCH_SAMPLE_NS 2000000L
+//and the kernel is run this long before any samples are taken
+#define BENCH_WARMUP_NS 50000000L
+
+struct BenchResult {
+    std::string name;
+    long itersPerSample;
+    int samples;
+    double mean;    //all in ns per iteration
+    double median;
+    double stddev;
+    double min;
+};
@@ -21,15 +21,20 @@ void cmtprecomp_init(char *pwsfile) {
 
     state.parser->parse(pwsfile);
     state.c->construct();
+    state.c->setFieldEvaluation(true);
 
     // allocate and initialize mux bits
     int numMuxBits = state.parser->largestMuxBitIndex + 1;
-    state.muxBits.reserve(numMuxBits);
+    state.muxBits.resize(numMuxBits);
 
     for (int i = 0; i < numMuxBits; i++) {
         state.muxBits[i] = i % 2;
     }
 
+    state.p.init(state.c);
+    mpz_init(state.tmp);
+    VerifierPrecomputation::newMasterKey(state.masterKey);
+
     mpz_clear(prime);
     return;
 }
@@ -38,6 +43,8 @@ void cmtprecomp_init(char *pwsfile) {
 // clean up the parser and circuit objects
 //
 void cmtprecomp_deinit(void) {
+    state.p.deinit();
+    mpz_clear(state.tmp);
     delete state.c;
     delete state.parser;
 
@@ -62,130 +69,202 @@ void cmtprecomp_getmuxbits(bool** bits, int* numBits) {
     return;
 }
 
-int cmtprecomp_new(cmtprecomp_cdata *cdata) {
-    VerifierPrecomputation p;
-    p.init(state.c);
-    p.flipAllCoins();
-    p.computeAddMul(state.muxBits);
-
-    cdata->depth = p.depth - 1;
-    cdata->q0Size = p.qi[0].size();
-    cdata->iSize = p.layerSizes[cdata->depth];
-    cdata->oSize = p.layerSizes[0];
+//
+// copy x into element off of cdata's arena
+//
+static void put_elt(cmtprecomp_cdata *cdata, size_t off, mpz_srcptr x) {
+    size_t n = mpz_size(x);
+    assert(mpz_sgn(x) >= 0 && n <= CMTPRECOMP_ELT_LIMBS);
 
-    cdata->chi_i = cdata->chi_o = NULL;
-    cdata->layers = NULL;
+    mp_limb_t *dst = cdata->elts + off * CMTPRECOMP_ELT_LIMBS;
+    if (n > 0) {
+        memcpy(dst, mpz_limbs_read(x), n * sizeof(mp_limb_t));
+    }
+    memset(dst + n, 0, (CMTPRECOMP_ELT_LIMBS - n) * sizeof(mp_limb_t));
+}
 
-    // TODO lazy: we don't try to unwind memory allocations if something goes wrong
-    if ( NULL == (cdata->q0 = (mpz_t *) malloc(cdata->q0Size * sizeof(mpz_t))) ||
-         NULL == (cdata->chi_i = (mpz_t *) malloc(cdata->iSize * sizeof(mpz_t))) ||
-         NULL == (cdata->chi_o = (mpz_t *) malloc(cdata->oSize * sizeof(mpz_t))) ||
-         NULL == (cdata->layers = (cmtprecomp_ldata *) malloc(cdata->depth * sizeof(cmtprecomp_ldata))) ) {
-        p.deinit();
-        return 1;
+template <typename V>
+static void put_weights(cmtprecomp_cdata *cdata, size_t off, const V &weights, size_t n, mpz_t tmp) {
+    for (size_t i = 0; i < n; i++) {
+        getWeight(tmp, weights[i]);
+        put_elt(cdata, off + i, tmp);
     }
+}
+
+//
+// state.p, with fresh coins from the global prng
+//
+static void flip(void) {
+    VerifierPrecomputation &p = state.p;
+    p.flipAllCoins();
+    p.computeAddMul(state.muxBits);
+    p.computeWeights();
+}
 
+//
+// copy p (weights included) into cdata's arena
+//
+static void fill(cmtprecomp_cdata *cdata, const VerifierPrecomputation &p, mpz_t tmp) {
     // q0 - first layer q values, don't need the rest
     // (P computes the rest of them from w1, w2, and tau;
     // meanwhile, V has already used them in precomputation)
     for (unsigned i = 0; i < cdata->q0Size; i++) {
-        mpz_init_set(cdata->q0[i], p.qi[0][i]);
-    }
-
-    // input multilinear extension Lagrange weights
-    MPZVector chi_i(cdata->iSize);
-    computeChiAll(chi_i, p.qi[cdata->depth], p.subcircuit->prime);
-    for (unsigned i = 0; i < cdata->iSize; i++) {
-        mpz_init_set(cdata->chi_i[i], chi_i[i]);
+        put_elt(cdata, cdata->q0 + i, p.qi[0][i]);
     }
 
-    // output multilinear extension Lagrange weights
-    MPZVector chi_o(cdata->oSize);
-    computeChiAll(chi_o, p.qi[0], p.subcircuit->prime);
-    for (unsigned i = 0; i < cdata->oSize; i++) {
-        mpz_init_set(cdata->chi_o[i], chi_o[i]);
-    }
+    // input and output multilinear extension Lagrange weights
+    put_weights(cdata, cdata->chi_i, p.chiIn, cdata->iSize, tmp);
+    put_weights(cdata, cdata->chi_o, p.chiOut, cdata->oSize, tmp);
 
     // per-layer values
-    cdata->maxWidth = 0;
     for (unsigned j = 0; j < cdata->depth; j++) {
         cmtprecomp_ldata &layer = cdata->layers[j];
-        cdata->maxWidth = max(cdata->maxWidth, (unsigned) p.layerSizes[j]);
-        layer.bSize = p.ri[j].size() / 2;
-        layer.hSize = p.logLayerSizes[j+1] + 1;
-
-        // TODO lazy: we don't try to unwind memory allocations if something goes wrong
-        if ( NULL == (layer.h_wt = (mpz_t *) malloc(layer.hSize * sizeof(mpz_t))) ||
-             NULL == (layer.r = (mpz_t *) malloc(2 * layer.bSize * sizeof(mpz_t))) ||
-             NULL == (layer.f_wt = (mpz_t *) malloc(3 * 2 * layer.bSize * sizeof(mpz_t))) ) {
-            p.deinit();
-            return 1;
-        }
-
-        mpz_init_set(layer.tau, p.tau[j]);
-        mpz_init_set(layer.add, p.add[j]);
-        mpz_init_set(layer.mul, p.mul[j]);
-        mpz_init_set(layer.sub, p.sub[j]);
-        mpz_init_set(layer.muxl, p.muxl[j]);
-        mpz_init_set(layer.muxr, p.muxr[j]);
+        put_elt(cdata, layer.tau, p.tau[j]);
+        put_elt(cdata, layer.add, p.add[j]);
+        put_elt(cdata, layer.mul, p.mul[j]);
+        put_elt(cdata, layer.sub, p.sub[j]);
+        put_elt(cdata, layer.muxl, p.muxl[j]);
+        put_elt(cdata, layer.muxr, p.muxr[j]);
 
         // Lagrange weights for interpolating h
-        MPZVector h_weights(layer.hSize);
-        bary_precompute_weights(h_weights, p.tau[j], p.subcircuit->prime);
-        for (unsigned k = 0; k < layer.hSize; k++) {
-            mpz_init_set(layer.h_wt[k], h_weights[k]);
-        }
+        put_weights(cdata, layer.h_wt, p.hWeights[j], layer.hSize, tmp);
 
         // values for r, and Lagrange weights for f
         for (unsigned k = 0; k < 2 * layer.bSize; k++) {
-            mpz_init_set(layer.r[k], p.ri[j][k]);
-            MPZVector weights(3);
-            bary_precompute_weights3(weights, p.ri[j][k], p.subcircuit->prime);
-            for (unsigned l = 0; l < 3; l++) {
-                mpz_init_set(layer.f_wt[3 * k + l], weights[l]);
-            }
+            put_elt(cdata, layer.r + k, p.ri[j][k]);
         }
+        put_weights(cdata, layer.f_wt, p.fWeights[j], 3 * 2 * layer.bSize, tmp);
     }
 
-    p.deinit();
-
     cdata->initialized = true;
+}
+
+//
+// lay out cdata for instances shaped like p, and allocate its arena
+//
+static int alloc(cmtprecomp_cdata *cdata, const VerifierPrecomputation &p) {
+    cdata->depth = p.depth - 1;
+    cdata->q0Size = p.qi[0].size();
+    cdata->iSize = p.layerSizes[cdata->depth];
+    cdata->oSize = p.layerSizes[0];
+
+    // lay out the elements: the per-circuit ones, then each layer's
+    size_t n = 0;
+    cdata->q0 = n;
+    n += cdata->q0Size;
+    cdata->chi_i = n;
+    n += cdata->iSize;
+    cdata->chi_o = n;
+    n += cdata->oSize;
+
+    // the layer table goes at the start of the arena
+    size_t tableSize = cdata->depth * sizeof(cmtprecomp_ldata);
+    tableSize = (tableSize + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t) * sizeof(mp_limb_t);
+    std::vector<cmtprecomp_ldata> layers(cdata->depth);
+
+    cdata->maxWidth = 0;
+    for (unsigned j = 0; j < cdata->depth; j++) {
+        cmtprecomp_ldata &layer = layers[j];
+        cdata->maxWidth = max(cdata->maxWidth, (unsigned) p.layerSizes[j]);
+        layer.bSize = p.ri[j].size() / 2;
+        layer.hSize = p.logLayerSizes[j+1] + 1;
+
+        layer.tau = n++;
+        layer.add = n++;
+        layer.mul = n++;
+        layer.sub = n++;
+        layer.muxl = n++;
+        layer.muxr = n++;
+        layer.h_wt = n;
+        n += layer.hSize;
+        layer.r = n;
+        n += 2 * layer.bSize;
+        layer.f_wt = n;
+        n += 3 * 2 * layer.bSize;
+    }
+
+    cdata->arenaSize = tableSize + n * CMTPRECOMP_ELT_LIMBS * sizeof(mp_limb_t);
+    if ( NULL == (cdata->arena = malloc(cdata->arenaSize)) ) {
+        cdata->initialized = false;
+        return 1;
+    }
+    cdata->layers = (cmtprecomp_ldata *) cdata->arena;
+    cdata->elts = (mp_limb_t *) ((char *) cdata->arena + tableSize);
+    if (cdata->depth > 0) {
+        memcpy(cdata->layers, &layers[0], cdata->depth * sizeof(cmtprecomp_ldata));
+    }
     return 0;
 }
 
-void cmtprecomp_delete(cmtprecomp_cdata *cdata) {
-    for (unsigned i = 0; i < cdata->depth; i++) {
-        cmtprecomp_ldata &layer = cdata->layers[i];
-        mpz_clears(layer.tau, layer.add, layer.mul, layer.sub, layer.muxl, layer.muxr, NULL);
-        for (unsigned j = 0; j < 2 * layer.bSize; j++) {
-            mpz_clear(layer.r[j]);
-            for (unsigned k = 0; k < 3; k++) {
-                mpz_clear(layer.f_wt[3 * j + k]);
-            }
-        }
-        for (unsigned j = 0; j < layer.hSize; j++) {
-            mpz_clear(layer.h_wt[j]);
-        }
+int cmtprecomp_new(cmtprecomp_cdata *cdata) {
+    if (alloc(cdata, state.p) != 0) {
+        return 1;
+    }
+
+    flip();
+    fill(cdata, state.p, state.tmp);
+    return 0;
+}
 
-        free(layer.h_wt);
-        free(layer.r);
-        free(layer.f_wt);
+int cmtprecomp_renew(cmtprecomp_cdata *cdata) {
+    if (cdata->arena == NULL) {
+        errno = EINVAL;
+        return 1;
     }
 
-    for (unsigned i = 0; i < cdata->q0Size; i++) {
-        mpz_clear(cdata->q0[i]);
+    flip();
+    fill(cdata, state.p, state.tmp);
+    return 0;
+}
+
+//
+// instance number `instance`, from its own coin stream, in this thread's
+// own VerifierPrecomputation; the circuit and mux bits are only read
+//
+int cmtprecomp_new_instance(cmtprecomp_cdata *cdata, unsigned instance) {
+    VerifierPrecomputation p;
+    p.precomputeInstance(state.c, state.muxBits, state.masterKey, instance);
+    p.computeWeights();
+
+    int err = 0;
+    if (cdata->arena == NULL) {
+        err = alloc(cdata, p);
     }
-    for (unsigned i = 0; i < cdata->iSize; i++) {
-        mpz_clear(cdata->chi_i[i]);
+    if (err == 0) {
+        mpz_t tmp;
+        mpz_init(tmp);
+        fill(cdata, p, tmp);
+        mpz_clear(tmp);
     }
-    for (unsigned i = 0; i < cdata->oSize; i++) {
-        mpz_clear(cdata->chi_o[i]);
+
+    p.deinit();
+    return err;
+}
+
+//
+// precompute numInstances instances straight into a PrecompFile
+//
+int cmtprecomp_write(const char *fileName, int numInstances) {
+    PrecompFile file;
+    if (!file.create(fileName, *state.c, state.muxBits)) {
+        return 1;
     }
 
-    free(cdata->layers);
-    free(cdata->q0);
-    free(cdata->chi_i);
-    free(cdata->chi_o);
+    for (int i = 0; i < numInstances; i++) {
+        flip();
+        if (!file.append(state.p)) {
+            return 1;
+        }
+    }
+
+    return file.close() ? 0 : 1;
+}
+
+void cmtprecomp_delete(cmtprecomp_cdata *cdata) {
+    free(cdata->arena);
+    cdata->arena = NULL;
+    cdata->layers = NULL;
+    cdata->elts = NULL;
 
     cdata->initialized = false;
     return;
@@ -4,27 +4,39 @@
 
 #ifndef have_cmtprecomp_h
 #define have_cmtprecomp_h
+
+#include <gmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+// An instance lives in one allocation, its arena: the per-layer table,
+// then every field element, each CMTPRECOMP_ELT_LIMBS limbs wide (least
+// significant first). The element fields below are offsets, in elements,
+// from elts; read them with cmtprecomp_elt(). Only layers and elts point
+// into the arena, so a copy of it is used by pointing those at the copy.
+#define CMTPRECOMP_ELT_LIMBS (256 / GMP_NUMB_BITS)
+
 // per-layer precomputed data
 typedef struct {
     unsigned bSize;
     unsigned hSize;
 
     // per-layer
-    mpz_t tau;
-    mpz_t add;
-    mpz_t mul;
-    mpz_t sub;
-    mpz_t muxl;
-    mpz_t muxr;
-    mpz_t *h_wt;    // hSize
+    size_t tau;
+    size_t add;
+    size_t mul;
+    size_t sub;
+    size_t muxl;
+    size_t muxr;
+    size_t h_wt;    // hSize
 
     // per-round
-    mpz_t *r;       //     2 * bSize
-    mpz_t *f_wt;    // 3 * 2 * bSize
+    size_t r;       //     2 * bSize
+    size_t f_wt;    // 3 * 2 * bSize
 } cmtprecomp_ldata;
 
 // per-circuit precomputed data
@@ -38,13 +50,17 @@ typedef struct {
     bool* muxBits;
     unsigned numMuxBits;
     // per-circuit
-    mpz_t *q0;
-    mpz_t *chi_i;   // iSize
-    mpz_t *chi_o;   // oSize
+    size_t q0;      // q0Size
+    size_t chi_i;   // iSize
+    size_t chi_o;   // oSize
 
     // per-layer
     cmtprecomp_ldata *layers;   // depth
 
+    void *arena;
+    size_t arenaSize;   // in bytes
+    mp_limb_t *elts;
+
     // state of computation
     unsigned cLayer;
     unsigned cRound;
@@ -72,9 +88,30 @@ extern void cmtprecomp_getmuxbits(bool** bits, int* numBits);
 // call to fill a struct with new data
 extern int cmtprecomp_new(cmtprecomp_cdata *cdata);
 
+// call to fill a struct from cmtprecomp_new() (and not deleted since) with
+// a fresh instance, reusing its arena
+extern int cmtprecomp_renew(cmtprecomp_cdata *cdata);
+
+// call to fill a struct with instance number `instance`, whose coins come
+// from a stream of its own (see verifier_precomp.h), reusing its arena if it
+// has one. Unlike the calls above, this may run on several threads at once
+// (each with its own struct), and alongside generate_inputs(); cdata must be
+// zeroed or from an earlier call, and the mux bits mustn't change meanwhile.
+extern int cmtprecomp_new_instance(cmtprecomp_cdata *cdata, unsigned instance);
+
 // call to clean up the struct
 extern void cmtprecomp_delete(cmtprecomp_cdata *cdata);
 
+// element off of cdata, as a read-only mpz whose storage is the arena:
+// view just holds the mpz's header, and needn't (mustn't) be cleared
+static inline mpz_srcptr cmtprecomp_elt(mpz_ptr view, const cmtprecomp_cdata *cdata, size_t off) {
+    return mpz_roinit_n(view, cdata->elts + off * CMTPRECOMP_ELT_LIMBS, CMTPRECOMP_ELT_LIMBS);
+}
+
+// call to precompute numInstances instances into a binary file for the
+// verifier (see verifier_precomp_file.h); nonzero (with errno set) on error
+extern int cmtprecomp_write(const char *fileName, int numInstances);
+
 // not strictly related to precomp, but I need the cpp interfaces.
 extern void generate_inputs(mpz_t * inputs, int id);
 
@@ -4,6 +4,8 @@
 
 #include <gmp.h>
 
+#include <cassert>
+#include <cerrno>
 #include <cstdbool>
 #include <cstdlib>
 #include <cstdio>
@@ -13,8 +15,8 @@
 #include <vector>
 
 #include "verifier_precomp.h"
+#include "verifier_precomp_file.h"
 
-#define INHIBIT_MPFQ
 extern "C" {
 #include "util.h"
 }
@@ -31,6 +33,13 @@ class CMTPrecompState {
         PWSCircuitParser *parser;
         PWSCircuit *c;
         std::vector<bool> muxBits;
+
+        // reused for every instance, which is then copied to its arena
+        VerifierPrecomputation p;
+        mpz_t tmp;
+
+        // cmtprecomp_new_instance()'s coin streams are keyed with this
+        uint8_t masterKey[MASTER_KEY_BYTES];
 };
 
 CMTPrecompState state;
@@ -0,0 +1,207 @@
+// cmtreplay.cpp
+// replays a trace from verifier -t (see verifier_trace.h) through V's
+// checks, with no prover and no sockets: P's messages come from the
+// trace, and so do V's coins, so the result is the recorded run's.
+//
+// What V sends is checked against what it sent when the trace was made,
+// so this doubles as a regression test for the checks; and it reports
+// the time taken to precompute (the wiring predicates) and to check,
+// separately, at full speed.
+
+#include "cmtreplay.h"
+
+#include "fiat_shamir.h"
+
+#include <circuit/pws_circuit_parser.h>
+#include <circuit/pws_circuit.h>
+#include <circuit/pws_codegen.h>
+
+#include <iomanip>
+#include <time.h>
+
+using namespace std;
+
+extern mpz_t mpz_buf[];
+
+static double nowNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * (double) BILLION + t.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    int copies = 1;
+    const char* compiledName = NULL;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-r"))
+            copies = atoi(argv[2]);
+        else if (!strcmp(argv[1], "-x"))
+            compiledName = argv[2];
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 3) {
+        cout << "usage: " << argv[0] << " [-r copies] [-x compiled.so] <pwsfile> <trace> [passes]" << endl;
+        cout << "    -r, -x: as given to the verifier that recorded the trace" << endl;
+        exit(1);
+    }
+    int passes = (argc > 3) ? atoi(argv[3]) : REPLAY_DEFAULT_PASSES;
+    if (passes < 1)
+        passes = 1;
+
+    mpz_t prime;
+    mpz_init_set_ui(prime, 1);
+    mpz_mul_2exp(prime, prime, PRIMEBITS);
+    mpz_sub_ui(prime, prime, PRIMEDELTA);
+
+    PWSCircuitParser parser(prime);
+    PWSCircuit c(parser);
+    parser.parse(argv[1]);
+    parser.replicate(copies);
+    c.construct();
+    c.setFieldEvaluation(true);
+    parser.printCircuitStats();
+
+    int numMuxBits = parser.largestMuxBitIndex + 1;
+    vector<bool> muxBits;
+    chooseMuxBits(muxBits, numMuxBits);
+
+    PWSCompiledEval compiled;
+    if (compiledName != NULL) {
+        compiled.load(compiledName, parser, c);
+        c.setCompiled(&compiled, muxBits);
+    }
+
+    for (int i = 0; i < MPZ_BUF_LEN; i++)
+        mpz_init(mpz_buf[i]);
+
+    TraceReader trace;
+    trace.open(argv[2], c, muxBits);
+
+    map<int, ReplaySlot*> active; //by computation id
+    map<int, ReplaySlot*> coining; //still reading their coins
+    vector<ReplaySlot*> idle;
+    MPZVector sent;
+    bool ok = true;
+
+    for (int pass = 0; pass < passes; pass++) {
+        int total = 0, failed = 0, diverged = 0;
+        double precompNs = 0, checkNs = 0;
+        double start = nowNs();
+
+        trace.rewind();
+        prover_request request;
+        while (trace.next(request)) {
+            if (request.requestType == TRACE_COINS) {
+                //the first part of the coins starts a computation; it
+                //can go once the last part is in.
+                double t1 = nowNs();
+                ReplaySlot* slot;
+                map<int, ReplaySlot*>::iterator it = coining.find(request.id);
+                if (request.layer < 0 && it == coining.end() && active.count(request.id) == 0) {
+                    if (!idle.empty()) {
+                        slot = idle.back();
+                        idle.pop_back();
+                    }
+                    else {
+                        slot = new ReplaySlot();
+                    }
+                    slot->precomp.init(&c);
+                    coining[request.id] = slot;
+                }
+                else if (request.layer >= 0 && it != coining.end()) {
+                    slot = it->second;
+                }
+                else {
+                    slot = NULL;
+                }
+
+                if (slot == NULL || !VerifierTrace::coinsFromBuf(slot->precomp, request)) {
+                    cout << "ERROR: the trace has out of order coins for computation id " << request.id << ". exiting." << endl;
+                    exit(1);
+                }
+                if (request.layer == slot->precomp.depth - 2) {
+                    slot->precomp.computeQi();
+                    slot->precomp.computeAddMul(muxBits);
+
+                    slot->state.init(&slot->precomp, request.id);
+                    slot->state.setVerbose(false);
+                    coining.erase(request.id);
+                    active[request.id] = slot;
+                }
+                precompNs += nowNs() - t1;
+                continue;
+            }
+
+            map<int, ReplaySlot*>::iterator it = active.find(request.id);
+            if (it == active.end()) {
+                cout << "ERROR: the trace has a request for computation id " << request.id << " before its coins. exiting." << endl;
+                exit(1);
+            }
+            ReplaySlot* slot = it->second;
+
+            //keep what V sent then, to compare with what it sends now.
+            bool sends = verifierSendsOn(request);
+            if (sends) {
+                sent.resize(request.howMany);
+                for (int i = 0; i < request.howMany; i++)
+                    mpz_set(sent[i], mpz_buf[i]);
+            }
+
+            double t1 = nowNs();
+            slot->state.handle(request);
+            checkNs += nowNs() - t1;
+
+            if (sends) {
+                bool same = true;
+                for (int i = 0; i < request.howMany; i++)
+                    same = same && mpz_cmp(sent[i], mpz_buf[i]) == 0;
+                if (!same) {
+                    cout << "ERROR: computation " << request.id << ": V sent something else for request type "
+                         << request.requestType << " (layer " << request.layer << ", round " << request.round
+                         << ") than it did when the trace was made." << endl;
+                    diverged++;
+                }
+            }
+
+            if (slot->state.isDone()) {
+                if (!slot->state.succeeded())
+                    failed++;
+                total++;
+                slot->precomp.deinit();
+                active.erase(request.id);
+                idle.push_back(slot);
+            }
+        }
+
+        double elapsed = nowNs() - start;
+        cout << fixed << setprecision(3);
+        cout << "pass " << pass << ": " << total << " computations, " << total - failed << " verified, "
+             << failed << " failed, " << diverged << " divergent messages" << endl;
+        cout << "    precompute: " << precompNs / 1e6 << " ms, checks: " << checkNs / 1e6
+             << " ms, total (with decoding): " << elapsed / 1e6 << " ms";
+        if (total > 0)
+            cout << ", " << setprecision(1) << total / (elapsed / BILLION) << " computations/s";
+        cout << endl;
+
+        if (!active.empty())
+            cout << "    (" << active.size() << " computations unfinished at the end of the trace)" << endl;
+        ok = ok && failed == 0 && diverged == 0;
+
+        active.insert(coining.begin(), coining.end());
+        coining.clear();
+        for (map<int, ReplaySlot*>::iterator it = active.begin(); it != active.end(); ++it) {
+            it->second->precomp.deinit();
+            idle.push_back(it->second);
+        }
+        active.clear();
+    }
+
+    for (size_t i = 0; i < idle.size(); i++)
+        delete idle[i];
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+// cmtreplay.h
+// header file for the verifier's trace replay driver
+
+#include <gmp.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "verifier_precomp.h"
+#include "verifier_comp_state.h"
+#include "verifier_trace.h"
+
+extern "C" {
+#include "util.h"
+}
+
+//default number of passes over the trace
+#define REPLAY_DEFAULT_PASSES 1
+
+//a computation being replayed: its coins (and precomputation) from the
+//trace, and V's state.
+struct ReplaySlot {
+    VerifierPrecomputation precomp;
+    VerifierCompState state;
+};
@@ -0,0 +1,213 @@
+#include "fiat_shamir.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+void chooseMuxBits(vector<bool>& muxBits, int numMuxBits) {
+    muxBits.resize(numMuxBits);
+    for (int i = 0; i < numMuxBits; i++) {
+        muxBits[i] = i % 2;
+    }
+}
+
+void computationInputs(PWSCircuit* c, int id, MPZVector& inputs) {
+    //getInputSize returns the number of non-constant inputs to the
+    //computation
+    MPQVector vec(c->getInputSize());
+    for (size_t j = 0; j < vec.size(); j++)
+        mpq_set_ui(vec[j],  (10 + id) * (j + 1), 1);
+
+    //set the inputs to the computation, including the constants
+    c->initializeInputs(vec);
+
+    //with compiled evaluation code, working out the magic gates (which
+    //otherwise stay zero) is cheap enough for V to do.
+    if (c->hasCompiled() && c->hasMagic())
+        c->evaluate();
+
+    //now get the input layer and extract the full input, including
+    //constants.
+    CircuitLayer& inLayer = c->getInputLayer();
+    inputs.resize(inLayer.size());
+    for (int j = 0; j < inLayer.size(); j++)
+        inLayer.gate(j).getValue(inputs[j]);
+}
+
+ProofFile::ProofFile()
+    : fp(NULL), writing(false), name(NULL),
+      circuit(FS_TRANSCRIPT_LABEL), transcript(FS_TRANSCRIPT_LABEL) {
+    mpz_init(prime);
+}
+
+ProofFile::~ProofFile() {
+    close();
+    mpz_clear(prime);
+}
+
+//absorb everything that fixes the statement being proved, other than the
+//computation: the field, the wiring and the mux bits.
+void ProofFile::start(const PWSCircuit& c, const vector<bool>& muxBits) {
+    mpz_set(prime, c.prime);
+    circuit = Transcript(FS_TRANSCRIPT_LABEL);
+    buf.resize(MPZ_BUF_LEN * FIELD_BYTES);
+
+    c.absorbWiring(circuit);
+    circuit.absorb((uint32_t) muxBits.size());
+    for (size_t i = 0; i < muxBits.size(); i++)
+        circuit.absorb((uint32_t) muxBits[i]);
+}
+
+void ProofFile::create(const char* fileName, const PWSCircuit& c, const vector<bool>& muxBits) {
+    close();
+    start(c, muxBits);
+
+    name = fileName;
+    writing = true;
+    fp = fopen(fileName, "wb");
+    if (fp == NULL) {
+        perror(fileName);
+        exit(1);
+    }
+
+    Transcript digest(circuit);
+    mpz_t d;
+    mpz_init(d);
+    digest.challenge(d, prime);
+    pack_field(&buf[0], d);
+    mpz_clear(d);
+
+    if (fwrite(FS_PROOF_MAGIC, FS_PROOF_MAGIC_LEN, 1, fp) != 1 || fwrite(&buf[0], FIELD_BYTES, 1, fp) != 1)
+        ioError();
+    writeInt(c.depth());
+    for (int i = 0; i < c.depth(); i++)
+        writeInt(c[i].size());
+}
+
+void ProofFile::open(const char* fileName, const PWSCircuit& c, const vector<bool>& muxBits) {
+    close();
+    start(c, muxBits);
+
+    name = fileName;
+    writing = false;
+    fp = fopen(fileName, "rb");
+    if (fp == NULL) {
+        perror(fileName);
+        exit(1);
+    }
+
+    char magic[FS_PROOF_MAGIC_LEN];
+    if (fread(magic, FS_PROOF_MAGIC_LEN, 1, fp) != 1 || memcmp(magic, FS_PROOF_MAGIC, FS_PROOF_MAGIC_LEN)) {
+        cout << "ERROR: " << fileName << " is not a proof file. exiting." << endl;
+        exit(1);
+    }
+
+    Transcript digest(circuit);
+    mpz_t d;
+    mpz_init(d);
+    digest.challenge(d, prime);
+    pack_field(&buf[0], d);
+    mpz_clear(d);
+
+    uint8_t theirs[FIELD_BYTES];
+    if (fread(theirs, FIELD_BYTES, 1, fp) != 1)
+        ioError();
+
+    int depth;
+    bool same = !memcmp(theirs, &buf[0], FIELD_BYTES) && readInt(depth) && depth == c.depth();
+    for (int i = 0; same && i < depth; i++) {
+        int size;
+        same = readInt(size) && size == c[i].size();
+    }
+    if (!same) {
+        cout << "ERROR: " << fileName << " proves another circuit (or was made with other mux bits). exiting." << endl;
+        exit(1);
+    }
+}
+
+void ProofFile::close() {
+    if (fp == NULL)
+        return;
+
+    if (fclose(fp) != 0 && writing)
+        ioError();
+    fp = NULL;
+}
+
+void ProofFile::startComputation(int id) {
+    writeInt(id);
+    transcript = circuit;
+    transcript.absorb((uint32_t) id);
+}
+
+bool ProofFile::nextComputation(int& id) {
+    if (!readInt(id)) {
+        if (!feof(fp))
+            ioError();
+        return false;
+    }
+    transcript = circuit;
+    transcript.absorb((uint32_t) id);
+    return true;
+}
+
+void ProofFile::put(const MPZVector& msg) {
+    for (size_t i = 0; i < msg.size(); i += MPZ_BUF_LEN) {
+        size_t n = min(msg.size() - i, (size_t) MPZ_BUF_LEN);
+        for (size_t j = 0; j < n; j++)
+            pack_field(&buf[j * FIELD_BYTES], msg[i + j]);
+
+        if (fwrite(&buf[0], FIELD_BYTES, n, fp) != n)
+            ioError();
+        transcript.absorb(&buf[0], n * FIELD_BYTES);
+    }
+}
+
+void ProofFile::get(MPZVector& msg, int howMany) {
+    msg.resize(howMany);
+    for (size_t i = 0; i < msg.size(); i += MPZ_BUF_LEN) {
+        size_t n = min(msg.size() - i, (size_t) MPZ_BUF_LEN);
+        if (fread(&buf[0], FIELD_BYTES, n, fp) != n)
+            ioError();
+
+        transcript.absorb(&buf[0], n * FIELD_BYTES);
+        for (size_t j = 0; j < n; j++)
+            unpack_field(msg[i + j], &buf[j * FIELD_BYTES]);
+    }
+}
+
+void ProofFile::challenges(MPZVector& out, int howMany) {
+    out.resize(howMany);
+    for (int i = 0; i < howMany; i++)
+        transcript.challenge(out[i], prime);
+}
+
+void ProofFile::writeInt(int val) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++)
+        bytes[i] = ((uint32_t) val >> (8 * i)) & 0xff;
+    if (fwrite(bytes, sizeof(bytes), 1, fp) != 1)
+        ioError();
+}
+
+bool ProofFile::readInt(int& val) {
+    uint8_t bytes[4];
+    if (fread(bytes, sizeof(bytes), 1, fp) != 1)
+        return false;
+
+    uint32_t u = 0;
+    for (int i = 0; i < 4; i++)
+        u |= (uint32_t) bytes[i] << (8 * i);
+    val = (int) u;
+    return true;
+}
+
+void ProofFile::ioError() const {
+    if (writing)
+        perror(name);
+    else
+        cout << "ERROR: " << name << " is truncated or unreadable. exiting." << endl;
+    exit(1);
+}
@@ -0,0 +1,82 @@
+#pragma once
+/* Fiat-Shamir: the protocol without the round trips. Rather than V
+   handing out q0, each round's r and each layer's tau, both sides draw
+   them from a Transcript (see crypto/transcript.h) of the circuit and of
+   everything P has sent so far. So P can prove any number of
+   computations with no V around, writing the proofs to one file
+   (prover -p), and V can check that file later, in one pass (verifier -p).
+
+   The proof file is FS_PROOF_MAGIC, the circuit's digest (FIELD_BYTES
+   squeezed from its transcript), its depth and each layer's size; then,
+   for each computation, its id, followed by what P would have sent V:
+   the inputs (as V would have handed them out), the outputs, and for
+   each layer, F012 for each round and then H. Numbers are little-endian
+   int32s and field elements are FIELD_BYTES long, as in the binary
+   protocol (see util.h).
+ */
+#include <gmp.h>
+
+extern "C" {
+#include "util.h"
+}
+
+#include <circuit/pws_circuit.h>
+#include <common/mpnvector.h>
+#include <crypto/transcript.h>
+
+#include <cstdio>
+#include <vector>
+
+#define FS_PROOF_MAGIC "CMTPROOF"
+#define FS_PROOF_MAGIC_LEN 8
+#define FS_TRANSCRIPT_LABEL "zebra cmt fiat-shamir v1"
+
+//the mux selector bits V uses, and, without a V to ask, P too.
+void chooseMuxBits(std::vector<bool>& muxBits, int numMuxBits);
+
+//the whole input layer of computation id, including constants (and the
+//magic gates, if c can work them out; see PWSCircuit::setCompiled()), as
+//V hands it out.
+void computationInputs(PWSCircuit* c, int id, MPZVector& inputs);
+
+class ProofFile {
+ public:
+    ProofFile();
+    ~ProofFile();
+
+    //both exit on error. open() also exits if the file is for another
+    //circuit, or other mux bits.
+    void create(const char* fileName, const PWSCircuit& c, const std::vector<bool>& muxBits);
+    void open(const char* fileName, const PWSCircuit& c, const std::vector<bool>& muxBits);
+    void close(void);
+    bool isOpen(void) const { return fp != NULL; }
+
+    //writing: start computation id's proof.
+    void startComputation(int id);
+    //reading: the next computation's id, or false at the end of the file.
+    bool nextComputation(int& id);
+
+    //P's next message: written out (or read back in), and absorbed.
+    void put(const MPZVector& msg);
+    void get(MPZVector& msg, int howMany);
+
+    //V's next howMany coins, drawn from the transcript so far.
+    void challenges(MPZVector& out, int howMany);
+
+ private:
+    FILE* fp;
+    bool writing;
+    const char* name;
+    mpz_t prime;
+    Transcript circuit; //the circuit and mux bits
+    Transcript transcript; //this computation's, so far
+    std::vector<uint8_t> buf;
+
+    ProofFile(const ProofFile&);
+    ProofFile& operator=(const ProofFile&);
+
+    void start(const PWSCircuit& c, const std::vector<bool>& muxBits);
+    void writeInt(int val);
+    bool readInt(int& val);
+    void ioError(void) const;
+};
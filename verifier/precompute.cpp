@@ -10,8 +10,17 @@ using namespace std;
 // invoke libcmtprecomp and dump out the results
 //
 int main (int argc, char* argv[]) {
+    // -o foo.precomp: write the instances to foo.precomp in binary, for
+    // verifier -l, rather than dumping them as text
+    const char *outName = NULL;
+    if (argc > 2 && !strcmp(argv[1], "-o")) {
+        outName = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+
     if (argc < 2) {
-        cout << "usage: " << argv[0] << " <pwsfile>  [num instances]" << endl;
+        cout << "usage: " << argv[0] << " [-o precompfile] <pwsfile>  [num instances]" << endl;
         exit(1);
     }
 
@@ -22,9 +31,22 @@ int main (int argc, char* argv[]) {
         numInstances = atoi(argv[2]);
     }
 
+    if (outName != NULL) {
+        if (cmtprecomp_write(outName, numInstances) != 0) {
+            perror(outName);
+            exit(1);
+        }
+        cmtprecomp_deinit();
+        return 0;
+    }
+
     cmtprecomp_cdata cdata;
+    mpz_t v;    // a view of an element (see cmtprecomp_elt)
     for (int i = 0; i < numInstances; i++) {
-        cmtprecomp_new(&cdata);
+        if ((i == 0 ? cmtprecomp_new(&cdata) : cmtprecomp_renew(&cdata)) != 0) {
+            perror("precompute");
+            exit(1);
+        }
 
         if (i != 0) {
             gmp_printf(PRECOMP_SEPARATOR);
@@ -35,26 +57,26 @@ int main (int argc, char* argv[]) {
         for (unsigned j = 0; j < cdata.depth; j++) {
             cmtprecomp_ldata &ldata = cdata.layers[j];
             gmp_printf("# *** layer %d *** #\n", j);
-            gmp_printf("%Zx # tau[%d]\n", ldata.tau, j);
-            gmp_printf("%Zx # add[%d]\n", ldata.add, j);
-            gmp_printf("%Zx # mul[%d]\n", ldata.mul, j);
-            gmp_printf("%Zx # sub[%d]\n", ldata.sub, j);
-            gmp_printf("%Zx # muxl[%d]\n", ldata.muxl, j);
-            gmp_printf("%Zx # muxr[%d]\n", ldata.muxr, j);
+            gmp_printf("%Zx # tau[%d]\n", cmtprecomp_elt(v, &cdata, ldata.tau), j);
+            gmp_printf("%Zx # add[%d]\n", cmtprecomp_elt(v, &cdata, ldata.add), j);
+            gmp_printf("%Zx # mul[%d]\n", cmtprecomp_elt(v, &cdata, ldata.mul), j);
+            gmp_printf("%Zx # sub[%d]\n", cmtprecomp_elt(v, &cdata, ldata.sub), j);
+            gmp_printf("%Zx # muxl[%d]\n", cmtprecomp_elt(v, &cdata, ldata.muxl), j);
+            gmp_printf("%Zx # muxr[%d]\n", cmtprecomp_elt(v, &cdata, ldata.muxr), j);
             gmp_printf("\n");
 
             // r and f_wt for each round
             for (unsigned k = 0; k < 2 * ldata.bSize; k++) {
-                gmp_printf("%Zx # r[%d][%d]\n", ldata.r[k], j, k);
+                gmp_printf("%Zx # r[%d][%d]\n", cmtprecomp_elt(v, &cdata, ldata.r + k), j, k);
                 for (int l = 0; l < 3; l++) {
-                    gmp_printf("%Zx # f_wt[%d][%d][%d]\n", ldata.f_wt[3*k + l], j, k, l);
+                    gmp_printf("%Zx # f_wt[%d][%d][%d]\n", cmtprecomp_elt(v, &cdata, ldata.f_wt + 3*k + l), j, k, l);
                 }
                 gmp_printf("\n");
             }
 
             // h_wt
             for (unsigned k = 0; k < ldata.hSize; k++) {
-                gmp_printf("%Zx # h_wt[%d][%d]\n", ldata.h_wt[k], j, k);
+                gmp_printf("%Zx # h_wt[%d][%d]\n", cmtprecomp_elt(v, &cdata, ldata.h_wt + k), j, k);
             }
             gmp_printf("\n");
         }
@@ -62,23 +84,25 @@ int main (int argc, char* argv[]) {
         // q
         gmp_printf("# *** q0 *** #\n");
         for (unsigned k = 0; k < cdata.q0Size; k++) {
-            gmp_printf("%Zx # q0[%d]\n", cdata.q0[k], k);
+            gmp_printf("%Zx # q0[%d]\n", cmtprecomp_elt(v, &cdata, cdata.q0 + k), k);
         }
         gmp_printf("\n");
 
         // input Lagrange weights
         gmp_printf("# *** input MLExt *** #\n");
         for (unsigned j = 0; j < cdata.iSize; j++) {
-            gmp_printf("%Zx # X_i[%d]\n", cdata.chi_i[j], j);
+            gmp_printf("%Zx # X_i[%d]\n", cmtprecomp_elt(v, &cdata, cdata.chi_i + j), j);
         }
         gmp_printf("\n");
 
         // output Lagrange weights
         gmp_printf("# *** output MLExt *** #\n");
         for (unsigned j = 0; j < cdata.oSize; j++) {
-            gmp_printf("%Zx # X_o[%d]\n", cdata.chi_o[j], j);
+            gmp_printf("%Zx # X_o[%d]\n", cmtprecomp_elt(v, &cdata, cdata.chi_o + j), j);
         }
+    }
 
+    if (numInstances > 0) {
         cmtprecomp_delete(&cdata);
     }
 
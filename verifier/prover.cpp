@@ -0,0 +1,327 @@
+#include "prover.h"
+
+#include <circuit/pws_circuit_parser.h>
+#include <circuit/pws_circuit.h>
+#include <circuit/pws_codegen.h>
+#include <gmp.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <time.h>
+
+#include <vector>
+
+extern mpz_t mpz_buf[];
+
+using namespace std;
+
+int main (int argc, char* argv[]) {
+
+    //-r n must match the verifier's.
+    //-x foo.so: evaluate with the worksheet's code from pws2cpp, built as
+    //a shared object, rather than interpreting the circuit.
+    //-p foo.proof: don't talk to a verifier; prove non-interactively (see
+    //fiat_shamir.h), into foo.proof.
+    int copies = 1;
+    const char* compiledName = NULL;
+    const char* proofName = NULL;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-r"))
+            copies = atoi(argv[2]);
+        else if (!strcmp(argv[1], "-x"))
+            compiledName = argv[2];
+        else if (!strcmp(argv[1], "-p"))
+            proofName = argv[2];
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 3) {
+        cout << "usage: " << argv[0] << " [-r copies] [-x compiled.so] [-p proof] <pwsfile>  <num instances> [num threads] [first id]" << endl;
+        exit(1);
+    }
+
+    mpz_t prime;
+    mpz_init_set_ui(prime, 1);
+    mpz_mul_2exp(prime, prime, PRIMEBITS);
+    mpz_sub_ui(prime, prime, PRIMEDELTA);
+
+    PWSCircuitParser parser(prime);
+    PWSCircuit c(parser);
+
+    parser.parse(argv[1]);
+    parser.replicate(copies);
+    c.construct();
+    parser.printCircuitStats();
+
+    PWSCompiledEval compiled;
+    if (compiledName != NULL) {
+        compiled.load(compiledName, parser, c);
+        if (!c.setFieldEvaluation(true)) {
+            cout << "ERROR: compiled evaluation needs a native field. exiting." << endl;
+            exit(1);
+        }
+    }
+
+    int numInstances = atoi(argv[2]);
+    int numThreads = (argc > 3) ? atoi(argv[3]) : (int) thread::hardware_concurrency();
+    if (numThreads < 1)
+        numThreads = 1;
+
+    //several provers can share one verifier by each taking a different
+    //range of computation ids.
+    int firstId = (argc > 4) ? atoi(argv[4]) : 0;
+
+    //V hands out the mux selector bits up front; they are the same for
+    //every instance. V's predicates send a mux gate to muxr (i.e., it
+    //selects in2) iff its bit is set.
+    int numMuxBits = parser.largestMuxBitIndex + 1;
+    vector<bool> muxBits;
+    if (proofName != NULL) {
+        chooseMuxBits(muxBits, numMuxBits);
+        proof.create(proofName, c, muxBits);
+    }
+    else {
+        initConnection();
+
+        bool* muxArr = new bool[numMuxBits];
+        requestMuxBits(muxArr, numMuxBits);
+        muxBits.assign(muxArr, muxArr + numMuxBits);
+        delete[] muxArr;
+    }
+
+    if (compiled.loaded())
+        c.setCompiled(&compiled, muxBits);
+
+    ProverCompState state;
+    state.init(&c, muxBits, numThreads);
+
+    struct timespec t1, t2;
+    for (int id = firstId; id < firstId + numInstances; id++) {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        prove(id, state, c);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+
+        cout << "PROVER [" << id << "]: " << numThreads << " threads, ";
+        cout << ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) 1000000.0;
+        cout << (proof.isOpen() ? " ms (wall clock)" : " ms (wall clock, including communication)") << endl;
+    }
+
+    if (binaryProtocol)
+        close(ver_sock);
+    proof.close();
+
+    state.deinit();
+    mpz_clear(prime);
+    return 0;
+}
+
+
+//run the whole protocol for one instance, in the same order as the
+//hardware prover (see common/tb/cmt_top_test.sv and
+//common/rtl/verifier_interface.sv).
+void prove(int id, ProverCompState& state, PWSCircuit& c) {
+    prover_request request;
+    request.id = id;
+    request.round = -1;
+    request.layer = -1;
+
+    MPZVector inputs, outputs, q, r(1), tau(1), F012(3), H;
+
+    request.requestType = CMT_INPUT;
+    request.howMany = c.getInputLayer().size();
+    if (proof.isOpen()) {
+        //no V to hand them out: work out the inputs V would have, and
+        //commit to them.
+        computationInputs(&c, id, inputs);
+        proof.startComputation(id);
+        proof.put(inputs);
+    }
+    else {
+        requestFromVerifier(request, inputs);
+    }
+
+    state.evaluate(inputs);
+    state.getOutputs(outputs);
+
+    request.requestType = CMT_OUTPUT;
+    request.howMany = c[0].size();
+    sendToVerifier(request, outputs);
+
+    request.requestType = CMT_Q0;
+    request.howMany = c[0].logSize();
+    requestFromVerifier(request, q);
+
+    for (int layer = 0; layer < c.depth() - 1; layer++) {
+        if (layer != 0) {
+            request.requestType = CMT_TAU;
+            request.howMany = 1;
+            request.layer = layer;
+            request.round = -1;
+            requestFromVerifier(request, tau);
+            state.nextQ(q, tau[0]);
+        }
+
+        state.startLayer(layer, q);
+
+        for (int round = 0; round < state.numRounds(); round++) {
+            state.computeF012(round, F012);
+
+            request.requestType = CMT_F012;
+            request.howMany = 3;
+            request.layer = layer;
+            request.round = round;
+            sendToVerifier(request, F012);
+
+            request.requestType = CMT_R;
+            request.howMany = 1;
+            requestFromVerifier(request, r);
+            state.bindRound(round, r[0]);
+        }
+
+        H.resize(state.numHcoeffs());
+        state.computeH(H);
+
+        request.requestType = CMT_H;
+        request.howMany = H.size();
+        request.layer = layer;
+        request.round = -1;
+        sendToVerifier(request, H);
+    }
+}
+
+
+void requestFromVerifier(prover_request request, MPZVector& response) {
+    if (proof.isOpen()) {
+        proof.challenges(response, request.howMany);
+        return;
+    }
+
+    if (binaryProtocol) {
+        sendHeaderBin(request, ver_sock);
+
+        prover_request header = request;
+        recieveMessageBin(&header, ver_sock);
+        if (header.id != request.id || header.requestType != request.requestType || header.howMany != request.howMany) {
+            cout << "ERROR: unexpected response from verifier in header. exiting." << endl;
+            exit(1);
+        }
+
+        response.resize(request.howMany);
+        for (int i = 0; i < request.howMany; i++)
+            mpz_set(response[i], mpz_buf[i]);
+        return;
+    }
+
+    int sock = connectToVerifier();
+    FILE* readfp = fdopen(sock, "r");
+
+    sendHeader(request, sock);
+
+    prover_request header = recieveHeader(readfp);
+    if (header.id != request.id || header.requestType != request.requestType || header.howMany != request.howMany) {
+        cout << "ERROR: unexpected response from verifier in header. exiting." << endl;
+        exit(1);
+    }
+    recieveMPZ(request.howMany, readfp);
+
+    response.resize(request.howMany);
+    for (int i = 0; i < request.howMany; i++)
+        mpz_set(response[i], mpz_buf[i]);
+
+    fclose(readfp);
+}
+
+void requestMuxBits(bool* muxBits, int numMuxBits) {
+    prover_request request;
+    request.id = 0;
+    request.requestType = CMT_MUXSEL;
+    request.howMany = numMuxBits;
+    request.layer = -1;
+    request.round = -1;
+
+    if (binaryProtocol) {
+        sendHeaderBin(request, ver_sock);
+        recieveMuxBitsBin(&request, muxBits, ver_sock);
+        return;
+    }
+
+    int sock = connectToVerifier();
+    FILE* readfp = fdopen(sock, "r");
+
+    sendHeader(request, sock);
+    recieveHeader(readfp);
+    //recieveHeader() stops at the ':', but sendHeader() also puts a space
+    //after it; skip that, or the bits come back shifted by one.
+    fgetc(readfp);
+    recieveMuxBits(muxBits, numMuxBits, readfp);
+
+    fclose(readfp);
+
+    //sendMuxBits() puts a '0' on the wire for a set bit.
+    for (int i = 0; i < numMuxBits; i++)
+        muxBits[i] = !muxBits[i];
+}
+
+void sendToVerifier(prover_request request, const MPZVector& toSend) {
+    if (proof.isOpen()) {
+        proof.put(toSend);
+        return;
+    }
+
+    if (request.howMany > MPZ_BUF_LEN) {
+        cout << "ERROR: too many field elements for one message. exiting." << endl;
+        exit(1);
+    }
+
+    for (int i = 0; i < request.howMany; i++)
+        mpz_set(mpz_buf[i], toSend[i]);
+
+    if (binaryProtocol) {
+        sendMessageBin(request, ver_sock);
+        return;
+    }
+
+    int sock = connectToVerifier();
+    sendHeader(request, sock);
+    sendMPZ(request.howMany, sock);
+    close(sock);
+}
+
+
+int connectToVerifier() {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("opening stream socket");
+        exit(1);
+    }
+
+    if (connect(sock, (struct sockaddr *) &server, sizeof(struct sockaddr_un)) < 0) {
+        close(sock);
+        perror("connecting stream socket");
+        cout << "(you must start the verifier before starting the prover)" << endl;
+        exit(1);
+    }
+
+    return sock;
+}
+
+void initConnection() {
+    for (int i = 0; i < MPZ_BUF_LEN; i++)
+        mpz_init(mpz_buf[i]);
+
+    char socket_path[1000];
+    getSocketPath(socket_path);
+
+    server.sun_family = AF_UNIX;
+    strcpy(server.sun_path, socket_path);
+
+    binaryProtocol = useBinaryProtocol();
+    if (binaryProtocol) {
+        ver_sock = connectToVerifier();
+        startBinaryProtocol(ver_sock);
+    }
+}
@@ -0,0 +1,44 @@
+#include <iostream>
+#include <gmp.h>
+
+#include <stdbool.h>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "prover_comp_state.h"
+#include "fiat_shamir.h"
+
+
+extern "C" {
+#include "util.h"
+}
+
+
+
+static struct sockaddr_un server;
+
+//with the binary protocol, all messages go over one connection.
+static bool binaryProtocol;
+static int ver_sock = -1;
+
+//with -p, there's no verifier: challenges come from, and messages go to,
+//the proof.
+static ProofFile proof;
+
+
+void initConnection(void);
+int connectToVerifier(void);
+
+void requestFromVerifier(prover_request request, MPZVector& response);
+void requestMuxBits(bool* muxBits, int numMuxBits);
+void sendToVerifier(prover_request request, const MPZVector& toSend);
+
+void prove(int id, ProverCompState& state, PWSCircuit& c);
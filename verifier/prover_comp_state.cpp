@@ -0,0 +1,336 @@
+#include "prover_comp_state.h"
+
+#include <common/math.h>
+#include <common/parallel.h>
+#include <common/poly_utils.h>
+#include <circuit/field_store.h>
+
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+void ProverCompState::init(PWSCircuit* c, const vector<bool>& muxBits, int nthreads) {
+    this->c = c;
+    this->muxBits = muxBits;
+    this->nthreads = nthreads > 0 ? nthreads : 1;
+    c->setEvalThreads(this->nthreads);
+    depth = c->depth();
+
+    values = new MPZVector[depth];
+    for (int i = 0; i < depth; i++)
+        values[i].resize((*c)[i].size());
+
+    mpz_init(v1);
+    mpz_init(v2);
+    currLayer = -1;
+}
+
+void ProverCompState::deinit(void) {
+    delete[] values;
+    mpz_clear(v1);
+    mpz_clear(v2);
+}
+
+//evaluate the circuit in the field, from the inputs to the outputs.
+//magic gates live in the input layer, so their values come from V along
+//with the rest of the inputs.
+void ProverCompState::evaluate(const MPZVector& inputs) {
+    assert(inputs.size() == values[depth - 1].size());
+    values[depth - 1].copy(inputs);
+
+    if (c->hasCompiled() && c->fieldEvaluation()) {
+        evaluateCompiled(inputs);
+        return;
+    }
+
+    const mpz_t& prime = c->prime;
+    for (int l = depth - 2; l >= 0; l--) {
+        const CircuitLayer& layer = (*c)[l];
+        const MPZVector& in = values[l + 1];
+        MPZVector& out = values[l];
+
+        c->threads().parallelFor(layer.size(), [&](int begin, int end, int) {
+            for (int g = begin; g < end; g++) {
+                const GateWiring& wiring = layer[g];
+                const mpz_t& op1 = in[wiring.in1];
+                const mpz_t& op2 = in[wiring.in2];
+
+                if (wiring.shouldBeTreatedAs(GateWiring::ADD))
+                    mpz_add(out[g], op1, op2);
+                else if (wiring.shouldBeTreatedAs(GateWiring::MUL))
+                    mpz_mul(out[g], op1, op2);
+                else if (wiring.shouldBeTreatedAs(GateWiring::SUB))
+                    mpz_sub(out[g], op1, op2);
+                else if (wiring.shouldBeTreatedAs(GateWiring::MUX))
+                    mpz_set(out[g], muxBits[layer.getMuxIdx(g)] ? op2 : op1);
+                else
+                    assert(false);
+
+                mpz_mod(out[g], out[g], prime);
+            }
+        });
+    }
+}
+
+//evaluate() with the circuit's generated code (see PWSCircuit::setCompiled()),
+//in its field store; the sumcheck wants the values as mpz's, so they are
+//copied back out afterwards.
+void ProverCompState::evaluateCompiled(const MPZVector& inputs) {
+    FieldStore* store = c->fieldStore();
+    for (size_t g = 0; g < inputs.size(); g++)
+        store->set(depth - 1, g, inputs[g]);
+
+    c->evaluateCompiled(false);
+
+    for (int l = depth - 2; l >= 0; l--) {
+        MPZVector& out = values[l];
+        c->threads().parallelFor(out.size(), [&](int begin, int end, int) {
+            for (int g = begin; g < end; g++)
+                store->get(out[g], l, g);
+        });
+    }
+}
+
+void ProverCompState::getOutputs(MPZVector& outputs) const {
+    outputs.resize(values[0].size());
+    outputs.copy(values[0]);
+}
+
+//set up the sumcheck for circuit layer `layer` at the point q.
+void ProverCompState::startLayer(int layer, const MPZVector& q) {
+    assert(layer >= 0 && layer < depth - 1);
+    currLayer = layer;
+
+    const CircuitLayer& cl = (*c)[layer];
+    const MPZVector& in = values[layer + 1];
+    const int ni = cl.size();
+    logInSize = log2i((int) in.size());
+
+    //the per-gate weights start out as chi_g(q).
+    weights.resize(ni);
+    computeChiAll(weights, q, c->prime);
+
+    kinds.resize(ni);
+    for (int g = 0; g < ni; g++) {
+        const GateWiring& wiring = cl[g];
+        if (wiring.shouldBeTreatedAs(GateWiring::ADD))
+            kinds[g] = K_ADD;
+        else if (wiring.shouldBeTreatedAs(GateWiring::MUL))
+            kinds[g] = K_MUL;
+        else if (wiring.shouldBeTreatedAs(GateWiring::SUB))
+            kinds[g] = K_SUB;
+        else
+            kinds[g] = muxBits[cl.getMuxIdx(g)] ? K_MUXR : K_MUXL;
+    }
+
+    //V_{i+1}, padded with zeros to a power of two.
+    vtab.resize(0);
+    vtab.resize(1 << logInSize);
+    for (size_t j = 0; j < in.size(); j++)
+        mpz_set(vtab[j], in[j]);
+
+    w.resize(2 * logInSize);
+
+    if (logInSize == 0) {
+        mpz_set(v1, vtab[0]);
+        mpz_set(v2, vtab[0]);
+    }
+}
+
+int ProverCompState::numRounds(void) const {
+    return 2 * logInSize;
+}
+
+void ProverCompState::combine(mpz_t rop, GateKind k, const mpz_t a, const mpz_t b) const {
+    switch (k) {
+    case K_ADD:
+        mpz_add(rop, a, b);
+        break;
+    case K_MUL:
+        mpz_mul(rop, a, b);
+        break;
+    case K_SUB:
+        mpz_sub(rop, a, b);
+        break;
+    case K_MUXL:
+        mpz_set(rop, a);
+        break;
+    case K_MUXR:
+        mpz_set(rop, b);
+        break;
+    }
+    mpz_mod(rop, rop, c->prime);
+}
+
+//F_j(t) for t = 0, 1, 2. The first logInSize rounds bind the bits of w1
+//(LSB first), the remaining rounds bind the bits of w2.
+void ProverCompState::computeF012(int round, MPZVector& F012) {
+    assert(round >= 0 && round < numRounds());
+    const bool firstHalf = round < logInSize;
+    const int shift = firstHalf ? round : round - logInSize;
+    const CircuitLayer& cl = (*c)[currLayer];
+    const MPZVector& in = values[currLayer + 1];
+    const int ni = cl.size();
+
+    int nparts = min(nthreads, ni);
+    MPZVector partial(3 * max(nparts, 1));
+
+    c->threads().parallelFor(ni, [&](int begin, int end, int tid) {
+        mpz_t* acc = &partial[3 * tid];
+        mpz_t vt, f;
+        mpz_init(vt);
+        mpz_init(f);
+
+        for (int g = begin; g < end; g++) {
+            const GateWiring& wiring = cl[g];
+            int x = (firstHalf ? wiring.in1 : wiring.in2) >> shift;
+            const mpz_t& A0 = vtab[x & ~1];
+            const mpz_t& A1 = vtab[x | 1];
+
+            //V(.., 2, ..) = 2 * A1 - A0
+            mpz_mul_2exp(vt, A1, 1);
+            mpz_sub(vt, vt, A0);
+
+            if (firstHalf) {
+                const mpz_t& other = in[wiring.in2];
+                if (x & 1) {
+                    combine(f, kinds[g], A1, other);
+                    mpz_addmul(acc[1], weights[g], f);
+                    combine(f, kinds[g], vt, other);
+                    mpz_mul_2exp(f, f, 1);
+                    mpz_addmul(acc[2], weights[g], f);
+                } else {
+                    combine(f, kinds[g], A0, other);
+                    mpz_addmul(acc[0], weights[g], f);
+                    combine(f, kinds[g], vt, other);
+                    mpz_submul(acc[2], weights[g], f);
+                }
+            } else {
+                if (x & 1) {
+                    combine(f, kinds[g], v1, A1);
+                    mpz_addmul(acc[1], weights[g], f);
+                    combine(f, kinds[g], v1, vt);
+                    mpz_mul_2exp(f, f, 1);
+                    mpz_addmul(acc[2], weights[g], f);
+                } else {
+                    combine(f, kinds[g], v1, A0);
+                    mpz_addmul(acc[0], weights[g], f);
+                    combine(f, kinds[g], v1, vt);
+                    mpz_submul(acc[2], weights[g], f);
+                }
+            }
+        }
+
+        mpz_clear(vt);
+        mpz_clear(f);
+    });
+
+    for (int i = 0; i < 3; i++) {
+        mpz_set_ui(F012[i], 0);
+        for (int t = 0; t < nparts; t++)
+            mpz_add(F012[i], F012[i], partial[3 * t + i]);
+        mpz_mod(F012[i], F012[i], c->prime);
+    }
+}
+
+//bind the current variable to r: update each gate's weight and fold the
+//V table in half.
+void ProverCompState::bindRound(int round, const mpz_t r) {
+    assert(round >= 0 && round < numRounds());
+    const bool firstHalf = round < logInSize;
+    const int shift = firstHalf ? round : round - logInSize;
+    const CircuitLayer& cl = (*c)[currLayer];
+    const mpz_t& prime = c->prime;
+
+    mpz_set(w[round], r);
+
+    mpz_t one_sub_r;
+    mpz_init(one_sub_r);
+    one_sub(one_sub_r, r);
+
+    c->threads().parallelFor(cl.size(), [&](int begin, int end, int) {
+        for (int g = begin; g < end; g++) {
+            int x = (firstHalf ? cl[g].in1 : cl[g].in2) >> shift;
+            modmult(weights[g], weights[g], (x & 1) ? r : one_sub_r, prime);
+        }
+    });
+
+    int half = vtab.size() / 2;
+    MPZVector folded(half);
+    c->threads().parallelFor(half, [&](int begin, int end, int) {
+        for (int k = begin; k < end; k++) {
+            mpz_sub(folded[k], vtab[2 * k + 1], vtab[2 * k]);
+            mpz_mul(folded[k], folded[k], r);
+            mpz_add(folded[k], folded[k], vtab[2 * k]);
+            mpz_mod(folded[k], folded[k], prime);
+        }
+    });
+    vtab.resize(half);
+    vtab.copy(folded);
+
+    mpz_clear(one_sub_r);
+
+    if (round == logInSize - 1) {
+        //w1 is fully bound; start over on V_{i+1} for w2.
+        mpz_set(v1, vtab[0]);
+        const MPZVector& in = values[currLayer + 1];
+        vtab.resize(0);
+        vtab.resize(1 << logInSize);
+        for (size_t j = 0; j < in.size(); j++)
+            mpz_set(vtab[j], in[j]);
+    } else if (round == 2 * logInSize - 1) {
+        mpz_set(v2, vtab[0]);
+    }
+}
+
+int ProverCompState::numHcoeffs(void) const {
+    return logInSize + 1;
+}
+
+//H(t) = V_{i+1}(w1 + t * (w2 - w1)) for t = 0 .. logInSize.
+//H(0) = V(w1) and H(1) = V(w2) are already known; the rest are
+//independent, so they are handed out to the worker threads.
+void ProverCompState::computeH(MPZVector& H) {
+    const MPZVector& in = values[currLayer + 1];
+    const mpz_t& prime = c->prime;
+    const int n = numHcoeffs();
+
+    mpz_set(H[0], v1);
+    if (n > 1)
+        mpz_set(H[1], v2);
+
+    c->threads().parallelFor(n - 2, [&](int begin, int end, int) {
+        MPZVector point(logInSize);
+        MPZVector chis(in.size());
+        mpz_t tmp;
+        mpz_init(tmp);
+
+        for (int t = begin + 2; t < end + 2; t++) {
+            for (int k = 0; k < logInSize; k++) {
+                mpz_sub(point[k], w[logInSize + k], w[k]);
+                mpz_mul_ui(point[k], point[k], t);
+                mpz_add(point[k], point[k], w[k]);
+                mpz_mod(point[k], point[k], prime);
+            }
+            computeChiAll(chis, point, prime);
+
+            mpz_set_ui(tmp, 0);
+            for (size_t j = 0; j < in.size(); j++)
+                mpz_addmul(tmp, chis[j], in[j]);
+            mpz_mod(H[t], tmp, prime);
+        }
+
+        mpz_clear(tmp);
+    });
+}
+
+//q_{i+1} = w1 + tau * (w2 - w1), as in VerifierPrecomputation::flipAllCoins.
+void ProverCompState::nextQ(MPZVector& q, const mpz_t tau) const {
+    q.resize(logInSize);
+    for (int k = 0; k < logInSize; k++) {
+        mpz_sub(q[k], w[logInSize + k], w[k]);
+        mpz_mul(q[k], q[k], tau);
+        modadd(q[k], w[k], q[k], c->prime);
+    }
+}
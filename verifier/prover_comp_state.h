@@ -0,0 +1,75 @@
+#pragma once
+/* ProverCompState: a native software prover for one instance of a
+   computation. It evaluates the circuit on the inputs handed out by the
+   verifier and then answers the sumcheck protocol layer by layer,
+   producing exactly the messages the hardware prover sends (outputs,
+   F012 for each round, H at the end of each layer).
+
+   The per-gate work of each round (the F012 sums, folding the V tables
+   and updating the per-gate weights), and of evaluating each layer, is
+   split across nthreads threads: the circuit's pool (see
+   PWSCircuit::threads()), started once. Each worker accumulates into its own unreduced partial sum,
+   so there is one reduction per round rather than one per gate.
+
+   Usage, for each layer i = 0 .. depth - 2:
+
+     startLayer(i, q_i)
+     for each round: computeF012(round, F); bindRound(round, r)
+     computeH(H); nextQ(q_{i+1}, tau)       (tau is not needed for the last layer)
+ */
+
+#include <gmp.h>
+
+extern "C" {
+#include "util.h"
+}
+
+#include <circuit/pws_circuit.h>
+#include <common/mpnvector.h>
+
+#include <vector>
+
+class ProverCompState {
+ public:
+    //only default constructor. must call init() before using.
+    void init(PWSCircuit* c, const std::vector<bool>& muxBits, int nthreads);
+    void deinit(void);
+
+    //inputs is the whole input layer, including constants, as sent by V.
+    void evaluate(const MPZVector& inputs);
+    void getOutputs(MPZVector& outputs) const;
+
+    void startLayer(int layer, const MPZVector& q);
+    int numRounds(void) const;
+    void computeF012(int round, MPZVector& F012);
+    void bindRound(int round, const mpz_t r);
+    int numHcoeffs(void) const;
+    void computeH(MPZVector& H);
+    void nextQ(MPZVector& q, const mpz_t tau) const;
+
+ private:
+    //how each gate of the current layer combines V(w1) and V(w2), i.e.,
+    //which of the add/mul/sub/muxl/muxr predicates it contributes to.
+    enum GateKind { K_ADD, K_MUL, K_SUB, K_MUXL, K_MUXR };
+
+    void evaluateCompiled(const MPZVector& inputs);
+
+    PWSCircuit* c;
+    std::vector<bool> muxBits;
+    int nthreads;
+    int depth;
+
+    //values[i] holds the gate values of circuit layer i (0 = outputs).
+    MPZVector* values;
+
+    //sumcheck state for the current layer
+    int currLayer;
+    int logInSize;
+    std::vector<GateKind> kinds;
+    MPZVector weights; //chi_q(g) * chi_{bound bits of w1, w2}(in1, in2)
+    MPZVector vtab;    //V_{i+1} with the bound bits folded in
+    mpz_t v1, v2;      //V_{i+1}(w1), V_{i+1}(w2) once they are known
+    MPZVector w;       //w1 followed by w2
+
+    void combine(mpz_t rop, GateKind k, const mpz_t a, const mpz_t b) const;
+};
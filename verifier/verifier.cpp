@@ -2,22 +2,58 @@
 
 #include <circuit/pws_circuit_parser.h>
 #include <circuit/pws_circuit.h>
+#include <circuit/pws_codegen.h>
 #include <gmp.h>
 #include <common/math.h>
 #include <common/poly_utils.h>
 
 #include <cstdlib>
+#include <cstring>
+#include <thread>
 
 #include <vector>
 
-extern mpz_t mpz_buf[];
-
 using namespace std;
 
+extern mpz_t mpz_buf[];
+
 int main (int argc, char* argv[]) {
 
-    if (argc < 3) {
-        cout << "usage: " << argv[0] << " <pwsfile>  <num instances>" << endl;
+    //-r n: check n data-parallel copies of the worksheet, built natively
+    //rather than by pwsrepeat.
+    //-x foo.so: the worksheet's evaluation code from pws2cpp, built as a
+    //shared object. With it, V works out the magic gates of the inputs.
+    //-p foo.proof: don't serve a prover; check the proofs in foo.proof,
+    //from prover -p (see fiat_shamir.h).
+    //-t foo.trace: record everything V sees and says to foo.trace, for
+    //cmtreplay (see verifier_trace.h).
+    //-l foo.precomp: load the instances from foo.precomp, from precompute
+    //-o (see verifier_precomp_file.h), rather than precomputing them.
+    int copies = 1;
+    const char* compiledName = NULL;
+    const char* proofName = NULL;
+    const char* traceName = NULL;
+    const char* precompName = NULL;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-r"))
+            copies = atoi(argv[2]);
+        else if (!strcmp(argv[1], "-x"))
+            compiledName = argv[2];
+        else if (!strcmp(argv[1], "-p"))
+            proofName = argv[2];
+        else if (!strcmp(argv[1], "-t"))
+            traceName = argv[2];
+        else if (!strcmp(argv[1], "-l"))
+            precompName = argv[2];
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < (proofName != NULL ? 2 : 3)) {
+        cout << "usage: " << argv[0] << " [-r copies] [-x compiled.so] [-t trace] [-l precompfile] <pwsfile>  <num instances> [num precompute threads] [precompute window]" << endl;
+        cout << "       " << argv[0] << " [-r copies] [-x compiled.so] [-t trace] -p proof <pwsfile>" << endl;
         exit(1);
     }
 
@@ -33,7 +69,10 @@ int main (int argc, char* argv[]) {
     cout << "==== Constructing Circuit ====" << endl;
 #endif
     parser.parse(argv[1]);
+    parser.replicate(copies);
     c.construct();
+    //V only ever needs the input layer's values in the field.
+    c.setFieldEvaluation(true);
 #ifdef DEBUG
     cout << "==== Construction Complete ====" << endl;
 
@@ -45,145 +84,169 @@ int main (int argc, char* argv[]) {
         exit(0);
     }
 
-    int numInstances = atoi(argv[2]);
-
-    VerifierPrecomputation* precomp = new VerifierPrecomputation[numInstances];
-
-
     int numMuxBits = parser.largestMuxBitIndex + 1;
-    vector<bool> muxBits(numMuxBits);
-    for (int i = 0; i < numMuxBits; i++) {
-        muxBits[i] = i % 2;
-    }
-
-    //to pass muxbits to a c function
-    //(vector<bool> doesn't implement data() for doing this easily...)
-    bool* muxArr = new bool[numMuxBits];
-    copy(muxBits.begin(), muxBits.end(), muxArr);
-
+    vector<bool> muxBits;
+    chooseMuxBits(muxBits, numMuxBits);
 
-    //precompute user-specified number of computation instances.
-    for (int i = 0; i < numInstances; i++) {
-        precomp[i].init(&c);
-        precomp[i].flipAllCoins();
-        precomp[i].computeAddMul(muxBits);
+    PWSCompiledEval compiled;
+    if (compiledName != NULL) {
+        compiled.load(compiledName, parser, c);
+        c.setCompiled(&compiled, muxBits);
     }
 
-    VerifierCompState verState[PIPELINE_DEPTH];
-    for (int i = 0; i < PIPELINE_DEPTH; i++) {
-        init_cmt_io(i, c.maxWidth(), c.depth());
-    }
-
-    initConnection();
-
-    while(1) {
-        int rcv_sock = accept(listen_sock, NULL, 0);
-        if (rcv_sock == -1)
-            perror("accept");
-
-        FILE* fp = fdopen(rcv_sock, "r");
+    VerifierTrace trace;
+    if (traceName != NULL)
+        trace.create(traceName, c, muxBits);
 
-        prover_request request = recieveHeader(fp);
-
-        if (request.requestType == CMT_MUXSEL) {
-            sendHeader(request, rcv_sock);
-            sendMuxBits(muxArr, numMuxBits, rcv_sock);
-            fclose(fp);
-            close(rcv_sock);
-            continue;
-        }
+    if (proofName != NULL) {
+        int failed = checkProofs(proofName, &c, muxBits, traceName != NULL ? &trace : NULL);
+        trace.close();
+        exit(failed == 0 ? 0 : 1);
+    }
 
-        if (request.id >= numInstances) {
-            cout << "ERROR: requested computation id for computation that has not been precomputed. exiting" << endl;
+    int numInstances = atoi(argv[2]);
+    int numThreads = (argc > 3) ? atoi(argv[3]) : (int) thread::hardware_concurrency();
+    if (numThreads < 1)
+        numThreads = 1;
+    //V evaluates the circuit (see computationInputs()) on the event loop's
+    //thread, between precomputations.
+    c.setEvalThreads(numThreads);
+    int window = (argc > 4) ? atoi(argv[4]) : DEFAULT_PRECOMP_WINDOW;
+    if (window < 1)
+        window = 1;
+
+    PrecompFile precompFile;
+    if (precompName != NULL) {
+        precompFile.open(precompName, &c, muxBits);
+        if (numInstances > precompFile.numInstances()) {
+            cout << "ERROR: " << precompName << " only has " << precompFile.numInstances() << " instances. exiting." << endl;
             exit(1);
         }
-
-        handle(request, fp, rcv_sock, precomp, verState);
-
-        fclose(fp);
-        close(rcv_sock);
     }
 
+    //precompute (or load) user-specified number of computation instances,
+    //at most window of them ahead of the prover.
+    uint8_t masterKey[MASTER_KEY_BYTES];
+    VerifierPrecomputation::newMasterKey(masterKey);
+    VerifierPrecompQueue queue(&c, muxBits, masterKey, numInstances, window, numThreads,
+                               precompName != NULL ? &precompFile : NULL);
 
+    VerifierServer server(&queue, muxBits, traceName != NULL ? &trace : NULL);
+    server.run();
 }
 
 
-void handle(prover_request request, FILE* readfp, int socket, VerifierPrecomputation* precomp, VerifierCompState* verState) {
-
-    int comp_state_id = request.id % PIPELINE_DEPTH;
-
-    if (verifierSendsOn(request)) {
-
-        switch (request.requestType) {
-        case CMT_INPUT:
-            verState[comp_state_id].init(&precomp[request.id], comp_state_id);
-            verState[comp_state_id].generateInputs(request);
-            break;
-        case CMT_Q0:
-            verState[comp_state_id].sendQ0(request);
-            break;
-        case CMT_R:
-            verState[comp_state_id].sendNextR(request);
-            break;
-        case CMT_TAU:
-            verState[comp_state_id].sendNextT(request);
-            break;
-        case CMT_QI:
-            verState[comp_state_id].sendNextQI(request);
-            break;
-        }
-        put_cmt_io(mpz_buf, request);
-        sendHeader(request, socket);
-        sendMPZ(request.howMany, socket);
-    }
-
-    else if (verifierRecievesOn(request)) {
-
-        recieveMPZ(request.howMany, readfp);
-        put_cmt_io(mpz_buf, request);
+//check every computation's proof in proofName; returns how many failed.
+int checkProofs(const char* proofName, PWSCircuit* c, const vector<bool>& muxBits, VerifierTrace* trace) {
+    for (int i = 0; i < MPZ_BUF_LEN; i++)
+        mpz_init(mpz_buf[i]);
 
-        switch (request.requestType) {
-        case CMT_OUTPUT:
-            verState[comp_state_id].checkOutputs(request);
-            break;
-        case CMT_F012:
-            verState[comp_state_id].checkF012(request);
-            break;
-        case CMT_H:
-            verState[comp_state_id].checkH(request);
-            break;
+    ProofFile proof;
+    proof.open(proofName, *c, muxBits);
+
+    VerifierPrecomputation precomp;
+    VerifierCompState state;
+    state.setTrace(trace);
+    const int depth = c->depth();
+    MPZVector inputs, outputs, coins;
+    vector<MPZVector> F012, H(depth - 1);
+
+    int id, total = 0, failed = 0;
+    while (proof.nextComputation(id)) {
+        //read P's messages, drawing V's coins from the transcript as P
+        //did; with all of them known, V's precomputation can be done.
+        precomp.init(c);
+        proof.get(inputs, (*c)[depth - 1].size());
+        proof.get(outputs, (*c)[0].size());
+        proof.challenges(precomp.qi[0], (*c)[0].logSize());
+
+        F012.clear();
+        for (int layer = 0; layer < depth - 1; layer++) {
+            int numRounds = precomp.ri[layer].size();
+            for (int round = 0; round < numRounds; round++) {
+                F012.push_back(MPZVector());
+                proof.get(F012.back(), 3);
+                proof.challenges(coins, 1);
+                mpz_set(precomp.ri[layer][round], coins[0]);
+            }
+
+            proof.get(H[layer], precomp.logLayerSizes[layer + 1] + 1);
+            proof.challenges(coins, 1);
+            mpz_set(precomp.tau[layer], coins[0]);
         }
 
-    }
-
-    else
-        cout << "ERROR: Invalid requestType in header" << endl;
-}
+        precomp.computeQi();
+        precomp.computeAddMul(muxBits);
 
+        //then run the protocol as if P were online.
+        state.init(&precomp, id);
 
+        prover_request request;
+        request.id = id;
+        request.layer = -1;
+        request.round = -1;
 
+        request.requestType = CMT_INPUT;
+        request.howMany = inputs.size();
+        state.handle(request);
+        bool sameInputs = true;
+        for (int i = 0; i < request.howMany; i++)
+            sameInputs = sameInputs && mpz_cmp(mpz_buf[i], inputs[i]) == 0;
 
-void initConnection() {
-    for (int i = 0; i < MPZ_BUF_LEN; i++)
-        mpz_init(mpz_buf[i]);
-
+        if (!sameInputs) {
+            cout << "ERROR: the proof is for inputs other than computation " << id << "'s." << endl;
+            cout << "**VERIFICATION FAILED [" << id << "] **" << endl;
+        }
+        else {
+            request.requestType = CMT_OUTPUT;
+            request.howMany = outputs.size();
+            for (int i = 0; i < request.howMany; i++)
+                mpz_set(mpz_buf[i], outputs[i]);
+            state.handle(request);
+
+            request.requestType = CMT_Q0;
+            request.howMany = precomp.qi[0].size();
+            state.handle(request);
+
+            size_t next = 0;
+            for (int layer = 0; layer < depth - 1; layer++) {
+                request.layer = layer;
+                request.round = -1;
+                if (layer != 0) {
+                    request.requestType = CMT_TAU;
+                    request.howMany = 1;
+                    state.handle(request);
+                }
+
+                int numRounds = precomp.ri[layer].size();
+                for (int round = 0; round < numRounds; round++, next++) {
+                    request.round = round;
+                    request.requestType = CMT_F012;
+                    request.howMany = 3;
+                    for (int i = 0; i < 3; i++)
+                        mpz_set(mpz_buf[i], F012[next][i]);
+                    state.handle(request);
+
+                    request.requestType = CMT_R;
+                    request.howMany = 1;
+                    state.handle(request);
+                }
+
+                request.round = -1;
+                request.requestType = CMT_H;
+                request.howMany = H[layer].size();
+                for (int i = 0; i < request.howMany; i++)
+                    mpz_set(mpz_buf[i], H[layer][i]);
+                state.handle(request);
+            }
+        }
 
-    listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (listen_sock < 0) {
-        perror("opening stream socket");
-        exit(1);
+        if (!sameInputs || !state.succeeded())
+            failed++;
+        total++;
+        precomp.deinit();
     }
-    char socket_path[1000];
-    getSocketPath(socket_path);
-
-    unlink(socket_path);
-    server.sun_family = AF_UNIX;
-    strcpy(server.sun_path, socket_path);
-    if (bind(listen_sock, (struct sockaddr *) &server, sizeof(struct sockaddr_un))) {
-        perror("binding stream socket");
-        exit(1);
-    }
-
-    listen(listen_sock, MAX_NUM_CONNECTIONS);
 
+    cout << "checked " << total << " proofs from " << proofName << ": " << total - failed << " verified, " << failed << " failed" << endl;
+    return failed;
 }
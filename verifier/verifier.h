@@ -14,23 +14,19 @@
 #include <unistd.h>
 
 #include "verifier_precomp.h"
+#include "verifier_precomp_queue.h"
+#include "verifier_precomp_file.h"
 #include "verifier_comp_state.h"
+#include "verifier_server.h"
+#include "fiat_shamir.h"
+#include "verifier_trace.h"
 
 
 extern "C" {
 #include "util.h"
 }
 
+//how many instances the precompute threads may get ahead of the prover
+#define DEFAULT_PRECOMP_WINDOW 16
 
-
-#define MAX_NUM_CONNECTIONS 1
-static int listen_sock;
-static struct sockaddr_un server;
-
-
-void initConnection(void);
-
-
-void handle(prover_request request, FILE* readfp, int socket, VerifierPrecomputation* precomp, VerifierCompState* verState);
-
-
+int checkProofs(const char* proofName, PWSCircuit* c, const std::vector<bool>& muxBits, VerifierTrace* trace);
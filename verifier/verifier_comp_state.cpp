@@ -1,5 +1,8 @@
 #include "verifier_comp_state.h"
 
+#include "fiat_shamir.h"
+#include "verifier_trace.h"
+
 #include <iostream>
 #include <circuit/cmtgkr_env.h>
 
@@ -7,29 +10,42 @@
 
 using namespace std;
 
-extern cmt_io cmt_io_buf[];
 extern mpz_t mpz_buf[];
 extern int netBytesSent;
 extern int netBytesRecieved;
 
-void VerifierCompState::init(VerifierPrecomputation* precomp, int comp_state_id) {
+VerifierCompState::VerifierCompState() : allocated(false), trace(NULL), verbose(true) {
+}
+
+VerifierCompState::~VerifierCompState() {
+    deinit();
+}
+
+//(re)start the protocol for computation id. the buffers are allocated
+//the first time around and kept, so a state can be reused for any number
+//of computations of the same circuit. (the previous precomputation may
+//be gone by now, so the sizes come from io.)
+void VerifierCompState::init(VerifierPrecomputation* precomp, int id) {
+    if (allocated && (precomp->depth != io.depth || precomp->subcircuit->maxWidth() != io.maxWidth))
+        deinit();
+
     this->precomp = precomp;
-    this->comp_state_id = comp_state_id;
+    this->id = id;
     phase = SEND_INPUTS;
     successful = true;
-    mpz_init(a);
-    mpz_init(e);
-
-#ifdef USE_MPFQ
-    mpfq_p_25519_field_init(theField);
-    mpfq_p_25519_init(theField, &mpfq_e);
-    mpfq_p_25519_init(theField, &mpfq_a);
-    mpfq_p_25519_init(theField, &mpfq_tmp);
-#endif
 
-    m_sumcheck_modcmp = new double[precomp->depth - 1];
-    m_sumcheck_extrap = new double[precomp->depth - 1];
-    m_sumcheck_final = new double[precomp->depth - 1];
+    if (!allocated) {
+        mpz_init(a);
+        mpz_init(e);
+
+        init_cmt_io_at(&io, precomp->subcircuit->maxWidth(), precomp->depth);
+
+        m_sumcheck_modcmp = new double[precomp->depth - 1];
+        m_sumcheck_extrap = new double[precomp->depth - 1];
+        m_sumcheck_final = new double[precomp->depth - 1];
+        allocated = true;
+    }
+
     for (int i = 0; i < precomp->depth - 1; i++) {
         m_sumcheck_modcmp[i] = 0;
         m_sumcheck_extrap[i] = 0;
@@ -38,119 +54,231 @@ void VerifierCompState::init(VerifierPrecomputation* precomp, int comp_state_id)
     m_setup = 0, m_mlext_input = 0, m_mlext_output = 0;
 }
 
+void VerifierCompState::deinit(void) {
+    if (!allocated)
+        return;
+
+    mpz_clear(a);
+    mpz_clear(e);
+
+    free_cmt_io(&io);
+
+    delete[] m_sumcheck_modcmp;
+    delete[] m_sumcheck_extrap;
+    delete[] m_sumcheck_final;
+    allocated = false;
+}
+
+//keep a copy of a message (in mpz_buf) exchanged with the prover. false
+//(and nothing is kept) if its header doesn't fit io.
+bool VerifierCompState::recordIO(prover_request request) {
+    return put_cmt_io_at(&io, mpz_buf, request);
+}
+
+bool VerifierCompState::isDone(void) const {
+    return phase == PROTOCOL_DONE;
+}
+
+//a message from the prover (in mpz_buf, if P is sending) is checked; a
+//request is answered in mpz_buf. either way, the message is recorded once
+//it has passed the checks.
+//false if the message is malformed or out of turn: then the computation
+//is over, and failed (see fail()).
+bool VerifierCompState::handle(prover_request request) {
+    if (phase == PROTOCOL_DONE)
+        return false;
+
+    bool ok = false;
+    if (verifierSendsOn(request)) {
+        if (trace != NULL && request.requestType == CMT_INPUT)
+            trace->recordCoins(request.id, *precomp);
+
+        switch (request.requestType) {
+        case CMT_INPUT:
+            ok = generateInputs(request);
+            break;
+        case CMT_Q0:
+            ok = sendQ0(request);
+            break;
+        case CMT_R:
+            ok = sendNextR(request);
+            break;
+        case CMT_TAU:
+            ok = sendNextT(request);
+            break;
+        case CMT_QI:
+            ok = sendNextQI(request);
+            break;
+        }
+        if (ok)
+            ok = recordIO(request);
+        if (ok && trace != NULL)
+            trace->record(request);
+    }
+
+    else if (verifierRecievesOn(request)) {
+        if (!inTurn(request)) {
+            cout << "ERROR: prover sent " << requestToStr(request.requestType)
+                 << " (layer " << request.layer << ", round " << request.round
+                 << ", " << request.howMany << " elts) in phase " << phaseToStr(phase) << endl;
+            fail("bad message from the prover");
+            return false;
+        }
+        //the elements are already in mpz_buf.
+        if (!recordIO(request)) {
+            fail("bad message from the prover");
+            return false;
+        }
+        if (trace != NULL)
+            trace->record(request);
+
+        switch (request.requestType) {
+        case CMT_OUTPUT:
+            ok = checkOutputs(request);
+            break;
+        case CMT_F012:
+            ok = checkF012(request);
+            break;
+        case CMT_H:
+            ok = checkH(request);
+            break;
+        }
+    }
+
+    else
+        cout << "ERROR: Invalid requestType in header" << endl;
+
+    if (!ok)
+        fail("bad message from the prover");
+    return ok;
+}
+
+//whether a message from the prover is the one this computation waits
+//for: the right phase, layer, round and number of elements. checked
+//before the message is recorded, so a bad header never indexes io.
+bool VerifierCompState::inTurn(prover_request request) const {
+    switch (request.requestType) {
+    case CMT_OUTPUT:
+        return phase == CHECK_OUTPUTS && request.howMany == precomp->layerSizes[0];
+    case CMT_F012:
+        return phase == CHECK_F012 && request.layer == currLayer
+            && request.round == currRound && request.howMany == 3;
+    case CMT_H:
+        //H comes after currLayer has moved on (see checkH()).
+        return phase == CHECK_H && request.layer == currLayer - 1
+            && request.howMany == precomp->logLayerSizes[currLayer] + 1;
+    default:
+        return false;
+    }
+}
+
+//the prover went away, or started over, before the protocol was done.
+void VerifierCompState::abandon(void) {
+    if (phase != PROTOCOL_DONE)
+        fail("abandoned by the prover");
+}
+
+//give up on the computation.
+void VerifierCompState::fail(const char* why) {
+    successful = false;
+    phase = PROTOCOL_DONE;
+    if (verbose)
+        cout << "**VERIFICATION FAILED [" << id << "] ** (" << why << ")" << endl;
+}
+
 //check the request is valid, etc.
-//then retrieve from cmt_io_buf.
+//then retrieve from io.
 //do whatever computation is nessescary:
 //checkoutputs: compute and set a,e = mlext of evalutor at q0
 
-void VerifierCompState::checkOutputs(prover_request request) {
+bool VerifierCompState::checkOutputs(prover_request request) {
 
     //check valid request, phase, etc.
     int outputSize = precomp->layerSizes[0];
        //    cout << "Phase: " << phase << endl;
     if (phase != CHECK_OUTPUTS || request.howMany != outputSize) {
-        cout << "ERROR: prover sent outputs at unexpected time, or wrong # of outputs. exiting. " << endl;
-        exit(1);
+        cout << "ERROR: prover sent outputs at unexpected time, or wrong # of outputs." << endl;
+        return false;
     }
 
+    //compute a0 = V_0(q0), the m.lext. of the evaluator poly. of the outputs.
+#ifdef USE_NATIVE_FIELD
     //copy in the purported outputs
+    fpVals.resize(outputSize);
+    for (int i = 0; i < outputSize; i++)
+        fpVals[i].set(io.output[i]);
+#else
     outputs.resize(outputSize);
-
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt* mpfq_outputs= new mpfq_p_25519_elt[outputSize];
-    mpfq_p_25519_elt* mpfq_chis = new mpfq_p_25519_elt[outputSize];
-#endif
-
     for (int i = 0; i < outputSize; i++) {
-        mpz_set(outputs[i], cmt_io_buf[comp_state_id].output[i]);
+        mpz_set(outputs[i], io.output[i]);
     }
+#endif
 
-    //compute a0 = V_0(q0), the m.lext. of the evaluator poly. of the outputs.
-    MPZVector chis(outputSize);
-
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-
-    for (int _i = 0; _i < NREPS; _i++) {
-        computeChiAll(chis, precomp->qi[0], precomp->subcircuit->prime);
+    //the chis come precomputed, if the precomputation has weights.
+    const WeightVector* chis = &precomp->chiOut;
+    if (!precomp->hasWeights) {
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+#ifdef USE_NATIVE_FIELD
+        toField(fpPoint, precomp->qi[0]);
+        fpChis.resize(outputSize);
+        computeChiAll(fpChis, fpPoint);
+        chis = &fpChis;
+#else
+        mpzChis.resize(outputSize);
+        computeChiAll(mpzChis, precomp->qi[0], precomp->subcircuit->prime);
+        chis = &mpzChis;
+#endif
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
+        m_setup +=( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
     }
 
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_setup +=( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
-
-#ifdef USE_MPFQ
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+#ifdef USE_NATIVE_FIELD
+    fp_a = FieldElt();
     for (int i = 0; i < outputSize; i++) {
-        mpfq_p_25519_init(theField, &mpfq_outputs[i]);
-        mpfq_p_25519_init(theField, &mpfq_chis[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_outputs[i], outputs[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_chis[i], chis[i]);
+        fp_a += fpVals[i] * (*chis)[i];
     }
-#endif
-
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    for (int _i = 0; _i < NREPS; _i++) {
-#ifdef USE_MPFQ
-        mpfq_p_25519_set_ui(theField, mpfq_a, 0);
-        for (int i = 0; i < outputSize; i++) {
-            mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_outputs[i], mpfq_chis[i]);
-            mpfq_p_25519_add(theField, mpfq_a, mpfq_a, mpfq_tmp);
-        }
 #else
-        mpz_set_ui(a, 0);
-        for (int i = 0; i < outputSize; i++) {
-            mpz_addmul(a, outputs[i], chis[i]);
-        }
-        mpz_mod(a, a, precomp->subcircuit->prime);
-#endif
+    mpz_set_ui(a, 0);
+    for (int i = 0; i < outputSize; i++) {
+        mpz_addmul(a, outputs[i], (*chis)[i]);
     }
+    mpz_mod(a, a, precomp->subcircuit->prime);
+#endif
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_mlext_output =( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+    m_mlext_output =( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
-
-#ifdef USE_MPFQ
-    mpfq_p_25519_set(theField, mpfq_e, mpfq_a);
+#ifdef USE_NATIVE_FIELD
+    fp_e = fp_a;
 #else
     mpz_set(e, a);
 #endif
 
-
-#ifdef USE_MPFQ
-    for (int i = 0; i < outputSize; i++) {
-        mpfq_p_25519_clear(theField, &mpfq_outputs[i]);
-        mpfq_p_25519_clear(theField, &mpfq_chis[i]);
-    }
-    free(mpfq_outputs);
-    free(mpfq_chis);
-#endif
-
     //ready to start sumcheck protocol.
     phase = SEND_Q0;
-
-
+    return true;
 }
 
 //check update e, state.
-void VerifierCompState::checkF012(prover_request request) {
+bool VerifierCompState::checkF012(prover_request request) {
     if (phase != CHECK_F012 || request.round != currRound || request.layer != currLayer) {
         cout << "ERROR: prover sent sumcheck round response at unexpected time. " << endl;
         cout << "requested/curr round: " << request.round << "/" << currRound << endl;
         cout << "requested/curr layer: " << request.layer << "/" << currLayer << endl;
         cout << "phase/expected phase: " << phaseToStr(phase) << "/" << phaseToStr(CHECK_F012) << endl;
-
-        exit(1);
+        return false;
     }
 
     //copy in prover's output
     MPZVector F012(3);
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt mpfq_f012[3];
-#endif
     for (int i = 0; i < 3; i++) {
-        mpz_set(F012[i], cmt_io_buf[comp_state_id].layer_io[request.layer].F012[request.round][i]);
-#ifdef USE_MPFQ
-        mpfq_p_25519_init(theField, &mpfq_f012[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_f012[i], F012[i]);
-#endif
+        mpz_set(F012[i], io.layer_io[request.layer].F012[request.round][i]);
     }
+#ifdef USE_NATIVE_FIELD
+    FieldElt fp_f012[3], fp_tmp;
+    for (int i = 0; i < 3; i++)
+        fp_f012[i].set(F012[i]);
+#endif
 
     //check e == F[0] + F[1]
     mpz_t prime;
@@ -165,93 +293,95 @@ void VerifierCompState::checkF012(prover_request request) {
     bool err = false;
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    for (int _i = 0; _i < NREPS; _i++) {
-#ifndef USE_MPFQ
-        mpz_add(tmp, F012[0], F012[1]);
-        mpz_sub(e0, e, tmp);
-        if ( !mpz_divisible_p(e0, prime) ) {
-            err = true;
-        }
+#ifndef USE_NATIVE_FIELD
+    mpz_add(tmp, F012[0], F012[1]);
+    mpz_sub(e0, e, tmp);
+    if ( !mpz_divisible_p(e0, prime) ) {
+        err = true;
+    }
 #else
-        mpfq_p_25519_add(theField, mpfq_tmp, mpfq_f012[0], mpfq_f012[1]);
-        if ( mpfq_p_25519_cmp(theField, mpfq_e, mpfq_tmp) ) {
-            err = true;
-        }
-#endif //USE_MPFQ
+    fp_tmp = fp_f012[0] + fp_f012[1];
+    if (fp_e != fp_tmp) {
+        err = true;
     }
+#endif //USE_NATIVE_FIELD
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_sumcheck_modcmp[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+    m_sumcheck_modcmp[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
     if (err) {
         cout << "ERROR: F[0] + F[1] != e" << endl;
-#ifdef USE_MPFQ
-        cout << "Expected: ";
-        mpfq_p_25519_print(theField, mpfq_e);
-        cout << " but got ";
-        mpfq_p_25519_print(theField, mpfq_tmp);
-        cout << endl;
-#else
+#ifdef USE_NATIVE_FIELD
+        fp_e.get(e0);
+        fp_tmp.get(tmp);
+#endif
         char *e_str = mpz_get_str(NULL, 16, e0);
         char *tmp_str = mpz_get_str(NULL, 16, tmp);
         cout << "Expected 0x" << e_str << " but got 0x" << tmp_str << endl;
         free(e_str);
         free(tmp_str);
-#endif
         cout << "current layer: " << currLayer << endl;
         cout << "current round: " << currRound << endl;
         successful = false;
     }
 
+    mpz_clear(prime);
+    mpz_clear(e0);
+    mpz_clear(tmp);
+
     mpz_t rj;
     mpz_init(rj);
     mpz_set(rj, precomp->ri[currLayer][currRound]);
 
 #ifndef USE_FJM1
     //now compute F012(rj)
-    MPZVector weights(3);
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt mpfq_weights[3];
+    //this round's weights start 3 * currRound into fWeights, if precomputed.
+    const WeightVector* weights = &precomp->fWeights[currLayer];
+    int w0 = 3 * currRound;
+    if (!precomp->hasWeights) {
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+#ifdef USE_NATIVE_FIELD
+        FieldElt fp_rj(rj);
+        bary_precompute_weights3(fpWeights, fp_rj);
+        weights = &fpWeights;
+#else
+        mpzWeights.resize(3);
+        bary_precompute_weights3(mpzWeights, rj, precomp->subcircuit->prime);
+        weights = &mpzWeights;
 #endif
-
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    for (int _i = 0; _i < NREPS; _i++) {
-        bary_precompute_weights3(weights, rj, precomp->subcircuit->prime);
+        w0 = 0;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
+        m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
     }
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
-
-#ifdef USE_MPFQ
-    for (int i = 0; i < 3; i++) {
-        mpfq_p_25519_init(theField, &mpfq_weights[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_weights[i], weights[i]);
-    }
-#endif
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
 
 
 
-    for (int _i = 0; _i < NREPS; _i++) {
-#ifndef USE_MPFQ
-        mpz_mul(e, F012[0], weights[0]);
-        mpz_addmul(e, F012[1], weights[1]);
-        mpz_addmul(e, F012[2], weights[2]);
+#ifndef USE_NATIVE_FIELD
+    mpz_mul(e, F012[0], (*weights)[w0]);
+    mpz_addmul(e, F012[1], (*weights)[w0 + 1]);
+    mpz_addmul(e, F012[2], (*weights)[w0 + 2]);
 #else
-        mpfq_p_25519_mul(theField, mpfq_e, mpfq_f012[0], mpfq_weights[0]);
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_f012[1], mpfq_weights[1]);
-        mpfq_p_25519_add(theField, mpfq_e, mpfq_e, mpfq_tmp);
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_f012[2], mpfq_weights[2]);
-        mpfq_p_25519_add(theField, mpfq_e, mpfq_e, mpfq_tmp);
+    fp_e = fp_f012[0] * (*weights)[w0] + fp_f012[1] * (*weights)[w0 + 1] + fp_f012[2] * (*weights)[w0 + 2];
 #endif
-    }
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_sumcheck_extrap[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+    m_sumcheck_extrap[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
 #else
     // quick and dirty way of computing e from fj(-1), fj(0), and fj(1)
     // this should be optimized as possible.
     // Also right now "half" assumes that p = 2^61 - 1 !
 
+#ifdef USE_NATIVE_FIELD
+    const FieldElt fp_rj(rj);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+    const FieldElt c2 = (fp_f012[2] + fp_f012[1]).half() - fp_f012[0];
+    const FieldElt c1 = (fp_f012[1] - fp_f012[2]).half();
+    fp_e = fp_f012[0] + c1 * fp_rj + c2 * fp_rj * fp_rj;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
+    m_sumcheck_extrap[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
+#else
     mpz_t c1, c2, half, rj_squared;
     mpz_init(c1);
     mpz_init(c2);
@@ -265,47 +395,40 @@ void VerifierCompState::checkF012(prover_request request) {
     // compute c2
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    for (int _i = 0; _i < NREPS; _i++) {
-        mpz_add(c2, F012[2], F012[1]);
-        mpz_mul(c2, c2, half);
-        mpz_sub(c2, c2, F012[0]);
-        mpz_mod(c2, c2, precomp->subcircuit->prime);
-
-        // compute c1
-        mpz_sub(c1, F012[1], F012[2]);
-        mpz_mul(c1, c1, half);
-        mpz_mod(c1, c1, precomp->subcircuit->prime);
-
-        // compute f_j(rj)
-        mpz_set(e, F012[0]);
-        mpz_addmul(e, c1, rj);
-        mpz_mul(rj_squared, rj, rj);
-        mpz_addmul(e, c2, rj_squared);
-        mpz_mod(e, e, precomp->subcircuit->prime);
-    }
+    mpz_add(c2, F012[2], F012[1]);
+    mpz_mul(c2, c2, half);
+    mpz_sub(c2, c2, F012[0]);
+    mpz_mod(c2, c2, precomp->subcircuit->prime);
+
+    // compute c1
+    mpz_sub(c1, F012[1], F012[2]);
+    mpz_mul(c1, c1, half);
+    mpz_mod(c1, c1, precomp->subcircuit->prime);
+
+    // compute f_j(rj)
+    mpz_set(e, F012[0]);
+    mpz_addmul(e, c1, rj);
+    mpz_mul(rj_squared, rj, rj);
+    mpz_addmul(e, c2, rj_squared);
+    mpz_mod(e, e, precomp->subcircuit->prime);
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_sumcheck_extrap[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+    m_sumcheck_extrap[currLayer] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
     mpz_clear(half);
     mpz_clear(c1);
     mpz_clear(c2);
     mpz_clear(rj_squared);
+#endif //USE_NATIVE_FIELD
 #endif
 
     mpz_clear(rj);
 
-#ifdef USE_MPFQ
-    for (int i = 0; i < 3; i++) {
-        mpfq_p_25519_clear(theField, &mpfq_f012[i]);
-        mpfq_p_25519_clear(theField, &mpfq_weights[i]);
-    }
-#endif
-
     //OK sending the next random el.
     phase = SEND_NEXT_R;
+    return true;
 }
 
-void VerifierCompState::checkH(prover_request request) {
+bool VerifierCompState::checkH(prover_request request) {
     //note: This check happens at the end of the sumcheck protocol,
     //after currLayer has already been incremented.  But the number of
     //H coefficients is supposed to be equal to log(numINPUTS) to the
@@ -313,21 +436,17 @@ void VerifierCompState::checkH(prover_request request) {
     int numHcoeffs = precomp->logLayerSizes[currLayer] + 1;
     if (phase != CHECK_H || request.howMany != numHcoeffs) {
         cout << "ERROR: prover sent H poly. at unexpected time, or wrong # of coefficients." << endl;
-        exit(1);
+        return false;
     }
 
     //copy in prover's output
     MPZVector H(numHcoeffs);
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt * mpfq_H = new mpfq_p_25519_elt[numHcoeffs];
-#endif
     for (int i = 0; i < numHcoeffs; i++) {
-        mpz_set(H[i], cmt_io_buf[comp_state_id].layer_io[request.layer].H[i]);
-#ifdef USE_MPFQ
-        mpfq_p_25519_init(theField, &mpfq_H[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_H[i], H[i]);
-#endif
+        mpz_set(H[i], io.layer_io[request.layer].H[i]);
     }
+#ifdef USE_NATIVE_FIELD
+    toField(fpVals, H);
+#endif
 
     //compute next layer's a, assuming V(w1) = v1 = H[0], V(w2) = v2 = H[1].
     mpz_t v1, v2;
@@ -341,70 +460,57 @@ void VerifierCompState::checkH(prover_request request) {
 
     //minus 1 because of note above.
 
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt mpfq_v1, mpfq_v2, mpfq_mul, mpfq_add, mpfq_sub, mpfq_muxl, mpfq_muxr;
-    mpfq_p_25519_init(theField, &mpfq_v1); mpfq_p_25519_set_mpz(theField, mpfq_v1, v1);
-    mpfq_p_25519_init(theField, &mpfq_v2); mpfq_p_25519_set_mpz(theField, mpfq_v2, v2);
-    mpfq_p_25519_init(theField, &mpfq_mul); mpfq_p_25519_set_mpz(theField, mpfq_mul, precomp->mul[currLayer-1]);
-    mpfq_p_25519_init(theField, &mpfq_add); mpfq_p_25519_set_mpz(theField, mpfq_add, precomp->add[currLayer-1]);
-    mpfq_p_25519_init(theField, &mpfq_sub); mpfq_p_25519_set_mpz(theField, mpfq_sub, precomp->sub[currLayer-1]);
-    mpfq_p_25519_init(theField, &mpfq_muxl); mpfq_p_25519_set_mpz(theField, mpfq_muxl, precomp->muxl[currLayer-1]);
-    mpfq_p_25519_init(theField, &mpfq_muxr); mpfq_p_25519_set_mpz(theField, mpfq_muxr, precomp->muxr[currLayer-1]);
+#ifdef USE_NATIVE_FIELD
+    const FieldElt fp_v1 = fpVals[0], fp_v2 = fpVals[1];
+    const FieldElt fp_mul(precomp->mul[currLayer - 1]);
+    const FieldElt fp_add(precomp->add[currLayer - 1]);
+    const FieldElt fp_sub(precomp->sub[currLayer - 1]);
+    const FieldElt fp_muxl(precomp->muxl[currLayer - 1]);
+    const FieldElt fp_muxr(precomp->muxr[currLayer - 1]);
 #endif
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
 
     bool err = false;
-    for (int _i = 0; _i < NREPS; _i++) {
-#ifdef USE_MPFQ
-        mpfq_p_25519_add(theField, mpfq_a, mpfq_v1, mpfq_v2);
-        mpfq_p_25519_mul(theField, mpfq_a, mpfq_a, mpfq_add);
-
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_v1, mpfq_v2);
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_tmp, mpfq_mul);
-
-        mpfq_p_25519_add(theField, mpfq_a, mpfq_a, mpfq_tmp);
+#ifdef USE_NATIVE_FIELD
+    fp_a = (fp_v1 + fp_v2) * fp_add;
+    fp_a += fp_v1 * fp_v2 * fp_mul;
+    fp_a += (fp_v1 - fp_v2) * fp_sub;
+    fp_a += fp_v1 * fp_muxl;
+    fp_a += fp_v2 * fp_muxr;
 
-        mpfq_p_25519_sub(theField, mpfq_tmp, mpfq_v1, mpfq_v2);
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_tmp, mpfq_sub);
-
-        mpfq_p_25519_add(theField, mpfq_a, mpfq_a, mpfq_tmp);
-
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_v1, mpfq_muxl);
-        mpfq_p_25519_add(theField, mpfq_a, mpfq_a, mpfq_tmp);
-
-        mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_v2, mpfq_muxr);
-        mpfq_p_25519_add(theField, mpfq_a, mpfq_a, mpfq_tmp);
-
-        if (mpfq_p_25519_cmp(theField, mpfq_a, mpfq_e)) {
-            err = true;
-        }
+    if (fp_a != fp_e) {
+        err = true;
+    }
 #else
-        mpz_add(a, v1, v2);
-        mpz_mul(a, a, precomp->add[currLayer - 1]);
-
-        mpz_mul(tmp1, v1, v2);
-        mpz_addmul(a, tmp1, precomp->mul[currLayer -1]);
+    mpz_add(a, v1, v2);
+    mpz_mul(a, a, precomp->add[currLayer - 1]);
 
-        mpz_sub(tmp1, v1, v2);
-        mpz_addmul(a, tmp1, precomp->sub[currLayer - 1]);
+    mpz_mul(tmp1, v1, v2);
+    mpz_addmul(a, tmp1, precomp->mul[currLayer -1]);
 
-        mpz_addmul(a, v1, precomp->muxl[currLayer - 1]);
-        mpz_addmul(a, v2, precomp->muxr[currLayer - 1]);
+    mpz_sub(tmp1, v1, v2);
+    mpz_addmul(a, tmp1, precomp->sub[currLayer - 1]);
 
-        mpz_sub(a, a, e);
+    mpz_addmul(a, v1, precomp->muxl[currLayer - 1]);
+    mpz_addmul(a, v2, precomp->muxr[currLayer - 1]);
 
-        if ( !mpz_divisible_p(a, precomp->subcircuit->prime) ) {
-            err = true;
-        }
+    mpz_sub(a, a, e);
 
-#endif //USE_MPFQ
+    if ( !mpz_divisible_p(a, precomp->subcircuit->prime) ) {
+        err = true;
     }
+
+#endif //USE_NATIVE_FIELD
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_sumcheck_final[currLayer - 1] +=  ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+    m_sumcheck_final[currLayer - 1] +=  ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
     if (err) {
         cout << "ERROR: a' != e at final round of sumcheck, layer " << currLayer - 1 << endl;
+#ifdef USE_NATIVE_FIELD
+        fp_e.get(e);
+        fp_a.get(a);
+#endif
         char *e_str = mpz_get_str(NULL, 16, e);
         char *a_str = mpz_get_str(NULL, 16, a);
         cout << "Expected 0x" << e_str << " but got 0x" << a_str << endl;
@@ -417,62 +523,50 @@ void VerifierCompState::checkH(prover_request request) {
     mpz_t tau;
     mpz_init_set(tau, precomp->tau[currLayer - 1]);
 
-    MPZVector weights(numHcoeffs);
+    const WeightVector* weights = &precomp->hWeights[currLayer - 1];
+    if (!precomp->hasWeights) {
+        MPZVector tauWeights(numHcoeffs);
 
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt * mpfq_weights = new mpfq_p_25519_elt[numHcoeffs];
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+        bary_precompute_weights(tauWeights, tau, precomp->subcircuit->prime);
+#ifdef USE_NATIVE_FIELD
+        toField(fpWeights, tauWeights);
+        weights = &fpWeights;
+#else
+        mpzWeights.resize(numHcoeffs);
+        for (int i = 0; i < numHcoeffs; i++)
+            mpz_set(mpzWeights[i], tauWeights[i]);
+        weights = &mpzWeights;
 #endif
-
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    for (int _i = 0; _i < NREPS; _i++) {
-        bary_precompute_weights(weights, tau, precomp->subcircuit->prime);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
+        m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
     }
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
-
-#ifdef USE_MPFQ
-    for (int i = 0; i < numHcoeffs; i++) {
-        mpfq_p_25519_init(theField, &mpfq_weights[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_weights[i], weights[i]);
-    }
-#endif
 
+#ifdef USE_NATIVE_FIELD
+    FieldEltVector fp_avec(1);
+#else
     MPZVector avec(1);
+#endif
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-#ifdef USE_MPFQ
-    for (int _i = 0; _i < NREPS; _i++) {
-        mpfq_p_25519_set_ui(theField, mpfq_a, 0);
-        for (int i = 0; i < numHcoeffs; i++) {
-            mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_H[i], mpfq_weights[i]);
-            mpfq_p_25519_add(theField, mpfq_a, mpfq_a, mpfq_tmp);
-        }
-    }
+#ifdef USE_NATIVE_FIELD
+    bary_extrap(fp_avec, fpVals, *weights);
 #else
-    for (int _i = 0; _i < NREPS; _i++) {
-        bary_extrap(avec, H, weights, precomp->subcircuit->prime);
-    }
+    bary_extrap(avec, H, *weights, precomp->subcircuit->prime);
 #endif
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
 
-    m_sumcheck_final[currLayer - 1] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec )/ (double) NREPS;
+    m_sumcheck_final[currLayer - 1] += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
-#ifdef USE_MPFQ
-    mpfq_p_25519_set(theField, mpfq_e, mpfq_a);
+#ifdef USE_NATIVE_FIELD
+    fp_a = fp_avec[0];
+    fp_e = fp_a;
 #else
     mpz_set(a, avec[0]);
     mpz_set(e, a);
 #endif
 
-#ifdef USE_MPFQ
-    for (int i = 0; i < numHcoeffs; i++) {
-        mpfq_p_25519_clear(theField, &mpfq_H[i]);
-        mpfq_p_25519_clear(theField, &mpfq_weights[i]);
-    }
-    free(mpfq_H);
-    free(mpfq_weights);
-#endif
-
+    mpz_clear(tau);
     mpz_clear(v1), mpz_clear(v2), mpz_clear(tmp1), mpz_clear(tmp2), mpz_clear(tmp3);
     if (currLayer == (precomp->depth) - 1 ) {
         doFinalCheck();
@@ -481,72 +575,67 @@ void VerifierCompState::checkH(prover_request request) {
     else {
         phase = SEND_NEXT_QI_OR_TAU;
     }
-
-
+    return true;
 }
 
 //check that a_d  = Vd(qd), i.e. compute the mlext. of the inputs at the last q.
 void VerifierCompState::doFinalCheck() {
     int inputLayerSize = precomp->layerSizes[precomp->depth - 1];
-    MPZVector chis(inputLayerSize);
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
-    for (int _i = 0; _i < NREPS; _i++) {
-        computeChiAll(chis, precomp->qi[precomp->depth - 1], precomp->subcircuit->prime);
-    }
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
-
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt* mpfq_inputs= new mpfq_p_25519_elt[inputLayerSize];
-    mpfq_p_25519_elt* mpfq_chis = new mpfq_p_25519_elt[inputLayerSize];
-
-    for (int i = 0; i < inputLayerSize; i++) {
-        mpfq_p_25519_init(theField, &mpfq_inputs[i]);
-        mpfq_p_25519_init(theField, &mpfq_chis[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_inputs[i], inputs[i]);
-        mpfq_p_25519_set_mpz(theField, mpfq_chis[i], chis[i]);
-    }
+    const WeightVector* chis = &precomp->chiIn;
+    if (!precomp->hasWeights) {
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+#ifdef USE_NATIVE_FIELD
+        toField(fpPoint, precomp->qi[precomp->depth - 1]);
+        fpChis.resize(inputLayerSize);
+        computeChiAll(fpChis, fpPoint);
+        chis = &fpChis;
+#else
+        mpzChis.resize(inputLayerSize);
+        computeChiAll(mpzChis, precomp->qi[precomp->depth - 1], precomp->subcircuit->prime);
+        chis = &mpzChis;
 #endif
-
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
+        m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
+    }
 
     mpz_t ans;
     mpz_init_set_ui(ans, 0);
 
-#ifdef USE_MPFQ
-    mpfq_p_25519_elt mpfq_ans;
-    mpfq_p_25519_init(theField, &mpfq_ans);
+#ifdef USE_NATIVE_FIELD
+    FieldElt fp_ans;
 #endif
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
 
     bool err = false;
-    for (int _i = 0; _i < NREPS; _i++) {
-#ifdef USE_MPFQ
-        mpfq_p_25519_set_ui(theField, mpfq_ans, 0);
-        for (int i = 0; i < inputLayerSize; i++) {
-            mpfq_p_25519_mul(theField, mpfq_tmp, mpfq_inputs[i], mpfq_chis[i]);
-            mpfq_p_25519_add(theField, mpfq_ans, mpfq_ans, mpfq_tmp);
-        }
+#ifdef USE_NATIVE_FIELD
+    fp_ans = FieldElt();
+    for (int i = 0; i < inputLayerSize; i++) {
+        fp_ans += fpInputs[i] * (*chis)[i];
+    }
 
-        if (mpfq_p_25519_cmp(theField, mpfq_ans, mpfq_a) != 0) {
-            err = true;
-        }
+    if (fp_ans != fp_a) {
+        err = true;
+    }
 #else
-        mpz_set_ui(ans, 0);
-        for (int i = 0; i < inputLayerSize; i++) {
-            mpz_addmul(ans, inputs[i], chis[i]);
-        }
-        mpz_mod(ans, ans, precomp->subcircuit->prime);
+    mpz_set_ui(ans, 0);
+    for (int i = 0; i < inputLayerSize; i++) {
+        mpz_addmul(ans, inputs[i], (*chis)[i]);
+    }
+    mpz_mod(ans, ans, precomp->subcircuit->prime);
 
-        if (mpz_cmp(ans, a) != 0) {
-            err = true;
-        }
-#endif
+    if (mpz_cmp(ans, a) != 0) {
+        err = true;
     }
+#endif
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t2);
-    m_mlext_input = ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+    m_mlext_input = ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
+#ifdef USE_NATIVE_FIELD
+    fp_ans.get(ans);
+    fp_a.get(a);
+#endif
     if (err) {
         cout << "ERROR: Final check (m.l. ext. of inputs) failed: a_d != Vd(qd). " << endl;
         char *e_str = mpz_get_str(NULL, 16, ans);
@@ -557,23 +646,18 @@ void VerifierCompState::doFinalCheck() {
         free(a_str);
     }
 
-#ifdef USE_MPFQ
-    for (int i = 0; i < inputLayerSize; i++) {
-        mpfq_p_25519_clear(theField, &mpfq_inputs[i]);
-        mpfq_p_25519_clear(theField, &mpfq_chis[i]);
-    }
-    free(mpfq_inputs);
-    free(mpfq_chis);
-#endif
-
-    if (successful)
-        cout << endl << endl << "**VERIFICATION SUCCESSFUL [" << comp_state_id << "] **" << endl;
-    else
-        cout << "**VERIFICATION FAILED [" << comp_state_id << "] **" << endl;
 
     mpz_clear(ans);
 
-    printStats();
+    if (verbose) {
+        if (successful)
+            cout << endl << endl << "**VERIFICATION SUCCESSFUL [" << id << "] **" << endl;
+        else
+            cout << "**VERIFICATION FAILED [" << id << "] **" << endl;
+
+        printStats();
+    }
+    phase = PROTOCOL_DONE;
 
 
 }
@@ -587,49 +671,33 @@ void VerifierCompState::doFinalCheck() {
 
 //check request.howMany = totalnuminputs, it's the right phase, etc.
 //generate the inputs and put them in the mpz_buf.
-void VerifierCompState::generateInputs(prover_request request) {
+bool VerifierCompState::generateInputs(prover_request request) {
     int inputSize = precomp->layerSizes[precomp->depth - 1];
     inputs.resize(precomp->layerSizes[precomp->depth - 1]);
     if (phase != SEND_INPUTS || request.howMany != inputSize) {
-        cout << "prover requested inputs at unexpected time, or wrong # of inputs. exiting." << endl;
-        exit(1);
+        cout << "ERROR: prover requested inputs at unexpected time, or wrong # of inputs." << endl;
+        return false;
     }
 #ifdef DEBUG
     cout << "generating inputs for computation id: " << request.id << endl;
 #endif
 
-    mpz_t tmp;
-    mpz_init(tmp);
-
-    //getInputSize returns the number of non-constant inputs to the
-    //computation
-    MPQVector vec(precomp->subcircuit->getInputSize());
-    for (size_t j = 0; j < vec.size(); j++)
-        mpq_set_ui(vec[j],  (10 + request.id) * (j + 1), 1);
-
-    //set the inputs to the computation, including the constants
-    precomp->subcircuit->initializeInputs(vec);
-
-    //now get the input layer and extract the full input, including
-    //constants.
-    CircuitLayer& inLayer = precomp->subcircuit->getInputLayer();
-
-    for (int j = 0; j < inLayer.size(); j++) {
-        inLayer.gate(j).getValue(tmp);
-        mpz_set(inputs[j], tmp);
-        mpz_set(mpz_buf[j], tmp);
-    }
+    computationInputs(precomp->subcircuit, request.id, inputs);
+    for (int j = 0; j < inputSize; j++)
+        mpz_set(mpz_buf[j], inputs[j]);
+#ifdef USE_NATIVE_FIELD
+    toField(fpInputs, inputs);
+#endif
 
-    mpz_clear(tmp);
     phase = CHECK_OUTPUTS;
-
+    return true;
 }
 
 //again, just check it's the right phase and #, etc., and put it in the buf.
-void VerifierCompState::sendQ0(prover_request request) {
+bool VerifierCompState::sendQ0(prover_request request) {
     if (phase != SEND_Q0 || request.howMany != (int) precomp->qi[0].size()) {
-        cout << "prover requested q0 at unexpected time, or wrong size specified for q0. exiting. " << endl;
-        exit(1);
+        cout << "ERROR: prover requested q0 at unexpected time, or wrong size specified for q0." << endl;
+        return false;
     }
     for (int i = 0; i < request.howMany; i++) {
         mpz_set(mpz_buf[i], precomp->qi[0][i]);
@@ -637,12 +705,13 @@ void VerifierCompState::sendQ0(prover_request request) {
     phase = CHECK_F012;
     currRound = 0;
     currLayer = 0;
+    return true;
 }
 
-void VerifierCompState::sendNextR(prover_request request) {
+bool VerifierCompState::sendNextR(prover_request request) {
     if (phase != SEND_NEXT_R || request.howMany != 1 || request.round != currRound || request.layer != currLayer) {
         cout << "ERROR: prover requested sumcheck random el. at wrong time" << endl;
-        exit(1);
+        return false;
     }
 
     mpz_set(mpz_buf[0], precomp->ri[currLayer][currRound]);
@@ -658,21 +727,22 @@ void VerifierCompState::sendNextR(prover_request request) {
         currLayer++;
         phase = CHECK_H;
     }
-
+    return true;
 }
-void VerifierCompState::sendNextT(prover_request request) {
+bool VerifierCompState::sendNextT(prover_request request) {
     if (phase != SEND_NEXT_QI_OR_TAU || request.howMany != 1 || request.layer != currLayer) {
         cout << "ERROR: Tau requested at wrong time" << endl;
-        exit(1);
+        return false;
     }
 
     mpz_set(mpz_buf[0], precomp->tau[currLayer - 1]);
     phase = CHECK_F012;
+    return true;
 }
-void VerifierCompState::sendNextQI(prover_request request) {
+bool VerifierCompState::sendNextQI(prover_request request) {
     if (phase != SEND_NEXT_QI_OR_TAU || request.howMany != (int) precomp->qi[currLayer].size() || request.layer != currLayer) {
         cout << "ERROR: q_i requested at wrong time" << endl;
-        exit(1);
+        return false;
     }
 
     for (int i = 0; i < request.howMany; i++) {
@@ -680,6 +750,7 @@ void VerifierCompState::sendNextQI(prover_request request) {
     }
 
     phase = CHECK_F012;
+    return true;
 }
 
 
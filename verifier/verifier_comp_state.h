@@ -5,16 +5,16 @@
    initialized with a VerifierPrecomp. 
 
    For the checking functions, after checking the request is valid and
-   made at the proper time, the relavent mpz's are copied from the
-   cmt_io_buf global variable, which is where the prover sends it's
-   (potentially untrustworthy) responses. 
+   made at the proper time (see inTurn()), the prover's (potentially
+   untrustworthy) response is recorded in the state's own cmt_io (see
+   recordIO()), and the relavent mpz's are copied from there.
 
    For the send functions, after checking the request is valid, the
    required values are copied into the mpz_buf array, which can be
    sent to the prover.
 
  */
-#include "mpfq/mpfq_p_25519.h"
+#include <gmp.h>
 extern "C" {
 #include "util.h"
 
@@ -22,6 +22,8 @@ extern "C" {
 
 #include "verifier_precomp.h"
 
+class VerifierTrace;
+
 
 #include <time.h>
 
@@ -33,32 +35,67 @@ class VerifierCompState {
     double  m_mlext_output, m_mlext_input, m_setup;
     double *m_sumcheck_modcmp, *m_sumcheck_extrap, *m_sumcheck_final;
 
-    void init(VerifierPrecomputation* precomp, int comp_state_id);
+    VerifierCompState();
+    ~VerifierCompState();
+
+    //can be called again (without deinit()) to reuse the state for
+    //another computation, once isDone().
+    void init(VerifierPrecomputation* precomp, int id);
+    void deinit(void);
+
+    bool recordIO(prover_request request);
+    bool isDone(void) const;
+    //once isDone(), whether every check passed.
+    bool succeeded(void) const { return successful; }
 
-    void checkOutputs(prover_request request);
-    void checkF012(prover_request request);
-    void checkH(prover_request request);
+    //generate/send or record/check, according to the request. false if
+    //the request is malformed or out of turn, which fails and ends the
+    //computation (isDone()) rather than the process.
+    bool handle(prover_request request);
+    //end the computation, as a failure, if it isn't done yet.
+    void abandon(void);
+    //record everything handled, and the coins, to trace (NULL: don't).
+    void setTrace(VerifierTrace* trace) { this->trace = trace; }
+    //whether to report each computation's outcome and runtimes.
+    void setVerbose(bool verbose) { this->verbose = verbose; }
 
-    void generateInputs(prover_request request);
-    void sendQ0(prover_request request);
-    void sendNextQI(prover_request request);
-    void sendNextT(prover_request request);          
-    void sendNextR(prover_request request);
+    bool checkOutputs(prover_request request);
+    bool checkF012(prover_request request);
+    bool checkH(prover_request request);
+
+    bool generateInputs(prover_request request);
+    bool sendQ0(prover_request request);
+    bool sendNextQI(prover_request request);
+    bool sendNextT(prover_request request);          
+    bool sendNextR(prover_request request);
 
     void doFinalCheck(void);
     void printStats(void);
  private:
+    bool inTurn(prover_request request) const;
+    void fail(const char* why);
+
     VerifierPrecomputation* precomp;
     MPZVector outputs;
     int currLayer;
     int currRound;
     int phase;
-    int comp_state_id;
+    int id;
+    bool allocated;
+    cmt_io io;
     mpz_t a, e;
     MPZVector inputs;
     bool successful;
-    mpfq_p_25519_field theField;
-    mpfq_p_25519_elt mpfq_e, mpfq_a;
-    mpfq_p_25519_elt mpfq_tmp; 
+    VerifierTrace* trace;
+    bool verbose;
+#ifdef USE_NATIVE_FIELD
+    //a and e as field elements, plus scratch vectors that are only
+    //allocated the first time round.
+    FieldElt fp_a, fp_e;
+    FieldEltVector fpInputs, fpVals, fpChis, fpPoint, fpWeights;
+#else
+    //chis and weights, when the precomputation doesn't have them.
+    MPZVector mpzChis, mpzWeights;
+#endif
     struct timespec t1, t2;
 };
@@ -2,7 +2,11 @@
 #include <crypto/prng.h>
 #include <iostream>
 #include <common/math.h>
+#include <common/poly_utils.h>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 using namespace std;
 
 extern Prng prng;
@@ -41,6 +45,7 @@ void VerifierPrecomputation::init(PWSCircuit* subcircuit) {
         ri[i-1].resize(2 * (*subcircuit)[i].logSize());
     }
     m_setup = 0;
+    hasWeights = false;
     initialized = true;
 
 }
@@ -53,6 +58,10 @@ void VerifierPrecomputation::deinit(void) {
 }
 
 void VerifierPrecomputation::flipAllCoins() {
+    flipAllCoins(prng);
+}
+
+void VerifierPrecomputation::flipAllCoins(Prng& prng) {
     if (!initialized) {
         cout << "ERROR: call init() on VerifierPrecompuation first" << endl;
         exit(1);
@@ -82,9 +91,11 @@ void VerifierPrecomputation::flipAllCoins() {
 
     }
 
-    //now compute qi's based on tau's, ri's.
-
+    computeQi();
+}
 
+//now compute qi's based on tau's, ri's.
+void VerifierPrecomputation::computeQi() {
     for (int i = 1; i < depth; i++) {
 
         int qiSize = qi[i].size();
@@ -133,12 +144,28 @@ void VerifierPrecomputation::computeAddMul(vector<bool> muxBits) {
         }
 
 
+#ifdef USE_NATIVE_FIELD
+        FieldEltVector fieldRand;
+        toField(fieldRand, rand);
+        FieldElt fieldAdd, fieldMul, fieldSub, fieldMuxl, fieldMuxr;
+#endif
+
         clock_gettime(CLOCK_REALTIME, &t1);
-        for (int _i = 0; _i < NREPS; _i++) {
-            (*subcircuit)[i].computeWirePredicates(add[i], mul[i], sub[i], muxl[i], muxr[i], muxBits, rand, inputLayerSize, subcircuit->prime);
-        }
+#ifdef USE_NATIVE_FIELD
+        (*subcircuit)[i].computeWirePredicates(fieldAdd, fieldMul, fieldSub, fieldMuxl, fieldMuxr, muxBits, fieldRand, inputLayerSize);
+#else
+        (*subcircuit)[i].computeWirePredicates(add[i], mul[i], sub[i], muxl[i], muxr[i], muxBits, rand, inputLayerSize, subcircuit->prime);
+#endif
         clock_gettime(CLOCK_REALTIME, &t2);
-        m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec ) / (double) NREPS;
+
+#ifdef USE_NATIVE_FIELD
+        fieldAdd.get(add[i]);
+        fieldMul.get(mul[i]);
+        fieldSub.get(sub[i]);
+        fieldMuxl.get(muxl[i]);
+        fieldMuxr.get(muxr[i]);
+#endif
+        m_setup += ( (t2.tv_sec - t1.tv_sec) * BILLION  + t2.tv_nsec - t1.tv_nsec );
 
 
 
@@ -169,3 +196,80 @@ void VerifierPrecomputation::computeAddMul(vector<bool> muxBits) {
     }
 
 }
+
+void VerifierPrecomputation::computeWeights() {
+    if (!initialized) {
+        cout << "ERROR: call init() on VerifierPrecompuation first" << endl;
+        exit(1);
+    }
+
+    chiOut.resize(layerSizes[0]);
+    chiIn.resize(layerSizes[depth - 1]);
+#ifdef USE_NATIVE_FIELD
+    FieldEltVector point;
+    toField(point, qi[0]);
+    computeChiAll(chiOut, point);
+    toField(point, qi[depth - 1]);
+    computeChiAll(chiIn, point);
+#else
+    computeChiAll(chiOut, qi[0], subcircuit->prime);
+    computeChiAll(chiIn, qi[depth - 1], subcircuit->prime);
+#endif
+
+    fWeights.resize(depth - 1);
+    hWeights.resize(depth - 1);
+    MPZVector weights(3);
+    for (int i = 0; i < depth - 1; i++) {
+        int numRounds = ri[i].size();
+        fWeights[i].resize(3 * numRounds);
+        for (int j = 0; j < numRounds; j++) {
+            weights.resize(3);
+            bary_precompute_weights3(weights, ri[i][j], subcircuit->prime);
+            for (int k = 0; k < 3; k++)
+                setWeight(fWeights[i][3 * j + k], weights[k]);
+        }
+
+        //one more coefficient than the next layer has variables.
+        int numHcoeffs = logLayerSizes[i + 1] + 1;
+        weights.resize(numHcoeffs);
+        bary_precompute_weights(weights, tau[i], subcircuit->prime);
+        hWeights[i].resize(numHcoeffs);
+        for (int k = 0; k < numHcoeffs; k++)
+            setWeight(hWeights[i][k], weights[k]);
+    }
+    hasWeights = true;
+}
+
+void VerifierPrecomputation::newMasterKey(uint8_t* masterKey) {
+    char* seed = getenv("CMT_SEED");
+    if (seed != NULL) {
+        memset(masterKey, 0, MASTER_KEY_BYTES);
+        memcpy(masterKey, seed, min(strlen(seed), (size_t) MASTER_KEY_BYTES));
+        return;
+    }
+
+    ifstream rand("/dev/urandom", ifstream::in | ifstream::binary);
+    rand.read((char*) masterKey, MASTER_KEY_BYTES);
+    if (!rand) {
+        cout << "ERROR: could not read /dev/urandom. exiting." << endl;
+        exit(1);
+    }
+}
+
+static_assert(MASTER_KEY_BYTES == CHACHA_KEY_SIZE / 8, "master key must be one ChaCha key");
+
+void VerifierPrecomputation::precomputeInstance(PWSCircuit* subcircuit, const vector<bool>& muxBits,
+                                                const uint8_t* masterKey, int instance) {
+    u8 key[CHACHA_KEY_SIZE / 8];
+    u8 iv[CHACHA_IV_SIZE / 8];
+    memcpy(key, masterKey, sizeof(key));
+
+    //the nonce is the instance number, little-endian.
+    for (size_t b = 0; b < sizeof(iv); b++)
+        iv[b] = ((uint64_t) instance >> (8 * b)) & 0xff;
+    Prng stream(PNG_CHACHA, key, iv);
+
+    init(subcircuit);
+    flipAllCoins(stream);
+    computeAddMul(muxBits);
+}
@@ -6,17 +6,50 @@
  of V's randomness, and precomputes the multilinear extensions of add
  and mul at each layer.
 
+ precomputeInstance() draws instance i's coins from its own ChaCha
+ stream, keyed with a master key and using i as the nonce, so instances
+ can be precomputed on any number of threads, in any order, with the
+ same result (see VerifierPrecompQueue).
+
  */
 
 #pragma once
 
 #include <circuit/pws_circuit.h>
 #include <vector>
+#include <stdint.h>
 
 extern "C" {
 #include "util.h"
 }
 #include <time.h>
+
+#ifdef USE_NATIVE_FIELD
+#include <common/fp25519.h>
+#include <common/fp61.h>
+
+//the fixed-width element type for the prime chosen in util.h
+#ifdef USE_P25519
+typedef Fp25519 FieldElt;
+#else
+typedef Fp61 FieldElt;
+#endif
+typedef std::vector<FieldElt> FieldEltVector;
+
+//the checks' weights are kept in the type the checks use
+typedef FieldEltVector WeightVector;
+static inline void setWeight(FieldElt& w, const mpz_t val) { w.set(val); }
+static inline void getWeight(mpz_t val, const FieldElt& w) { w.get(val); }
+#else
+typedef MPZVector WeightVector;
+static inline void setWeight(mpz_t w, const mpz_t val) { mpz_set(w, val); }
+static inline void getWeight(mpz_t val, const mpz_t w) { mpz_set(val, w); }
+#endif
+
+#define MASTER_KEY_BYTES 32 //CHACHA_KEY_SIZE / 8
+
+class Prng;
+
 class VerifierPrecomputation {
 
   
@@ -24,8 +57,21 @@ class VerifierPrecomputation {
     
     void init(PWSCircuit* subcircuit);
     void deinit(void);
-    void flipAllCoins();
+    void flipAllCoins(); //draws from the global prng
+    void flipAllCoins(Prng& prng);
+    //q1 .. q_{d-1} from ri and tau, once those are set.
+    void computeQi(void);
     void computeAddMul(std::vector<bool> muxBits);
+    //chiOut .. hWeights, once the coins are set (optional: without them,
+    //VerifierCompState works these out as it goes).
+    void computeWeights(void);
+
+    //init(), flipAllCoins() and computeAddMul() for instance number
+    //`instance`.
+    void precomputeInstance(PWSCircuit* subcircuit, const std::vector<bool>& muxBits,
+                            const uint8_t* masterKey, int instance);
+    //fresh from /dev/urandom, unless CMT_SEED is set (for reproducible runs).
+    static void newMasterKey(uint8_t* masterKey);
 
     MPZVector add; //val of add(w0, w1, w2) at each layer. e.g. add[0] = add~(qi[0], ri[0])
     MPZVector mul;   
@@ -35,6 +81,15 @@ class VerifierPrecomputation {
     MPZVector* qi; //aka w0, q1 = (w2 - w1) *  tau[0] + w1.
     MPZVector* ri; //aka {w1, w2}
     MPZVector tau; 
+    //everything the checks need that depends only on the coins, if
+    //hasWeights: chi at q0 and at q_{d-1}, for the m.l. exts. of the
+    //outputs and inputs; and at each layer, the barycentric weights for
+    //F012 at each round's r (3 per round), and for H at tau.
+    WeightVector chiOut;
+    WeightVector chiIn;
+    std::vector<WeightVector> fWeights;
+    std::vector<WeightVector> hWeights;
+    bool hasWeights;
     int* layerSizes;
     int* logLayerSizes;
     int depth;
@@ -0,0 +1,194 @@
+#include "verifier_precomp_file.h"
+
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static void putInt(vector<uint8_t>& out, int val) {
+    for (int i = 0; i < 4; i++)
+        out.push_back(((uint32_t) val >> (8 * i)) & 0xff);
+}
+
+PrecompFile::PrecompFile() : fp(NULL), c(NULL), headerLen(0), recordLen(0), count(0) {
+}
+
+PrecompFile::~PrecompFile() {
+    close();
+}
+
+void PrecompFile::header(vector<uint8_t>& out, const PWSCircuit& c, const vector<bool>& muxBits) const {
+    out.assign(PRECOMP_MAGIC, PRECOMP_MAGIC + PRECOMP_MAGIC_LEN);
+
+    out.resize(PRECOMP_MAGIC_LEN + FIELD_BYTES + CIRCUIT_DIGEST_BYTES);
+    pack_field(&out[PRECOMP_MAGIC_LEN], c.prime);
+    c.wiringDigest(&out[PRECOMP_MAGIC_LEN + FIELD_BYTES]);
+
+    putInt(out, c.depth());
+    for (int i = 0; i < c.depth(); i++)
+        putInt(out, c[i].size());
+
+    putInt(out, muxBits.size());
+    for (size_t i = 0; i < muxBits.size(); i++)
+        out.push_back(muxBits[i]);
+}
+
+size_t PrecompFile::recordSize(const PWSCircuit& c) {
+    const int depth = c.depth();
+    size_t n = c[0].logSize() + c[0].size() + c[depth - 1].size();
+    for (int i = 0; i < depth - 1; i++) {
+        size_t numRounds = 2 * c[i + 1].logSize();
+        //r, tau and the five predicates; then F012's and H's weights.
+        n += numRounds + 6;
+        n += 3 * numRounds + c[i + 1].logSize() + 1;
+    }
+    return n * FIELD_BYTES;
+}
+
+bool PrecompFile::create(const char* fileName, const PWSCircuit& c, const vector<bool>& muxBits) {
+    close();
+
+    fp = fopen(fileName, "wb");
+    if (fp == NULL)
+        return false;
+
+    header(buf, c, muxBits);
+    headerLen = buf.size();
+    recordLen = recordSize(c);
+    count = 0;
+    return fwrite(&buf[0], buf.size(), 1, fp) == 1;
+}
+
+bool PrecompFile::append(const VerifierPrecomputation& p) {
+    buf.resize(recordLen);
+    uint8_t* dst = &buf[0];
+    mpz_t tmp;
+    mpz_init(tmp);
+
+    for (size_t j = 0; j < p.qi[0].size(); j++, dst += FIELD_BYTES)
+        pack_field(dst, p.qi[0][j]);
+
+    for (int i = 0; i < p.depth - 1; i++) {
+        for (size_t j = 0; j < p.ri[i].size(); j++, dst += FIELD_BYTES)
+            pack_field(dst, p.ri[i][j]);
+        const mpz_t* vals[6] = { &p.tau[i], &p.add[i], &p.mul[i], &p.sub[i], &p.muxl[i], &p.muxr[i] };
+        for (int k = 0; k < 6; k++, dst += FIELD_BYTES)
+            pack_field(dst, *vals[k]);
+    }
+
+    const WeightVector* weights[2] = { &p.chiOut, &p.chiIn };
+    for (int k = 0; k < 2; k++) {
+        for (size_t j = 0; j < weights[k]->size(); j++, dst += FIELD_BYTES) {
+            getWeight(tmp, (*weights[k])[j]);
+            pack_field(dst, tmp);
+        }
+    }
+
+    for (int i = 0; i < p.depth - 1; i++) {
+        const WeightVector* layerWeights[2] = { &p.fWeights[i], &p.hWeights[i] };
+        for (int k = 0; k < 2; k++) {
+            for (size_t j = 0; j < layerWeights[k]->size(); j++, dst += FIELD_BYTES) {
+                getWeight(tmp, (*layerWeights[k])[j]);
+                pack_field(dst, tmp);
+            }
+        }
+    }
+    mpz_clear(tmp);
+
+    if (dst != &buf[0] + recordLen) {
+        errno = EINVAL;
+        return false;
+    }
+    count++;
+    return fwrite(&buf[0], recordLen, 1, fp) == 1;
+}
+
+bool PrecompFile::close() {
+    file.close();
+    if (fp == NULL)
+        return true;
+
+    bool ok = fclose(fp) == 0;
+    fp = NULL;
+    return ok;
+}
+
+void PrecompFile::open(const char* fileName, PWSCircuit* c, const vector<bool>& muxBits) {
+    close();
+
+    //instances are loaded one at a time, in whatever order they're wanted.
+    if (!file.open(fileName, MADV_RANDOM)) {
+        perror(fileName);
+        exit(1);
+    }
+
+    this->c = c;
+    header(buf, *c, muxBits);
+    headerLen = buf.size();
+    recordLen = recordSize(*c);
+
+    if (file.size() < PRECOMP_MAGIC_LEN || memcmp(file.data(), PRECOMP_MAGIC, PRECOMP_MAGIC_LEN)) {
+        cout << "ERROR: " << fileName << " is not a precomputation file. exiting." << endl;
+        exit(1);
+    }
+    if (file.size() < headerLen || memcmp(file.data(), &buf[0], headerLen)) {
+        cout << "ERROR: " << fileName << " is for another circuit (or prime, or mux bits). exiting." << endl;
+        exit(1);
+    }
+    if ((file.size() - headerLen) % recordLen != 0) {
+        cout << "ERROR: " << fileName << " is truncated. exiting." << endl;
+        exit(1);
+    }
+    count = (file.size() - headerLen) / recordLen;
+}
+
+void PrecompFile::load(int instance, VerifierPrecomputation& p) const {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(file.data()) + headerLen + (size_t) instance * recordLen;
+    mpz_t tmp;
+    mpz_init(tmp);
+
+    p.init(c);
+    for (size_t j = 0; j < p.qi[0].size(); j++, src += FIELD_BYTES)
+        unpack_field(p.qi[0][j], src);
+
+    for (int i = 0; i < p.depth - 1; i++) {
+        for (size_t j = 0; j < p.ri[i].size(); j++, src += FIELD_BYTES)
+            unpack_field(p.ri[i][j], src);
+        mpz_t* vals[6] = { &p.tau[i], &p.add[i], &p.mul[i], &p.sub[i], &p.muxl[i], &p.muxr[i] };
+        for (int k = 0; k < 6; k++, src += FIELD_BYTES)
+            unpack_field(*vals[k], src);
+    }
+    //the rest of q follows from r and tau.
+    p.computeQi();
+
+    p.fWeights.resize(p.depth - 1);
+    p.hWeights.resize(p.depth - 1);
+    p.chiOut.resize(p.layerSizes[0]);
+    p.chiIn.resize(p.layerSizes[p.depth - 1]);
+    for (int i = 0; i < p.depth - 1; i++) {
+        p.fWeights[i].resize(3 * p.ri[i].size());
+        p.hWeights[i].resize(p.logLayerSizes[i + 1] + 1);
+    }
+
+    WeightVector* weights[2] = { &p.chiOut, &p.chiIn };
+    for (int k = 0; k < 2; k++) {
+        for (size_t j = 0; j < weights[k]->size(); j++, src += FIELD_BYTES) {
+            unpack_field(tmp, src);
+            setWeight((*weights[k])[j], tmp);
+        }
+    }
+
+    for (int i = 0; i < p.depth - 1; i++) {
+        WeightVector* layerWeights[2] = { &p.fWeights[i], &p.hWeights[i] };
+        for (int k = 0; k < 2; k++) {
+            for (size_t j = 0; j < layerWeights[k]->size(); j++, src += FIELD_BYTES) {
+                unpack_field(tmp, src);
+                setWeight((*layerWeights[k])[j], tmp);
+            }
+        }
+    }
+    p.hasWeights = true;
+    mpz_clear(tmp);
+}
@@ -0,0 +1,68 @@
+#pragma once
+/* PrecompFile: VerifierPrecomputations computed ahead of time (precompute
+   -o), for the verifier to load rather than compute (verifier -l).
+
+   The file is PRECOMP_MAGIC, the prime (FIELD_BYTES), the circuit's
+   wiring digest (see Circuit::wiringDigest()), its depth and layer sizes,
+   and its mux bits (little-endian int32s; a byte per bit); then, back to back, one fixed-size record per instance, of field
+   elements (FIELD_BYTES each, little-endian, as in the binary protocol):
+
+     q0
+     for each layer i < depth - 1: r[i], tau[i], add, mul, sub, muxl, muxr
+     chiOut, chiIn
+     for each layer i < depth - 1: fWeights[i], hWeights[i]
+
+   So instance k is at a fixed offset, and the number of instances is
+   however many records there are. Of q, only q0 is stored: the rest
+   follow from r and tau (see VerifierPrecomputation::computeQi()).
+ */
+#include <gmp.h>
+
+extern "C" {
+#include "util.h"
+}
+
+#include "verifier_precomp.h"
+
+#include <circuit/mapped_file.h>
+
+#include <cstdio>
+#include <vector>
+
+#define PRECOMP_MAGIC "CMTPRECP"
+#define PRECOMP_MAGIC_LEN 8
+
+class PrecompFile {
+ public:
+    PrecompFile();
+    ~PrecompFile();
+
+    //writing. these return false (with errno set) on error, since
+    //libcmtprecomp is their user.
+    bool create(const char* fileName, const PWSCircuit& c, const std::vector<bool>& muxBits);
+    //p must have its weights (see VerifierPrecomputation::computeWeights()).
+    bool append(const VerifierPrecomputation& p);
+    bool close(void);
+
+    //reading: exits if the file isn't for c with these mux bits.
+    void open(const char* fileName, PWSCircuit* c, const std::vector<bool>& muxBits);
+    int numInstances(void) const { return count; }
+    //inits p with instance number `instance`, weights included. safe to
+    //call from several threads at once.
+    void load(int instance, VerifierPrecomputation& p) const;
+
+ private:
+    FILE* fp;
+    MappedFile file;
+    PWSCircuit* c;
+    size_t headerLen;
+    size_t recordLen;
+    int count;
+    std::vector<uint8_t> buf;
+
+    PrecompFile(const PrecompFile&);
+    PrecompFile& operator=(const PrecompFile&);
+
+    void header(std::vector<uint8_t>& out, const PWSCircuit& c, const std::vector<bool>& muxBits) const;
+    static size_t recordSize(const PWSCircuit& c);
+};
@@ -0,0 +1,114 @@
+#include "verifier_precomp_queue.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+VerifierPrecompQueue::VerifierPrecompQueue(PWSCircuit* c, const vector<bool>& muxBits, const uint8_t* masterKey,
+                                           int numInstances, int window, int nthreads, const PrecompFile* file)
+    : c(c), muxBits(muxBits), file(file), n(numInstances), window(max(window, 1)),
+      slots(numInstances, NULL), statuses(numInstances, PENDING),
+      next(0), live(0), stopping(false) {
+
+    memcpy(this->masterKey, masterKey, MASTER_KEY_BYTES);
+
+    ready_fd = eventfd(0, EFD_NONBLOCK);
+    if (ready_fd < 0) {
+        perror("eventfd");
+        exit(1);
+    }
+
+    //more workers than the window would just sit waiting for room.
+    nthreads = max(1, min(nthreads, min(this->window, n)));
+    for (int t = 0; t < nthreads; t++)
+        workers.push_back(thread(&VerifierPrecompQueue::work, this));
+}
+
+VerifierPrecompQueue::~VerifierPrecompQueue() {
+    {
+        unique_lock<mutex> l(lock);
+        stopping = true;
+    }
+    room.notify_all();
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    for (int i = 0; i < n; i++) {
+        if (slots[i] != NULL) {
+            slots[i]->deinit();
+            delete slots[i];
+        }
+    }
+    close(ready_fd);
+}
+
+void VerifierPrecompQueue::work() {
+    while (1) {
+        int id;
+        {
+            unique_lock<mutex> l(lock);
+            while (!stopping && next < n && live >= window)
+                room.wait(l);
+            if (stopping || next >= n)
+                return;
+            id = next++;
+            live++;
+        }
+
+        VerifierPrecomputation* p = new VerifierPrecomputation;
+        if (file != NULL)
+            file->load(id, *p);
+        else
+            p->precomputeInstance(c, muxBits, masterKey, id);
+
+        {
+            unique_lock<mutex> l(lock);
+            slots[id] = p;
+            statuses[id] = READY;
+        }
+
+        uint64_t one = 1;
+        if (write(ready_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            perror("writing eventfd");
+    }
+}
+
+void VerifierPrecompQueue::clearReady() {
+    uint64_t count;
+    if (read(ready_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        perror("reading eventfd");
+}
+
+VerifierPrecompQueue::Status VerifierPrecompQueue::status(int id) {
+    unique_lock<mutex> l(lock);
+    return statuses[id];
+}
+
+VerifierPrecomputation* VerifierPrecompQueue::tryAcquire(int id) {
+    unique_lock<mutex> l(lock);
+    return statuses[id] == READY ? slots[id] : NULL;
+}
+
+void VerifierPrecompQueue::release(int id) {
+    VerifierPrecomputation* p;
+    {
+        unique_lock<mutex> l(lock);
+        if (statuses[id] != READY)
+            return;
+        p = slots[id];
+        slots[id] = NULL;
+        statuses[id] = RELEASED;
+        live--;
+    }
+    room.notify_one();
+
+    p->deinit();
+    delete p;
+}
@@ -0,0 +1,64 @@
+#pragma once
+/* VerifierPrecompQueue: a bounded producer/consumer pipeline of
+   VerifierPrecomputations.
+
+   Worker threads precompute instances in id order, but never more than
+   `window` of them are alive (being precomputed, waiting for the prover,
+   or in use) at once: while the prover works on instance k, the workers
+   are at most filling in k + window - 1. Once the verifier is done with an
+   instance it release()s it, which frees it and lets the workers move on.
+   Memory stays proportional to the window, not to the number of instances.
+
+   The consumer (the verifier's event loop) never blocks: tryAcquire()
+   returns NULL for an instance that isn't ready, and readyFd() (an
+   eventfd) becomes readable whenever another instance is.
+
+   Given a PrecompFile, the workers load instances from it instead of
+   precomputing them.
+ */
+#include "verifier_precomp.h"
+#include "verifier_precomp_file.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class VerifierPrecompQueue {
+ public:
+    enum Status { PENDING, READY, RELEASED };
+
+    VerifierPrecompQueue(PWSCircuit* c, const std::vector<bool>& muxBits, const uint8_t* masterKey,
+                         int numInstances, int window, int nthreads, const PrecompFile* file = NULL);
+    ~VerifierPrecompQueue();
+
+    int numInstances(void) const { return n; }
+    int readyFd(void) const { return ready_fd; }
+    //call once readyFd() is readable, before retrying tryAcquire().
+    void clearReady(void);
+
+    Status status(int id);
+    VerifierPrecomputation* tryAcquire(int id);
+    void release(int id);
+
+ private:
+    PWSCircuit* c;
+    std::vector<bool> muxBits;
+    uint8_t masterKey[MASTER_KEY_BYTES];
+    const PrecompFile* file;
+    int n;
+    int window;
+
+    std::mutex lock;
+    std::condition_variable room; //signalled when live drops, or on shutdown
+    std::vector<VerifierPrecomputation*> slots;
+    std::vector<Status> statuses;
+    int next; //next instance to precompute
+    int live; //instances precomputing or READY
+    bool stopping;
+
+    int ready_fd;
+    std::vector<std::thread> workers;
+
+    void work(void);
+};
@@ -0,0 +1,533 @@
+#include "verifier_server.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern mpz_t mpz_buf[];
+extern int netBytesRecieved;
+extern int netBytesSent;
+
+static char read_buf[READ_CHUNK];
+
+//a message as sendHeader()/sendHeaderBin() would write it, appended to
+//out.
+static void appendHeader(string& out, prover_request request, bool binary) {
+    size_t at = out.size();
+    if (binary) {
+        out.resize(at + CMT_BIN_HEADER_LEN);
+        encodeHeaderBin((uint8_t*) &out[at], request);
+    }
+    else {
+        char hdr[128];
+        snprintf(hdr, sizeof(hdr), "%d, %d, %d, %d, %d: ", request.id, request.requestType, request.howMany, request.round, request.layer);
+        out += hdr;
+    }
+    netBytesSent += out.size() - at;
+}
+
+//the first howMany elements of mpz_buf, as sendMPZ()/sendMessageBin()
+//would write them.
+static void appendMPZ(string& out, int howMany, bool binary) {
+    size_t at = out.size();
+    if (binary) {
+        out.resize(at + (size_t) howMany * FIELD_BYTES);
+        encodeMPZBin(howMany, (uint8_t*) &out[at]);
+    }
+    else {
+        for (int i = 0; i < howMany; i++) {
+            size_t end = out.size();
+            out.resize(end + mpz_sizeinbase(mpz_buf[i], 10) + 2);
+            mpz_get_str(&out[end], 10, mpz_buf[i]);
+            out.resize(end + strlen(&out[end]));
+            out += ',';
+        }
+    }
+    netBytesSent += out.size() - at;
+}
+
+//numMuxBits bits, as sendMuxBits()/sendMuxBitsBin() would write them.
+static void appendMuxBits(string& out, const bool* muxBits, int numMuxBits, bool binary) {
+    for (int i = 0; i < numMuxBits; i++) {
+        if (binary)
+            out += (char) (muxBits[i] ? 1 : 0);
+        else
+            out += muxBits[i] ? '0' : '1';
+    }
+    netBytesSent += numMuxBits;
+}
+
+VerifierServer::VerifierServer(VerifierPrecompQueue* queue, const vector<bool>& muxBits, VerifierTrace* trace)
+    : queue(queue), trace(trace), listen_sock(-1), epoll_fd(-1) {
+
+    //to pass muxbits to a c function
+    //(vector<bool> doesn't implement data() for doing this easily...)
+    numMuxBits = muxBits.size();
+    muxArr = new bool[numMuxBits];
+    copy(muxBits.begin(), muxBits.end(), muxArr);
+}
+
+VerifierServer::~VerifierServer() {
+    for (map<int, VerifierCompState*>::iterator it = active.begin(); it != active.end(); ++it)
+        delete it->second;
+    for (size_t i = 0; i < idle.size(); i++)
+        delete idle[i];
+    delete[] muxArr;
+}
+
+void VerifierServer::run() {
+    //a prover that hangs up early should cost us that connection, not the
+    //whole verifier.
+    signal(SIGPIPE, SIG_IGN);
+
+    initConnection();
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    while (1) {
+        int n = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            exit(1);
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &listenTag) {
+                acceptAll();
+            }
+            else if (events[i].data.ptr == &queueTag) {
+                onQueueReady();
+            }
+            else {
+                Connection* conn = (Connection*) events[i].data.ptr;
+                //(closed earlier in this batch, e.g., by a retry in
+                //onQueueReady().)
+                if (conn->dead)
+                    continue;
+                if ((events[i].events & EPOLLOUT) && !flush(conn))
+                    continue;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    onReadable(conn);
+            }
+        }
+
+        //nothing in this batch refers to them any more.
+        for (size_t i = 0; i < closed.size(); i++)
+            delete closed[i];
+        closed.clear();
+    }
+}
+
+void VerifierServer::acceptAll() {
+    while (1) {
+        //replies are buffered per connection (see flush()), so writes
+        //don't block either.
+        int fd = accept4(listen_sock, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        Connection* conn = new Connection;
+        conn->fd = fd;
+        conn->mode = MODE_UNKNOWN;
+        conn->events = EPOLLIN;
+        conn->parked = false;
+        conn->closing = false;
+        conn->dead = false;
+        watch(fd, conn);
+    }
+}
+
+void VerifierServer::watch(int fd, Connection* tag) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+}
+
+//the events conn should be woken for: input, unless it's parked or
+//closing or its prover isn't reading the replies, and output while some
+//is buffered.
+void VerifierServer::rewatch(Connection* conn) {
+    uint32_t events = 0;
+    if (!conn->parked && !conn->closing && conn->out.size() < MAX_BUFFERED_OUT)
+        events |= EPOLLIN;
+    if (!conn->out.empty())
+        events |= EPOLLOUT;
+    if (events == conn->events)
+        return;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+    conn->events = events;
+}
+
+//write as much of conn's buffered output as the socket takes now; the
+//rest goes once epoll says it's writable. false if conn has been closed
+//(it's done, or the write failed).
+bool VerifierServer::flush(Connection* conn) {
+    while (!conn->out.empty()) {
+        ssize_t n = write(conn->fd, conn->out.data(), conn->out.size());
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            perror("writing on stream socket");
+            closeConnection(conn);
+            return false;
+        }
+        conn->out.erase(0, n);
+    }
+
+    if (conn->closing && conn->out.empty()) {
+        closeConnection(conn);
+        return false;
+    }
+    rewatch(conn);
+    return true;
+}
+
+//only called once epoll says there's something to read, so the read
+//doesn't block.
+void VerifierServer::onReadable(Connection* conn) {
+    ssize_t n = read(conn->fd, read_buf, READ_CHUNK);
+    if (n < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+            return;
+        perror("reading on stream socket");
+        closeConnection(conn);
+        return;
+    }
+    if (n == 0) {
+        closeConnection(conn);
+        return;
+    }
+    //the connection is done; only its last replies are still going out.
+    if (conn->closing)
+        return;
+    conn->in.append(read_buf, n);
+    //(woken by a hangup while parked: what it sent before is kept for
+    //when it's retried.)
+    if (conn->parked)
+        return;
+
+    if (conn->mode == MODE_UNKNOWN) {
+        int binary = isBinaryPreamble((const uint8_t*) conn->in.data(), conn->in.size());
+        if (binary < 0)
+            return;
+        if (binary) {
+            conn->mode = MODE_BINARY;
+            conn->in.erase(0, CMT_BIN_MAGIC_LEN);
+            netBytesRecieved += CMT_BIN_MAGIC_LEN;
+        }
+        else {
+            conn->mode = MODE_TEXT;
+        }
+    }
+
+    process(conn);
+}
+
+//retry the parked connections; some may still have to wait.
+void VerifierServer::onQueueReady() {
+    queue->clearReady();
+
+    vector<Connection*> retry;
+    retry.swap(parked);
+    for (size_t i = 0; i < retry.size(); i++) {
+        retry[i]->parked = false;
+        process(retry[i]);
+    }
+}
+
+//a dropped connection is closed once its replies have gone out; a
+//parked one stops being read until the queue is ready.
+void VerifierServer::process(Connection* conn) {
+    Outcome outcome = (conn->mode == MODE_BINARY) ? processBinary(conn) : processText(conn);
+    if (outcome == DROP) {
+        conn->closing = true;
+    }
+    else if (outcome == WAIT) {
+        conn->parked = true;
+        parked.push_back(conn);
+    }
+    flush(conn);
+}
+
+//computations started on conn that aren't done yet can't go on without
+//it: they end, failed, so their precomputations are freed and their coins
+//are never served again. conn itself is freed once the current batch of
+//events is handled, since a later event in it may still point to conn.
+void VerifierServer::closeConnection(Connection* conn) {
+    for (set<int>::iterator it = conn->ids.begin(); it != conn->ids.end(); ++it) {
+        map<int, VerifierCompState*>::iterator st = active.find(*it);
+        if (st != active.end()) {
+            st->second->abandon();
+            finishComputation(*it, st->second);
+        }
+    }
+
+    if (conn->parked)
+        parked.erase(find(parked.begin(), parked.end(), conn));
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->dead = true;
+    closed.push_back(conn);
+}
+
+//a text connection carries a single message: a header ending in ':'
+//and, if the prover is sending, howMany comma-terminated elements.
+VerifierServer::Outcome VerifierServer::processText(Connection* conn) {
+    size_t colon = conn->in.find(':');
+    if (colon == string::npos)
+        return KEEP;
+
+    prover_request request;
+    if (sscanf(conn->in.c_str(), "%d, %d, %d, %d, %d", &request.id, &request.requestType, &request.howMany, &request.round, &request.layer) != 5) {
+        cout << "ERROR: malformed header from prover. dropping connection." << endl;
+        return DROP;
+    }
+
+    if (verifierRecievesOn(request)) {
+        if (request.howMany < 0 || request.howMany > MPZ_BUF_LEN) {
+            cout << "ERROR: bad element count in header from prover. dropping connection." << endl;
+            return DROP;
+        }
+        if (count(conn->in.begin() + colon, conn->in.end(), ',') < request.howMany)
+            return KEEP;
+    }
+
+    //the whole message is here; parse the elements the same way as from
+    //a socket.
+    if (verifierRecievesOn(request)) {
+        FILE* fp = fmemopen(&conn->in[colon + 1], conn->in.size() - colon - 1, "r");
+        recieveMPZ(request.howMany, fp);
+        fclose(fp);
+    }
+
+    if (dispatch(request, conn) == WAIT)
+        return WAIT;
+
+    //one message per connection, so once it's handled we're done.
+    netBytesRecieved += colon + 1;
+    return DROP;
+}
+
+VerifierServer::Outcome VerifierServer::processBinary(Connection* conn) {
+    size_t pos = 0;
+    Outcome outcome = KEEP;
+
+    while (outcome == KEEP && conn->in.size() - pos >= CMT_BIN_HEADER_LEN) {
+        const uint8_t* msg = (const uint8_t*) conn->in.data() + pos;
+        prover_request request = decodeHeaderBin(msg);
+
+        size_t len = CMT_BIN_HEADER_LEN;
+        if (verifierRecievesOn(request)) {
+            if (request.howMany < 0 || request.howMany > MPZ_BUF_LEN) {
+                cout << "ERROR: bad element count in header from prover. dropping connection." << endl;
+                return DROP;
+            }
+            len += (size_t) request.howMany * FIELD_BYTES;
+        }
+        if (conn->in.size() - pos < len)
+            break;
+
+        if (verifierRecievesOn(request))
+            decodeMPZBin(request.howMany, msg + CMT_BIN_HEADER_LEN);
+
+        outcome = dispatch(request, conn);
+        if (outcome != WAIT) {
+            //leave a message we have to wait on in the buffer, to be
+            //handled again later.
+            netBytesRecieved += len;
+            pos += len;
+        }
+    }
+
+    conn->in.erase(0, pos);
+    return outcome;
+}
+
+
+//DROP if the request is bad enough that the connection should be
+//dropped, WAIT if it can't be handled until more instances are
+//precomputed.
+VerifierServer::Outcome VerifierServer::dispatch(prover_request request, Connection* conn) {
+    bool binary = (conn->mode == MODE_BINARY);
+
+    if (request.requestType == CMT_MUXSEL) {
+        if (binary) {
+            //exactly as many bits as were asked for, out of the ones
+            //there are.
+            if (request.howMany < 0 || request.howMany > numMuxBits) {
+                cout << "ERROR: prover asked for " << request.howMany << " of " << numMuxBits << " mux bits. dropping connection." << endl;
+                return DROP;
+            }
+            appendHeader(conn->out, request, true);
+            appendMuxBits(conn->out, muxArr, request.howMany, true);
+        }
+        else {
+            appendHeader(conn->out, request, false);
+            appendMuxBits(conn->out, muxArr, numMuxBits, false);
+        }
+        return KEEP;
+    }
+
+    if (request.id < 0 || request.id >= queue->numInstances()) {
+        cout << "ERROR: requested computation id for computation that has not been precomputed. dropping connection." << endl;
+        return DROP;
+    }
+
+    VerifierCompState* state;
+    if (request.requestType == CMT_INPUT) {
+        map<int, VerifierCompState*>::iterator it = active.find(request.id);
+        if (it != active.end()) {
+            //the prover is starting over, but it may have seen some of
+            //the coins already: this instance is spent.
+            cout << "ERROR: prover restarted computation id " << request.id << ". dropping connection." << endl;
+            it->second->abandon();
+            finishComputation(request.id, it->second);
+            return DROP;
+        }
+
+        VerifierPrecomputation* precomp = queue->tryAcquire(request.id);
+        if (precomp == NULL) {
+            if (queue->status(request.id) == VerifierPrecompQueue::RELEASED) {
+                cout << "ERROR: computation id " << request.id << " is already over. dropping connection." << endl;
+                return DROP;
+            }
+            return WAIT;
+        }
+        state = startComputation(request.id, precomp);
+        //(a text connection carries just this one message.)
+        if (binary)
+            conn->ids.insert(request.id);
+    }
+    else {
+        map<int, VerifierCompState*>::iterator it = active.find(request.id);
+        if (it == active.end()) {
+            cout << "ERROR: request for computation id " << request.id << ", which hasn't been started. dropping connection." << endl;
+            return DROP;
+        }
+        state = it->second;
+    }
+
+    bool ok = handle(request, conn, state);
+
+    if (state->isDone()) {
+        finishComputation(request.id, state);
+        conn->ids.erase(request.id);
+    }
+    if (!ok) {
+        cout << "ERROR: bad request for computation id " << request.id << ". dropping connection." << endl;
+        return DROP;
+    }
+    return KEEP;
+}
+
+//computation id is over, one way or the other: its state goes back on the
+//free list and its precomputation back to the queue.
+void VerifierServer::finishComputation(int id, VerifierCompState* state) {
+    if (trace != NULL)
+        trace->flush();
+    active.erase(id);
+    idle.push_back(state);
+    queue->release(id);
+}
+
+//a state for computation id, reusing a finished one if there is one.
+VerifierCompState* VerifierServer::startComputation(int id, VerifierPrecomputation* precomp) {
+    VerifierCompState* state;
+    if (!idle.empty()) {
+        state = idle.back();
+        idle.pop_back();
+    }
+    else {
+        state = new VerifierCompState();
+    }
+
+    state->init(precomp, id);
+    state->setTrace(trace);
+    active[id] = state;
+    return state;
+}
+
+
+//false (and nothing is sent) if the state rejects the request.
+//otherwise the reply, if any, is buffered on conn.
+bool VerifierServer::handle(prover_request request, Connection* conn, VerifierCompState* state) {
+
+    if (!state->handle(request))
+        return false;
+
+    if (verifierSendsOn(request)) {
+        bool binary = (conn->mode == MODE_BINARY);
+        appendHeader(conn->out, request, binary);
+        appendMPZ(conn->out, request.howMany, binary);
+    }
+    return true;
+}
+
+
+void VerifierServer::initConnection() {
+    for (int i = 0; i < MPZ_BUF_LEN; i++)
+        mpz_init(mpz_buf[i]);
+
+
+    listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_sock < 0) {
+        perror("opening stream socket");
+        exit(1);
+    }
+    char socket_path[1000];
+    getSocketPath(socket_path);
+
+    struct sockaddr_un server;
+    unlink(socket_path);
+    server.sun_family = AF_UNIX;
+    strcpy(server.sun_path, socket_path);
+    if (bind(listen_sock, (struct sockaddr *) &server, sizeof(struct sockaddr_un))) {
+        perror("binding stream socket");
+        exit(1);
+    }
+
+    //accept() in the event loop must not block.
+    fcntl(listen_sock, F_SETFL, fcntl(listen_sock, F_GETFL) | O_NONBLOCK);
+
+    listen(listen_sock, MAX_NUM_CONNECTIONS);
+
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        exit(1);
+    }
+
+    watch(listen_sock, &listenTag);
+    watch(queue->readyFd(), &queueTag);
+}
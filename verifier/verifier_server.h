@@ -0,0 +1,114 @@
+#pragma once
+/* VerifierServer: the verifier's side of the socket. A single thread
+   multiplexes any number of prover connections with epoll, so a slow
+   prover doesn't hold up the others.
+
+   Text-protocol connections carry one message each; binary-protocol
+   connections (see util.h) stay open and carry any number of messages,
+   possibly for several computations. Either way, bytes are buffered per
+   connection and a message is only handled once it has fully arrived.
+   Replies are buffered per connection too, and written as the socket
+   takes them, so a prover that doesn't read can't block the verifier.
+
+   Each computation id in flight gets its own VerifierCompState (state
+   machine), created when the prover asks for the inputs. Once
+   doFinalCheck() has run for it, the state goes back on a free list and
+   is reused for the next computation, and the id's precomputation is
+   released back to the VerifierPrecompQueue. A malformed or out-of-turn
+   message ends its computation the same way (as a failure), and drops
+   the connection it came on; other computations carry on. So does a
+   binary connection closing before the computations started on it are
+   done, or a prover asking for the inputs of a computation it already
+   started: an instance whose coins may have been sent is never served
+   again. (Text connections carry one message each, so a text prover
+   that goes away just leaves its computation unfinished.)
+
+   If the prover asks for the inputs of an instance that hasn't been
+   precomputed yet, its connection is parked (no longer read, message
+   still buffered) until the queue says another instance is
+   ready; the other connections carry on meanwhile.
+
+   With a VerifierTrace, every state records to it, and the trace is
+   flushed as each computation finishes (the server is stopped by a
+   signal, so there's no later point to do it).
+ */
+#include <gmp.h>
+
+extern "C" {
+#include "util.h"
+}
+
+#include "verifier_precomp_queue.h"
+#include "verifier_comp_state.h"
+#include "verifier_trace.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#define MAX_NUM_CONNECTIONS 128
+#define MAX_EPOLL_EVENTS 64
+#define READ_CHUNK 65536
+//stop reading from a connection with this many bytes of replies unsent
+#define MAX_BUFFERED_OUT (1 << 20)
+
+class VerifierServer {
+ public:
+    VerifierServer(VerifierPrecompQueue* queue, const std::vector<bool>& muxBits, VerifierTrace* trace = NULL);
+    ~VerifierServer();
+
+    //serve provers. doesn't return.
+    void run(void);
+
+ private:
+    enum ConnMode { MODE_UNKNOWN, MODE_TEXT, MODE_BINARY };
+    //what to do with a connection after handling a request.
+    enum Outcome { KEEP, DROP, WAIT };
+
+    struct Connection {
+        int fd;
+        ConnMode mode;
+        std::string in; //bytes recieved but not handled yet
+        std::string out; //replies not written yet
+        uint32_t events; //what epoll is watching for
+        bool parked; //waiting on the precomp queue
+        bool closing; //done; close once out is written
+        bool dead; //closed; freed at the end of the epoll batch
+        std::set<int> ids; //computations started here and not done yet
+    };
+
+    VerifierPrecompQueue* queue;
+    VerifierTrace* trace;
+    bool* muxArr;
+    int numMuxBits;
+
+    int listen_sock;
+    int epoll_fd;
+    //epoll tags for the listening socket and the queue's eventfd
+    Connection listenTag, queueTag;
+
+    std::map<int, VerifierCompState*> active; //by computation id
+    std::vector<VerifierCompState*> idle;
+    std::vector<Connection*> parked; //waiting on the precomp queue
+    std::vector<Connection*> closed; //to free after this epoll batch
+
+    void initConnection(void);
+    void acceptAll(void);
+    void onReadable(Connection* conn);
+    void onQueueReady(void);
+    void process(Connection* conn);
+    void closeConnection(Connection* conn);
+    void watch(int fd, Connection* tag);
+    void rewatch(Connection* conn);
+    bool flush(Connection* conn);
+
+    //handle every complete message buffered on conn.
+    Outcome processText(Connection* conn);
+    Outcome processBinary(Connection* conn);
+
+    Outcome dispatch(prover_request request, Connection* conn);
+    bool handle(prover_request request, Connection* conn, VerifierCompState* state);
+    VerifierCompState* startComputation(int id, VerifierPrecomputation* precomp);
+    void finishComputation(int id, VerifierCompState* state);
+};
@@ -0,0 +1,199 @@
+#include "verifier_trace.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+extern mpz_t mpz_buf[];
+
+static void putInt(uint8_t* dst, int val) {
+    for (int i = 0; i < 4; i++)
+        dst[i] = ((uint32_t) val >> (8 * i)) & 0xff;
+}
+
+VerifierTrace::VerifierTrace() : fp(NULL), name(NULL) {
+}
+
+VerifierTrace::~VerifierTrace() {
+    close();
+}
+
+void VerifierTrace::create(const char* fileName, const PWSCircuit& c, const vector<bool>& muxBits) {
+    close();
+
+    name = fileName;
+    fp = fopen(fileName, "wb");
+    if (fp == NULL) {
+        perror(fileName);
+        exit(1);
+    }
+    buf.resize(CMT_BIN_HEADER_LEN + MPZ_BUF_LEN * FIELD_BYTES);
+
+    write(TRACE_MAGIC, TRACE_MAGIC_LEN);
+    putInt(&buf[0], c.depth());
+    write(&buf[0], 4);
+    for (int i = 0; i < c.depth(); i++) {
+        putInt(&buf[0], c[i].size());
+        write(&buf[0], 4);
+    }
+
+    putInt(&buf[0], muxBits.size());
+    write(&buf[0], 4);
+    for (size_t i = 0; i < muxBits.size(); i++) {
+        uint8_t bit = muxBits[i];
+        write(&bit, 1);
+    }
+}
+
+void VerifierTrace::close() {
+    if (fp == NULL)
+        return;
+
+    if (fclose(fp) != 0) {
+        perror(name);
+        exit(1);
+    }
+    fp = NULL;
+}
+
+void VerifierTrace::flush() {
+    if (fp != NULL && fflush(fp) != 0) {
+        perror(name);
+        exit(1);
+    }
+}
+
+void VerifierTrace::write(const void* data, size_t len) {
+    if (fwrite(data, len, 1, fp) != 1) {
+        perror(name);
+        exit(1);
+    }
+}
+
+void VerifierTrace::recordCoins(int id, const VerifierPrecomputation& precomp) {
+    prover_request request;
+    memset(&request, 0, sizeof(request));
+    request.id = id;
+    request.requestType = TRACE_COINS;
+    for (int part = -1; part < precomp.depth - 1; part++) {
+        request.layer = part;
+        request.howMany = coinsToBuf(precomp, part);
+        record(request);
+    }
+}
+
+void VerifierTrace::record(prover_request request) {
+    encodeHeaderBin(&buf[0], request);
+    encodeMPZBin(request.howMany, &buf[CMT_BIN_HEADER_LEN]);
+    write(&buf[0], CMT_BIN_HEADER_LEN + (size_t) request.howMany * FIELD_BYTES);
+}
+
+//both q0 and r have fewer than MPZ_BUF_LEN elements (they're no longer
+//than twice the log of the widest layer).
+int VerifierTrace::coinsToBuf(const VerifierPrecomputation& precomp, int part) {
+    if (part < 0) {
+        for (size_t j = 0; j < precomp.qi[0].size(); j++)
+            mpz_set(mpz_buf[j], precomp.qi[0][j]);
+        return precomp.qi[0].size();
+    }
+
+    const MPZVector& r = precomp.ri[part];
+    for (size_t j = 0; j < r.size(); j++)
+        mpz_set(mpz_buf[j], r[j]);
+    mpz_set(mpz_buf[r.size()], precomp.tau[part]);
+    return r.size() + 1;
+}
+
+bool VerifierTrace::coinsFromBuf(VerifierPrecomputation& precomp, prover_request request) {
+    int part = request.layer;
+    if (request.requestType != TRACE_COINS || part < -1 || part >= precomp.depth - 1)
+        return false;
+
+    if (part < 0) {
+        if (request.howMany != (int) precomp.qi[0].size())
+            return false;
+        for (size_t j = 0; j < precomp.qi[0].size(); j++)
+            mpz_set(precomp.qi[0][j], mpz_buf[j]);
+        return true;
+    }
+
+    MPZVector& r = precomp.ri[part];
+    if (request.howMany != (int) r.size() + 1)
+        return false;
+    for (size_t j = 0; j < r.size(); j++)
+        mpz_set(r[j], mpz_buf[j]);
+    mpz_set(precomp.tau[part], mpz_buf[r.size()]);
+    return true;
+}
+
+TraceReader::TraceReader() : name(NULL), start(0), pos(0) {
+}
+
+bool TraceReader::readInt(int& val) {
+    if (file.size() - pos < 4)
+        return false;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(file.data() + pos);
+    uint32_t u = 0;
+    for (int i = 0; i < 4; i++)
+        u |= (uint32_t) bytes[i] << (8 * i);
+    val = (int) u;
+    pos += 4;
+    return true;
+}
+
+void TraceReader::open(const char* fileName, const PWSCircuit& c, const vector<bool>& muxBits) {
+    name = fileName;
+    //read in order, but rewind() starts over.
+    if (!file.open(fileName, MADV_NORMAL)) {
+        perror(fileName);
+        exit(1);
+    }
+
+    if (file.size() < TRACE_MAGIC_LEN || memcmp(file.data(), TRACE_MAGIC, TRACE_MAGIC_LEN)) {
+        cout << "ERROR: " << fileName << " is not a verifier trace. exiting." << endl;
+        exit(1);
+    }
+    pos = TRACE_MAGIC_LEN;
+
+    int depth, numMuxBits;
+    bool same = readInt(depth) && depth == c.depth();
+    for (int i = 0; same && i < depth; i++) {
+        int size;
+        same = readInt(size) && size == c[i].size();
+    }
+    same = same && readInt(numMuxBits) && numMuxBits == (int) muxBits.size()
+        && file.size() - pos >= (size_t) numMuxBits;
+    for (int i = 0; same && i < numMuxBits; i++)
+        same = (file.data()[pos + i] != 0) == muxBits[i];
+    if (!same) {
+        cout << "ERROR: " << fileName << " is a trace of another circuit (or other mux bits). exiting." << endl;
+        exit(1);
+    }
+
+    pos += numMuxBits;
+    start = pos;
+}
+
+bool TraceReader::next(prover_request& request) {
+    if (pos == file.size())
+        return false;
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(file.data() + pos);
+    bool whole = file.size() - pos >= CMT_BIN_HEADER_LEN;
+    if (whole) {
+        request = decodeHeaderBin(src);
+        whole = request.howMany >= 0 && request.howMany <= MPZ_BUF_LEN
+            && (file.size() - pos - CMT_BIN_HEADER_LEN) / FIELD_BYTES >= (size_t) request.howMany;
+    }
+    if (!whole) {
+        cout << "ERROR: " << name << " is truncated. exiting." << endl;
+        exit(1);
+    }
+
+    decodeMPZBin(request.howMany, src + CMT_BIN_HEADER_LEN);
+    pos += CMT_BIN_HEADER_LEN + (size_t) request.howMany * FIELD_BYTES;
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+/* VerifierTrace: a recording of what the verifier saw and said, so that
+   its checks can be rerun (and timed) without a prover; see cmtreplay.
+
+   With verifier -t foo.trace, every request VerifierCompState::handle()
+   deals with is written out in the binary protocol's framing (see
+   util.h): the header, then its howMany field elements, whichever side
+   sent them. Before a computation's CMT_INPUT, TRACE_COINS records hold
+   V's coins for it, one per part (the record's layer; see coinsToBuf()),
+   in order: q0, then for each layer, r followed by tau. So no record
+   holds more than a layer's worth of coins.
+   The file starts with TRACE_MAGIC, the circuit's depth and layer sizes,
+   and its mux bits (little-endian int32s; a byte per bit).
+
+   Records of different computations may be interleaved, as they are
+   when several provers are served at once.
+ */
+#include <gmp.h>
+
+extern "C" {
+#include "util.h"
+}
+
+#include "verifier_precomp.h"
+
+#include <circuit/mapped_file.h>
+
+#include <cstdio>
+#include <vector>
+
+#define TRACE_MAGIC "CMTTRACE"
+#define TRACE_MAGIC_LEN 8
+//pseudo request type for a computation's coins
+#define TRACE_COINS 95000
+
+class VerifierTrace {
+ public:
+    VerifierTrace();
+    ~VerifierTrace();
+
+    //exits on error.
+    void create(const char* fileName, const PWSCircuit& c, const std::vector<bool>& muxBits);
+    void close(void);
+    //the OS gets everything recorded so far.
+    void flush(void);
+
+    void recordCoins(int id, const VerifierPrecomputation& precomp);
+    //request's header, and its elements from mpz_buf.
+    void record(prover_request request);
+
+    //part of a computation's coins, into / out of mpz_buf: part -1 is q0,
+    //part i < depth - 1 is layer i's r followed by its tau. coinsToBuf()
+    //returns how many there are; coinsFromBuf() returns false if the
+    //TRACE_COINS record isn't a part of precomp's coins.
+    static int coinsToBuf(const VerifierPrecomputation& precomp, int part);
+    static bool coinsFromBuf(VerifierPrecomputation& precomp, prover_request request);
+
+ private:
+    FILE* fp;
+    const char* name;
+    std::vector<uint8_t> buf;
+
+    VerifierTrace(const VerifierTrace&);
+    VerifierTrace& operator=(const VerifierTrace&);
+
+    void write(const void* data, size_t len);
+};
+
+//a recorded trace, mapped in and read back record by record.
+class TraceReader {
+ public:
+    TraceReader();
+
+    //exits if the file isn't a trace of c with these mux bits.
+    void open(const char* fileName, const PWSCircuit& c, const std::vector<bool>& muxBits);
+    //back to the first record.
+    void rewind(void) { pos = start; }
+
+    //the next record's header, with its elements in mpz_buf; false at the
+    //end of the trace. exits if the trace is cut short.
+    bool next(prover_request& request);
+
+ private:
+    MappedFile file;
+    const char* name;
+    size_t start;
+    size_t pos;
+
+    bool readInt(int& val);
+};